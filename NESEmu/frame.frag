@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D textureSampler;
+uniform vec4[64] palette;
+
+void main()
+{
+    // The texture holds system palette indices (0 - 63), normalized to 0.0 - 1.0
+    float index = texture(textureSampler, TexCoords).r;
+    FragColor = palette[int(index * 255.0f + 0.5f) & 63];
+}
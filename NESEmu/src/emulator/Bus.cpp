@@ -6,18 +6,32 @@
 // PPU register locations
 static uint16_t constexpr PPU_OAMDATA = 0x4014;
 
+// Sizes of the memory blocks owned by the bus
+static constexpr uint16_t CPU_MEMORY_SIZE = 0x800;
+static constexpr uint16_t PPU_REGISTER_MEMORY_SIZE = 8;
+static constexpr uint16_t APU_MEMORY_SIZE = 0x18;
+static constexpr uint16_t TEST_MEMORY_SIZE = 8;
+
 Bus::Bus()
 {
 	// Allocate memory arrays for all NES components
-	cpuMem = new uint8_t[2048]();
-	ppuRegisterMem = new uint8_t[8]();
-	apuMem = new uint8_t[24]();
-	testMem = new uint8_t[8]();
+	cpuMem = new uint8_t[CPU_MEMORY_SIZE]();
+	ppuRegisterMem = new uint8_t[PPU_REGISTER_MEMORY_SIZE]();
+	apuMem = new uint8_t[APU_MEMORY_SIZE]();
+	testMem = new uint8_t[TEST_MEMORY_SIZE]();
 	mapper = nullptr;
-	
-	// Other things needed on the bus
-	shouldDispatchNmi = false;
-	shouldDispatchOamTransfer = false;
+
+	readPages.fill(nullptr);
+	writePages.fill(nullptr);
+	mappedReadPages.fill(nullptr);
+	mappedWritePages.fill(nullptr);
+	debugWatchesArmed = false;
+
+	// CPU memory ($0000 - $1FFF, mirrored > $07FF)
+	for (uint32_t address = 0x0000; address < 0x2000; address += 0x0800)
+	{
+		mapPages(address, CPU_MEMORY_SIZE, cpuMem, true);
+	}
 }
 
 Bus::~Bus()
@@ -31,11 +45,12 @@ Bus::~Bus()
 
 uint8_t *Bus::get(uint16_t address)
 {
-	if (address >= 0x0000 && address <= 0x1FFF)
+	uint8_t *page = mappedReadPages[address >> 8];
+
+	if (page != nullptr)
 	{
-		// Get from CPU memory ($0000 - $1FFF, mirrored > $07FF)
-		uint16_t target = address % 0x0800;
-		return &cpuMem[target];
+		// Get from directly mapped memory (CPU memory, PRG RAM/ROM)
+		return &page[address & 0xFF];
 	}
 	else if (address >= 0x2000 && address <= 0x3FFF)
 	{
@@ -59,52 +74,27 @@ uint8_t *Bus::get(uint16_t address)
 
 uint8_t Bus::read(uint16_t address, bool skipCallback)
 {
-	// Get from cartridge Memory ($4020 - $FFFF)
-	if (address >= 0x4020 && address <= 0xFFFF)
-	{
-		return mapper->prgRead(address);
-	}
-
-	// Any other bus accesible memory (< $4020)
-	uint8_t *ptr = get(address);
+	uint8_t *page = readPages[address >> 8];
 
-	if (ptr != nullptr)
+	if (page != nullptr)
 	{
-		uint8_t val = *ptr;
-		
-		if (!skipCallback)
-		{
-			dispatchMemoryAccessCallbacks(address, 0, false);
-		}
-
-		return val;
+		return page[address & 0xFF];
 	}
 
-	// TODO: Return an error value?
-	return 0;
+	return readSlow(address, skipCallback);
 }
 
 void Bus::write(uint16_t address, uint8_t value, bool skipCallback)
 {
-	// Get from cartridge Memory ($4020 - $FFFF)
-	if (address >= 0x4020 && address <= 0xFFFF)
+	uint8_t *page = writePages[address >> 8];
+
+	if (page != nullptr)
 	{
-		mapper->prgWrite(address, value);
+		page[address & 0xFF] = value;
 		return;
 	}
 
-	// Any other bus accesible memory (< $4020)
-	uint8_t *ptr = get(address);
-
-	if (ptr != nullptr)
-	{
-		*ptr = value;
-
-		if (!skipCallback)
-		{
-			dispatchMemoryAccessCallbacks(address, value, true);
-		}
-	}
+	writeSlow(address, value, skipCallback);
 }
 
 void Bus::dump(Logger &logger)
@@ -133,9 +123,42 @@ void Bus::dump(Logger &logger)
 	logger.write(ss.str());
 }
 
-void Bus::registerMemoryAccessCallback(AccessCallback callback)
+void Bus::registerMemoryWatch(uint16_t start, uint16_t end, AccessCallback callback)
+{
+	memoryWatches.push_back({ start, end, callback });
+	addPageWatches(pageWatches, memoryWatches.size() - 1, start, end);
+}
+
+void Bus::registerDebugWatch(uint16_t start, uint16_t end, AccessCallback callback)
+{
+	debugWatches.push_back({ start, end, callback });
+	addPageWatches(pageDebugWatches, debugWatches.size() - 1, start, end);
+}
+
+void Bus::clearDebugWatches()
+{
+	debugWatches.clear();
+
+	for (uint32_t page = 0; page < PAGE_COUNT; page++)
+	{
+		pageDebugWatches[page].clear();
+		updatePage(page);
+	}
+}
+
+void Bus::setDebugWatchesArmed(bool armed)
+{
+	debugWatchesArmed = armed;
+
+	for (uint32_t page = 0; page < PAGE_COUNT; page++)
+	{
+		updatePage(page);
+	}
+}
+
+bool Bus::getDebugWatchesArmed() const
 {
-	memoryAccessCallbacks.push_back(callback);
+	return debugWatchesArmed;
 }
 
 void Bus::setPpuOamTransferCallback(OamTransferCallback callback)
@@ -143,9 +166,9 @@ void Bus::setPpuOamTransferCallback(OamTransferCallback callback)
 	ppuOamTransferCallback = callback;
 }
 
-void Bus::dispatchNmi()
+void Bus::setPpuSyncCallback(SyncCallback callback)
 {
-	shouldDispatchNmi = true;
+	ppuSyncCallback = callback;
 }
 
 void Bus::dispatchOamTransfer()
@@ -157,54 +180,206 @@ void Bus::dispatchOamTransfer()
 		uint8_t *data = get(address);
 		ppuOamTransferCallback(data);
 	}
+}
+
+void Bus::setMapper(IMapper *mapper)
+{
+	this->mapper = mapper;
+
+	// Cartridge space ($4000 - $FFFF) is mapped by the mapper
+	unmapPages(0x4000, 0xC000);
 
-	shouldDispatchOamTransfer = false;
+	if (mapper != nullptr)
+	{
+		mapper->mapPrg(*this);
+	}
 }
 
-bool Bus::pollNmi()
+void Bus::mapPages(uint16_t address, uint32_t size, uint8_t *memory, bool writable)
 {
-	if (shouldDispatchNmi)
+	uint32_t firstPage = address / PAGE_SIZE;
+	uint32_t pageCount = size / PAGE_SIZE;
+
+	for (uint32_t i = 0; i < pageCount && firstPage + i < PAGE_COUNT; i++)
 	{
-		shouldDispatchNmi = false;
-		return true;
+		mappedReadPages[firstPage + i] = memory + i * PAGE_SIZE;
+		mappedWritePages[firstPage + i] = writable ? memory + i * PAGE_SIZE : nullptr;
+		updatePage(firstPage + i);
 	}
+}
+
+void Bus::unmapPages(uint16_t address, uint32_t size)
+{
+	uint32_t firstPage = address / PAGE_SIZE;
+	uint32_t pageCount = size / PAGE_SIZE;
 
-	return false;
+	for (uint32_t i = 0; i < pageCount && firstPage + i < PAGE_COUNT; i++)
+	{
+		mappedReadPages[firstPage + i] = nullptr;
+		mappedWritePages[firstPage + i] = nullptr;
+		updatePage(firstPage + i);
+	}
 }
 
-bool Bus::pollOamTransfer()
+void Bus::serialize(StateSerializer &state)
 {
-	return shouldDispatchOamTransfer;
+	// The page tables only change with the mapper, which restores its own mapping
+	state.beginChunk(StateSerializer::ChunkId::Bus);
+	state.bytes(cpuMem, CPU_MEMORY_SIZE);
+	state.bytes(ppuRegisterMem, PPU_REGISTER_MEMORY_SIZE);
+	state.bytes(apuMem, APU_MEMORY_SIZE);
+	state.bytes(testMem, TEST_MEMORY_SIZE);
+	state.endChunk();
 }
 
-void Bus::setMapper(IMapper *mapper)
+uint8_t Bus::readSlow(uint16_t address, bool skipCallback)
 {
-	this->mapper = mapper;
+	uint8_t *page = mappedReadPages[address >> 8];
+	uint8_t value = 0;
+
+	if (page != nullptr)
+	{
+		// Directly mapped memory that is being watched
+		value = page[address & 0xFF];
+	}
+	else if (address >= 0x4020 && address <= 0xFFFF)
+	{
+		// Get from cartridge Memory ($4020 - $FFFF)
+		value = mapper->prgRead(address);
+	}
+	else
+	{
+		// Any other bus accesible memory (< $4020)
+		syncPpu(address);
+		uint8_t *ptr = get(address);
+
+		// TODO: Return an error value?
+		if (ptr != nullptr)
+		{
+			value = *ptr;
+		}
+	}
+
+	if (!skipCallback)
+	{
+		dispatchMemoryWatches(address, 0, false);
+	}
+
+	return value;
 }
 
-void Bus::dispatchMemoryAccessCallbacks(uint16_t address, uint8_t value, bool write)
+void Bus::writeSlow(uint16_t address, uint8_t value, bool skipCallback)
 {
-	uint16_t target = address;
+	uint8_t *page = mappedWritePages[address >> 8];
 
-	if (address >= 0x0000 && address <= 0x1FFF)
+	if (page != nullptr)
 	{
-		// Get from CPU memory ($0000 - $1FFF, mirrored > $07FF)
-		target = address % 0x0800;
+		// Directly mapped memory that is being watched
+		page[address & 0xFF] = value;
 	}
-	else if (address >= 0x2000 && address <= 0x3FFF)
+	else if (address >= 0x4020 && address <= 0xFFFF)
 	{
-		// Accessing PPU memory ($2000 - $3FFF, mirrored > $2007)
-		// Normalize target to non-mirrored register range ($2000 - $2007)
-		target = (address - 0x2000) % 0x0008 + 0x2000;
+		// Write to cartridge Memory ($4020 - $FFFF)
+		mapper->prgWrite(address, value);
 	}
-	
-	if (address == OAMDMA && write)
+	else
 	{
-		shouldDispatchOamTransfer = true;
+		// Any other bus accesible memory (< $4020)
+		syncPpu(address);
+		uint8_t *ptr = get(address);
+
+		if (ptr != nullptr)
+		{
+			*ptr = value;
+		}
 	}
 
-	for (auto &callback : memoryAccessCallbacks)
+	if (!skipCallback)
 	{
-		callback(target, value, write);
+		dispatchMemoryWatches(address, value, true);
 	}
-}
\ No newline at end of file
+}
+
+void Bus::syncPpu(uint16_t address)
+{
+	if (((address >= 0x2000 && address <= 0x3FFF) || address == OAMDMA) && ppuSyncCallback)
+	{
+		ppuSyncCallback();
+	}
+}
+
+void Bus::dispatchMemoryWatches(uint16_t address, uint8_t value, bool write)
+{
+	uint32_t page = address >> 8;
+	bool hasDebugWatches = debugWatchesArmed && !pageDebugWatches[page].empty();
+
+	if (pageWatches[page].empty() && !hasDebugWatches)
+	{
+		return;
+	}
+
+	uint16_t target = normalizeAddress(address);
+
+	for (uint16_t index : pageWatches[page])
+	{
+		MemoryWatch &watch = memoryWatches[index];
+
+		if (target >= watch.start && target <= watch.end)
+		{
+			watch.callback(target, value, write);
+		}
+	}
+
+	if (hasDebugWatches)
+	{
+		for (uint16_t index : pageDebugWatches[page])
+		{
+			MemoryWatch &watch = debugWatches[index];
+
+			if (target >= watch.start && target <= watch.end)
+			{
+				watch.callback(target, value, write);
+			}
+		}
+	}
+}
+
+void Bus::addPageWatches(std::array<std::vector<uint16_t>, PAGE_COUNT> &table, uint16_t index, uint16_t start, uint16_t end)
+{
+	for (uint32_t page = 0; page < PAGE_COUNT; page++)
+	{
+		// Normalized addresses within a page are always contiguous, since mirrors repeat every 8 or 2048 bytes
+		uint16_t pageStart = normalizeAddress(page * PAGE_SIZE);
+		uint16_t pageEnd = normalizeAddress(page * PAGE_SIZE + PAGE_SIZE - 1);
+
+		if (pageStart <= end && pageEnd >= start)
+		{
+			table[page].push_back(index);
+			updatePage(page);
+		}
+	}
+}
+
+void Bus::updatePage(uint32_t page)
+{
+	bool watched = !pageWatches[page].empty() || (debugWatchesArmed && !pageDebugWatches[page].empty());
+
+	readPages[page] = watched ? nullptr : mappedReadPages[page];
+	writePages[page] = watched ? nullptr : mappedWritePages[page];
+}
+
+uint16_t Bus::normalizeAddress(uint16_t address)
+{
+	if (address >= 0x0000 && address <= 0x1FFF)
+	{
+		// CPU memory ($0000 - $1FFF, mirrored > $07FF)
+		return address % 0x0800;
+	}
+	else if (address >= 0x2000 && address <= 0x3FFF)
+	{
+		// PPU registers ($2000 - $3FFF, mirrored > $2007)
+		return (address - 0x2000) % 0x0008 + 0x2000;
+	}
+
+	return address;
+}
@@ -2,7 +2,9 @@
 
 #include "../util/Logger.h"
 #include "IMapper.h"
+#include "SaveState.h"
 
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <vector>
@@ -20,9 +22,14 @@ public:
 	// Addressess
 	static constexpr uint16_t CARTRIDGE_ADDRESS = 0x4020;
 
+	// The address space is split into 256 pages of 256 bytes for the page tables
+	static constexpr uint32_t PAGE_SIZE = 0x100;
+	static constexpr uint32_t PAGE_COUNT = 0x100;
+
 	// Callback types
 	using AccessCallback = std::function<void(uint16_t address, uint8_t newValue, bool write)>;
 	using OamTransferCallback = std::function<void(uint8_t *data)>;
+	using SyncCallback = std::function<void()>;
 
 	// Initialize all empty memory blocks
 	Bus();
@@ -42,26 +49,42 @@ public:
 	// Dump entire contents of memory ($0000 - $FFFF) to given logger
 	void dump(Logger &logger);
 
-	// Register a new memory access callback
-	void registerMemoryAccessCallback(AccessCallback callback);
+	// Register a callback for accesses to an address range ($start - $end, inclusive). Accesses to mirrors
+	// are reported with their normalized address, e.g. $2008 is reported as $2000
+	void registerMemoryWatch(uint16_t start, uint16_t end, AccessCallback callback);
+
+	// Register a debugger callback for an address range, only called while debug watches are armed
+	void registerDebugWatch(uint16_t start, uint16_t end, AccessCallback callback);
+
+	// Remove all debugger callbacks
+	void clearDebugWatches();
+
+	// Set whether debugger callbacks are called. Pages with armed watches are taken out of the page tables
+	void setDebugWatchesArmed(bool armed);
+
+	// Returns whether debugger callbacks are called
+	bool getDebugWatchesArmed() const;
 
 	// Set the PPU Oam transfer callback
 	void setPpuOamTransferCallback(OamTransferCallback callback);
 
-	// Signal that the NMI should be dispatched to the CPU
-	void dispatchNmi();
+	// Set the callback used to catch the PPU up to the CPU before any of its registers are accessed
+	void setPpuSyncCallback(SyncCallback callback);
 
-	// Signal to the PPU that the OAM data transfer should begin
+	// Transfer the page written to OAMDMA to the PPU's OAM
 	void dispatchOamTransfer();
 
-	// Poll for whether the NMI should be dispatched
-	bool pollNmi();
+	// Sets the active mapper, and lets it map its PRG memory into the page tables
+	void setMapper(IMapper* mapper);
+
+	// Map whole pages starting at address directly to memory. Read-only pages still send writes to the mapper
+	void mapPages(uint16_t address, uint32_t size, uint8_t *memory, bool writable);
 
-	// Poll for whether an OAM data transfer is requested
-	bool pollOamTransfer();
+	// Remove the direct mapping of whole pages starting at address, sending accesses to the mapper
+	void unmapPages(uint16_t address, uint32_t size);
 
-	// Sets the active mapper
-	void setMapper(IMapper* mapper);
+	// Save or load the internal RAM and the memory of the mapped registers
+	void serialize(StateSerializer &state);
 
 private:
 	// Internal 2 KiB of CPU Memory (from $0000 - $07FFF)
@@ -81,16 +104,49 @@ private:
 	// Cartridge Memory: used for PRG ROM, PRG RAM, and mapper registers (from $4020 - $FFFF)
 	IMapper *mapper;
 
+	// A callback watching an address range
+	struct MemoryWatch
+	{
+		uint16_t start, end;
+		AccessCallback callback;
+	};
+
+	// Page tables pointing directly to the memory backing each page, so that most accesses are a single load.
+	// Pages without a pointer (PPU registers, APU & I/O, unmapped cartridge space, watched pages) go through readSlow/writeSlow
+	std::array<uint8_t *, PAGE_COUNT> readPages;
+	std::array<uint8_t *, PAGE_COUNT> writePages;
+
+	// Memory mapped to each page, including pages taken out of the page tables because they are watched
+	std::array<uint8_t *, PAGE_COUNT> mappedReadPages;
+	std::array<uint8_t *, PAGE_COUNT> mappedWritePages;
+
+	// Registered watches, and the watches that can be hit by accesses to each page
+	std::vector<MemoryWatch> memoryWatches;
+	std::vector<MemoryWatch> debugWatches;
+	std::array<std::vector<uint16_t>, PAGE_COUNT> pageWatches;
+	std::array<std::vector<uint16_t>, PAGE_COUNT> pageDebugWatches;
+	bool debugWatchesArmed;
+
 	// Callbacks
-	std::vector<AccessCallback> memoryAccessCallbacks;
 	OamTransferCallback ppuOamTransferCallback;
+	SyncCallback ppuSyncCallback;
+
+	// Accesses to pages that are not directly mapped
+	uint8_t readSlow(uint16_t address, bool skipCallback);
+	void writeSlow(uint16_t address, uint8_t value, bool skipCallback);
+
+	// Dispatch the watches of the accessed page that contain the address
+	void dispatchMemoryWatches(uint16_t address, uint8_t value, bool write);
+
+	// Add a watch to the dispatch table of every page with an address in its range
+	void addPageWatches(std::array<std::vector<uint16_t>, PAGE_COUNT> &table, uint16_t index, uint16_t start, uint16_t end);
 
-	// Whether the NMI has already been dispatched to the CPU
-	bool shouldDispatchNmi;
+	// Update a page table entry, leaving it empty while the page is watched
+	void updatePage(uint32_t page);
 
-	// Whether an OAM transfer is needed
-	bool shouldDispatchOamTransfer;
+	// Normalize mirrored addresses to the range that they mirror
+	static uint16_t normalizeAddress(uint16_t address);
 
-	// Dispatch any memory access callbacks if needed
-	void dispatchMemoryAccessCallbacks(uint16_t address, uint8_t value, bool write);
+	// Catch the PPU up to the CPU if the address belongs to the PPU ($2000 - $3FFF, $4014)
+	void syncPpu(uint16_t address);
 };
\ No newline at end of file
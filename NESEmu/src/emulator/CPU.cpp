@@ -5,28 +5,121 @@
 #include <memory>
 #include <sstream>
 
-// TODO: Handle interrupts (IRQ, NMI)
-// TODO: Use modern C++ constructs (new-style casts, smart pointers, etc)
+using std::bind;
+using std::placeholders::_1;
+using std::placeholders::_2;
+using std::placeholders::_3;
 
-// Debugging
-static bool constexpr DEBUG_LOG = true;
-static char debugBuf[100];
+// TODO: Handle IRQ interrupts
+// TODO: Use modern C++ constructs (new-style casts, smart pointers, etc)
 
 // Address of the low byte of various jump vectors
 static constexpr uint16_t NMI_VECTOR = 0xFFFA;
 static constexpr uint16_t RES_VECTOR = 0xFFFC;
 static constexpr uint16_t IRQ_VECTOR = 0xFFFE;
 
+using Operation = CPU::Operation;
+using AddressingMode = CPU::AddressingMode;
+using AccessType = CPU::AccessType;
+
+// Instruction length in bytes, based on the addressing mode
+static constexpr uint8_t getInstructionLength(AddressingMode mode)
+{
+	switch (mode)
+	{
+	case AddressingMode::IMP:
+	case AddressingMode::ACC:
+		return 1;
+	case AddressingMode::ABS:
+	case AddressingMode::ABX:
+	case AddressingMode::ABY:
+	case AddressingMode::IND:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+// How an operation accesses its operand in memory
+static constexpr AccessType getAccessType(Operation operation, AddressingMode mode)
+{
+	switch (operation)
+	{
+	case Operation::ADC: case Operation::AND: case Operation::BIT: case Operation::CMP:
+	case Operation::CPX: case Operation::CPY: case Operation::EOR: case Operation::LDA:
+	case Operation::LDX: case Operation::LDY: case Operation::ORA: case Operation::SBC:
+		return AccessType::Read;
+	case Operation::NOP:
+		// Unofficial NOPs with an operand still perform the read
+		return mode == AddressingMode::IMP ? AccessType::None : AccessType::Read;
+	case Operation::STA: case Operation::STX: case Operation::STY:
+		return AccessType::Write;
+	case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+	case Operation::INC: case Operation::DEC:
+		return mode == AddressingMode::ACC ? AccessType::None : AccessType::ReadModifyWrite;
+	default:
+		return AccessType::None;
+	}
+}
+
+static constexpr CPU::Opcode makeOpcode(Operation operation, AddressingMode mode, uint8_t cycles, bool official)
+{
+	AccessType access = getAccessType(operation, mode);
+
+	// Only reads using ABX, ABY, IDY add one cycle if page boundary crossed
+	bool indexed = mode == AddressingMode::ABX || mode == AddressingMode::ABY || mode == AddressingMode::IDY;
+
+	return { operation, mode, access, getInstructionLength(mode), cycles, indexed && access == AccessType::Read, official };
+}
+
 // Convenience macros for defining CPU instructions
-#define _I(NAME, RUN, MODE, CYCLES) { NAME, &CPU::RUN, &CPU::MODE, CYCLES }
-#define _XXX(MODE, CYCLES) { "XXX", &CPU::XXX, &CPU::MODE, CYCLES }
-#define _NOP(MODE, CYCLES) { "NOP*", &CPU::NOP, &CPU::MODE, CYCLES }
+#define _I(RUN, MODE, CYCLES) makeOpcode(Operation::RUN, AddressingMode::MODE, CYCLES, true)
+#define _XXX(MODE, CYCLES) makeOpcode(Operation::XXX, AddressingMode::MODE, CYCLES, false)
+#define _NOP(MODE, CYCLES) makeOpcode(Operation::NOP, AddressingMode::MODE, CYCLES, false)
+
+// Opcode table
+// Hi-nibble on vertical, Lo-nibble on horizontal
+static constexpr CPU::Opcode OPCODES[256] =
+{
+	// -0               -1               -2               -3               -4               -5               -6               -7               -8               -9               -A               -B               -C               -D               -E               -F
+	_I(BRK, IMP, 7), _I(ORA, IDX, 6), _XXX(IMM, 2),    _XXX(ZPX, 3),    _NOP(ZPG, 3),    _I(ORA, ZPG, 3), _I(ASL, ZPG, 5), _XXX(ZPG, 5),    _I(PHP, IMP, 3), _I(ORA, IMM, 2), _I(ASL, ACC, 2), _XXX(IMM, 2),    _NOP(ABS, 4),    _I(ORA, ABS, 4), _I(ASL, ABS, 6), _XXX(ABS, 6), // 0-
+	_I(BPL, REL, 2), _I(ORA, IDY, 5), _XXX(IMM, 2),    _XXX(ZPY, 3),    _NOP(ZPX, 4),    _I(ORA, ZPX, 4), _I(ASL, ZPX, 6), _XXX(ZPX, 6),    _I(CLC, IMP, 2), _I(ORA, ABY, 4), _NOP(IMP, 2),    _XXX(ABY, 7),    _NOP(ABX, 4),    _I(ORA, ABX, 4), _I(ASL, ABX, 7), _XXX(ABX, 7), // 1-
+	_I(JSR, ABS, 6), _I(AND, IDX, 6), _XXX(IMM, 2),    _XXX(ZPX, 3),    _I(BIT, ZPG, 3), _I(AND, ZPG, 3), _I(ROL, ZPG, 5), _XXX(ZPG, 5),    _I(PLP, IMP, 4), _I(AND, IMM, 2), _I(ROL, ACC, 2), _XXX(IMM, 2),    _I(BIT, ABS, 4), _I(AND, ABS, 4), _I(ROL, ABS, 6), _XXX(ABS, 6), // 2-
+	_I(BMI, REL, 2), _I(AND, IDY, 5), _XXX(IMM, 2),    _XXX(ZPY, 3),    _NOP(ZPX, 4),    _I(AND, ZPX, 4), _I(ROL, ZPX, 6), _XXX(ZPX, 6),    _I(SEC, IMP, 2), _I(AND, ABY, 4), _NOP(IMP, 2),    _XXX(ABY, 7),    _NOP(ABX, 4),    _I(AND, ABX, 4), _I(ROL, ABX, 7), _XXX(ABX, 7), // 3-
+	_I(RTI, IMP, 6), _I(EOR, IDX, 6), _XXX(IMM, 2),    _XXX(ZPX, 3),    _NOP(ZPG, 3),    _I(EOR, ZPG, 3), _I(LSR, ZPG, 5), _XXX(ZPG, 5),    _I(PHA, IMP, 3), _I(EOR, IMM, 2), _I(LSR, ACC, 2), _XXX(IMM, 2),    _I(JMP, ABS, 3), _I(EOR, ABS, 4), _I(LSR, ABS, 6), _XXX(ABS, 6), // 4-
+	_I(BVC, REL, 2), _I(EOR, IDY, 5), _XXX(IMM, 2),    _XXX(ZPY, 3),    _NOP(ZPX, 4),    _I(EOR, ZPX, 4), _I(LSR, ZPX, 6), _XXX(ZPX, 6),    _I(CLI, IMP, 2), _I(EOR, ABY, 4), _NOP(IMP, 2),    _XXX(ABY, 7),    _NOP(ABX, 4),    _I(EOR, ABX, 4), _I(LSR, ABX, 7), _XXX(ABX, 7), // 5-
+	_I(RTS, IMP, 6), _I(ADC, IDX, 6), _XXX(IMM, 2),    _XXX(ZPX, 3),    _NOP(ZPG, 3),    _I(ADC, ZPG, 3), _I(ROR, ZPG, 5), _XXX(ZPG, 5),    _I(PLA, IMP, 4), _I(ADC, IMM, 2), _I(ROR, ACC, 2), _XXX(IMM, 2),    _I(JMP, IND, 5), _I(ADC, ABS, 4), _I(ROR, ABS, 4), _XXX(ABS, 6), // 6-
+	_I(BVS, REL, 2), _I(ADC, IDY, 5), _XXX(IMM, 2),    _XXX(ZPY, 3),    _NOP(ZPX, 3),    _I(ADC, ZPX, 4), _I(ROR, ZPX, 6), _XXX(ZPX, 6),    _I(SEI, IMP, 2), _I(ADC, ABY, 4), _NOP(IMP, 2),    _XXX(ABY, 7),    _NOP(ABX, 4),    _I(ADC, ABX, 4), _I(ROR, ABX, 7), _XXX(ABX, 7), // 7-
+	_NOP(IMM, 2),    _I(STA, IDX, 6), _NOP(IMM, 2),    _XXX(ZPX, 3),    _I(STY, ZPG, 3), _I(STA, ZPG, 3), _I(STX, ZPG, 3), _XXX(ZPG, 5),    _I(DEY, IMP, 2), _NOP(IMM, 2),    _I(TXA, IMP, 2), _XXX(IMM, 2),    _I(STY, ABS, 4), _I(STA, ABS, 4), _I(STX, ABS, 4), _XXX(ABS, 4), // 8-
+	_I(BCC, REL, 2), _I(STA, IDY, 6), _XXX(IMM, 2),    _XXX(ZPY, 3),    _I(STY, ZPX, 4), _I(STA, ZPX, 4), _I(STX, ZPY, 4), _XXX(ZPX, 6),    _I(TYA, IMP, 2), _I(STA, ABY, 5), _I(TXS, IMP, 2), _XXX(ABY, 5),    _XXX(ABX, 5),    _I(STA, ABX, 5), _XXX(ABY, 5),    _XXX(ABY, 5), // 9-
+	_I(LDY, IMM, 2), _I(LDA, IDX, 6), _I(LDX, IMM, 2), _XXX(ZPX, 3),    _I(LDY, ZPG, 3), _I(LDA, ZPG, 3), _I(LDX, ZPG, 3), _XXX(ZPG, 5),    _I(TAY, IMP, 2), _I(LDA, IMM, 2), _I(TAX, IMP, 2), _XXX(IMM, 2),    _I(LDY, ABS, 4), _I(LDA, ABS, 4), _I(LDX, ABS, 4), _XXX(ABS, 4), // A-
+	_I(BCS, REL, 2), _I(LDA, IDY, 5), _XXX(IMM, 2),    _XXX(ZPY, 3),    _I(LDY, ZPX, 4), _I(LDA, ZPX, 4), _I(LDX, ZPY, 4), _XXX(ZPX, 6),    _I(CLV, IMP, 2), _I(LDA, ABY, 4), _I(TSX, IMP, 2), _XXX(ABY, 7),    _I(LDY, ABX, 4), _I(LDA, ABX, 4), _I(LDX, ABY, 4), _XXX(ABY, 4), // B-
+	_I(CPY, IMM, 2), _I(CMP, IDX, 6), _NOP(IMM, 2),    _XXX(ZPX, 3),    _I(CPY, ZPG, 3), _I(CMP, ZPG, 3), _I(DEC, ZPG, 5), _XXX(ZPG, 5),    _I(INY, IMP, 2), _I(CMP, IMM, 2), _I(DEX, IMP, 2), _XXX(IMM, 2),    _I(CPY, ABS, 4), _I(CMP, ABS, 4), _I(DEC, ABS, 6), _XXX(ABS, 6), // C-
+	_I(BNE, REL, 2), _I(CMP, IDY, 5), _XXX(IMM, 2),    _XXX(ZPY, 3),    _NOP(ZPX, 4),    _I(CMP, ZPX, 4), _I(DEC, ZPX, 6), _XXX(ZPX, 6),    _I(CLD, IMP, 2), _I(CMP, ABY, 4), _NOP(IMP, 2),    _XXX(ABY, 7),    _NOP(ABX, 4),    _I(CMP, ABX, 4), _I(DEC, ABX, 7), _XXX(ABX, 7), // D-
+	_I(CPX, IMM, 2), _I(SBC, IDX, 6), _NOP(IMM, 2),    _XXX(ZPX, 3),    _I(CPX, ZPG, 3), _I(SBC, ZPG, 3), _I(INC, ZPG, 5), _XXX(ZPG, 5),    _I(INX, IMP, 2), _I(SBC, IMM, 2), _I(NOP, IMP, 2), _XXX(IMM, 2),    _I(CPX, ABS, 4), _I(SBC, ABS, 4), _I(INC, ABS, 6), _XXX(ABS, 6), // E-
+	_I(BEQ, REL, 2), _I(SBC, IDY, 5), _XXX(IMM, 2),    _XXX(ZPY, 3),    _NOP(ZPX, 4),    _I(SBC, ZPX, 4), _I(INC, ZPX, 6), _XXX(ZPX, 6),    _I(SED, IMP, 2), _I(SBC, ABY, 4), _NOP(IMP, 2),    _XXX(ABY, 7),    _NOP(ABS, 4),    _I(SBC, ABX, 4), _I(INC, ABX, 7), _XXX(ABX, 7) // F-
+};
+
+// Instruction and addressing mode names, only used for debugging
+static constexpr const char *OPERATION_NAMES[] =
+{
+	"ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS", "CLC",
+	"CLD", "CLI", "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR", "INC", "INX", "INY", "JMP",
+	"JSR", "LDA", "LDX", "LDY", "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL", "ROR", "RTI",
+	"RTS", "SBC", "SEC", "SED", "SEI", "STA", "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+	"XXX"
+};
+
+static constexpr const char *ADDRESSING_MODE_NAMES[] =
+{
+	"IMP", "ACC", "IMM", "ZPG", "ZPX", "ZPY", "REL", "ABS", "ABX", "ABY", "IND", "IDX", "IDY"
+};
 
 // Since the SP is only 8-bit, and the stack starts at 0x0100, this is a utility to calculate the full SP address
 #define SP_ADDRESS (sp + 0x0100)
 
 // Initialize CPU
-CPU::CPU(Bus &bus) : logger("..\\logs\\cpu.log"), bus(bus)
+CPU::CPU(Bus &bus, Scheduler &scheduler) : bus(bus), scheduler(scheduler), tracer(nullptr)
 {
 	a = 0x00;
 	x = 0x00;
@@ -39,28 +132,10 @@ CPU::CPU(Bus &bus) : logger("..\\logs\\cpu.log"), bus(bus)
 	cycles = 0;
 	operand = { OperandType::Invalid, 0x0000 };
 
-	// Initialize instruction table
-	// Hi-nibble on vertical, Lo-nibble on horizontal
-	instructions =
-	{
-		//        -0                      -1                 -2                      -3            -4                             -5                      -6                 -7                 -8                      -9                        -A                 -B            -C                             -D                      -E                 -F                                                                 
-		_I("BRK", BRK, IMP, 7), _I("ORA", ORA, IDX, 6), _XXX(IMM, 2),			_XXX(ZPX, 3), _NOP(ZPG, 3),				_I("ORA", ORA, ZPG, 3), _I("ASL", ASL, ZPG, 5), _XXX(ZPG, 5), _I("PHP", PHP, IMP, 3), _I("ORA", ORA, IMM, 2),	_I("ASL", ASL, ACC, 2), _XXX(IMM, 2), _NOP(ABS, 4),				_I("ORA", ORA, ABS, 4), _I("ASL", ASL, ABS, 6), _XXX(ABS, 6),
-		_I("BPL", BPL, REL, 2), _I("ORA", ORA, IDY, 5), _XXX(IMM, 2),			_XXX(ZPY, 3), _NOP(ZPX, 4),				_I("ORA", ORA, ZPX, 4), _I("ASL", ASL, ZPX, 6), _XXX(ZPX, 6), _I("CLC", CLC, IMP, 2), _I("ORA", ORA, ABY, 4),	_NOP(IMP, 2),			_XXX(ABY, 7), _NOP(ABX, 4),				_I("ORA", ORA, ABX, 4), _I("ASL", ASL, ABX, 7), _XXX(ABX, 7),
-		_I("JSR", JSR, ABS, 6), _I("AND", AND, IDX, 6), _XXX(IMM, 2),			_XXX(ZPX, 3), _I("BIT", BIT, ZPG, 3),	_I("AND", AND, ZPG, 3), _I("ROL", ROL, ZPG, 5), _XXX(ZPG, 5), _I("PLP", PLP, IMP, 4), _I("AND", AND, IMM, 2),	_I("ROL", ROL, ACC, 2), _XXX(IMM, 2), _I("BIT", BIT, ABS, 4),	_I("AND", AND, ABS, 4), _I("ROL", ROL, ABS, 6), _XXX(ABS, 6),
-		_I("BMI", BMI, REL, 2), _I("AND", AND, IDY, 5), _XXX(IMM, 2),			_XXX(ZPY, 3), _NOP(ZPX, 4),				_I("AND", AND, ZPX, 4), _I("ROL", ROL, ZPX, 6), _XXX(ZPX, 6), _I("SEC", SEC, IMP, 2), _I("AND", AND, ABY, 4),	_NOP(IMP, 2),			_XXX(ABY, 7), _NOP(ABX, 4),				_I("AND", AND, ABX, 4), _I("ROL", ROL, ABX, 7), _XXX(ABX, 7),
-		_I("RTI", RTI, IMP, 6), _I("EOR", EOR, IDX, 6), _XXX(IMM, 2),			_XXX(ZPX, 3), _NOP(ZPG, 3),				_I("EOR", EOR, ZPG, 3), _I("LSR", LSR, ZPG, 5), _XXX(ZPG, 5), _I("PHA", PHA, IMP, 3), _I("EOR", EOR, IMM, 2),	_I("LSR", LSR, ACC, 2), _XXX(IMM, 2), _I("JMP", JMP, ABS, 3),	_I("EOR", EOR, ABS, 4), _I("LSR", LSR, ABS, 6), _XXX(ABS, 6),
-		_I("BVC", BVC, REL, 2), _I("EOR", EOR, IDY, 5), _XXX(IMM, 2),			_XXX(ZPY, 3), _NOP(ZPX, 4),				_I("EOR", EOR, ZPX, 4), _I("LSR", LSR, ZPX, 6), _XXX(ZPX, 6), _I("CLI", CLI, IMP, 2), _I("EOR", EOR, ABY, 4),	_NOP(IMP, 2),			_XXX(ABY, 7), _NOP(ABX, 4),				_I("EOR", EOR, ABX, 4), _I("LSR", LSR, ABX, 7), _XXX(ABX, 7),
-		_I("RTS", RTS, IMP, 6), _I("ADC", ADC, IDX, 6), _XXX(IMM, 2),			_XXX(ZPX, 3), _NOP(ZPG, 3),				_I("ADC", ADC, ZPG, 3), _I("ROR", ROR, ZPG, 5), _XXX(ZPG, 5), _I("PLA", PLA, IMP, 4), _I("ADC", ADC, IMM, 2),	_I("ROR", ROR, ACC, 2), _XXX(IMM, 2), _I("JMP", JMP, IND, 5),	_I("ADC", ADC, ABS, 4), _I("ROR", ROR, ABS, 4), _XXX(ABS, 6),
-		_I("BVS", BVS, REL, 2), _I("ADC", ADC, IDY, 5), _XXX(IMM, 2),			_XXX(ZPY, 3), _NOP(ZPX, 3),				_I("ADC", ADC, ZPX, 4), _I("ROR", ROR, ZPX, 6), _XXX(ZPX, 6), _I("SEI", SEI, IMP, 2), _I("ADC", ADC, ABY, 4),	_NOP(IMP, 2),			_XXX(ABY, 7), _NOP(ABX, 4),				_I("ADC", ADC, ABX, 4), _I("ROR", ROR, ABX, 7), _XXX(ABX, 7),
-		_NOP(IMM, 2),			_I("STA", STA, IDX, 6), _NOP(IMM, 2),			_XXX(ZPX, 3), _I("STY", STY, ZPG, 3),	_I("STA", STA, ZPG, 3), _I("STX", STX, ZPG, 3), _XXX(ZPG, 5), _I("DEY", DEY, IMP, 2), _NOP(IMM, 2),				_I("TXA", TXA, IMP, 2), _XXX(IMM, 2), _I("STY", STY, ABS, 4),	_I("STA", STA, ABS, 4), _I("STX", STX, ABS, 4), _XXX(ABS, 4),
-		_I("BCC", BCC, REL, 2), _I("STA", STA, IDY, 6), _XXX(IMM, 2),			_XXX(ZPY, 3), _I("STY", STY, ZPX, 4),	_I("STA", STA, ZPX, 4), _I("STX", STX, ZPY, 4), _XXX(ZPX, 6), _I("TYA", TYA, IMP, 2), _I("STA", STA, ABY, 5),	_I("TXS", TXS, IMP, 2), _XXX(ABY, 5), _XXX(ABX, 5),				_I("STA", STA, ABX, 5), _XXX(ABY, 5),			_XXX(ABY, 5),
-		_I("LDY", LDY, IMM, 2), _I("LDA", LDA, IDX, 6), _I("LDX", LDX, IMM, 2), _XXX(ZPX, 3), _I("LDY", LDY, ZPG, 3),	_I("LDA", LDA, ZPG, 3), _I("LDX", LDX, ZPG, 3), _XXX(ZPG, 5), _I("TAY", TAY, IMP, 2), _I("LDA", LDA, IMM, 2),	_I("TAX", TAX, IMP, 2), _XXX(IMM, 2), _I("LDY", LDY, ABS, 4),	_I("LDA", LDA, ABS, 4), _I("LDX", LDX, ABS, 4), _XXX(ABS, 4),
-		_I("BCS", BCS, REL, 2), _I("LDA", LDA, IDY, 5), _XXX(IMM, 2),			_XXX(ZPY, 3), _I("LDY", LDY, ZPX, 4),	_I("LDA", LDA, ZPX, 4), _I("LDX", LDX, ZPY, 4), _XXX(ZPX, 6), _I("CLV", CLV, IMP, 2), _I("LDA", LDA, ABY, 4),	_I("TSX", TSX, IMP, 2), _XXX(ABY, 7), _I("LDY", LDY, ABX, 4),	_I("LDA", LDA, ABX, 4), _I("LDX", LDX, ABY, 4), _XXX(ABY, 4),
-		_I("CPY", CPY, IMM, 2), _I("CMP", CMP, IDX, 6), _NOP(IMM, 2),			_XXX(ZPX, 3), _I("CPY", CPY, ZPG, 3),	_I("CMP", CMP, ZPG, 3), _I("DEC", DEC, ZPG, 5), _XXX(ZPG, 5), _I("INY", INY, IMP, 2), _I("CMP", CMP, IMM, 2),	_I("DEX", DEX, IMP, 2), _XXX(IMM, 2), _I("CPY", CPY, ABS, 4),	_I("CMP", CMP, ABS, 4), _I("DEC", DEC, ABS, 6), _XXX(ABS, 6),
-		_I("BNE", BNE, REL, 2), _I("CMP", CMP, IDY, 5), _XXX(IMM, 2),			_XXX(ZPY, 3), _NOP(ZPX, 4),				_I("CMP", CMP, ZPX, 4), _I("DEC", DEC, ZPX, 6), _XXX(ZPX, 6), _I("CLD", CLD, IMP, 2), _I("CMP", CMP, ABY, 4),	_NOP(IMP, 2),			_XXX(ABY, 7), _NOP(ABX, 4),				_I("CMP", CMP, ABX, 4), _I("DEC", DEC, ABX, 7), _XXX(ABX, 7),
-		_I("CPX", CPX, IMM, 2), _I("SBC", SBC, IDX, 6), _NOP(IMM, 2),			_XXX(ZPX, 3), _I("CPX", CPX, ZPG, 3),	_I("SBC", SBC, ZPG, 3), _I("INC", INC, ZPG, 5), _XXX(ZPG, 5), _I("INX", INX, IMP, 2), _I("SBC", SBC, IMM, 2),	_I("NOP", NOP, IMP, 2), _XXX(IMM, 2), _I("CPX", CPX, ABS, 4),	_I("SBC", SBC, ABS, 4), _I("INC", INC, ABS, 6), _XXX(ABS, 6),
-		_I("BEQ", BEQ, REL, 2), _I("SBC", SBC, IDY, 5), _XXX(IMM, 2),			_XXX(ZPY, 3), _NOP(ZPX, 4),				_I("SBC", SBC, ZPX, 4), _I("INC", INC, ZPX, 6), _XXX(ZPX, 6), _I("SED", SED, IMP, 2), _I("SBC", SBC, ABY, 4),	_NOP(IMP, 2),			_XXX(ABY, 7), _NOP(ABS, 4),				_I("SBC", SBC, ABX, 4), _I("INC", INC, ABX, 7), _XXX(ABX, 7)
-	};
+	// Callbacks
+	bus.registerMemoryWatch(Bus::OAMDMA, Bus::OAMDMA, bind(&CPU::onBusMemoryAccess, this, _1, _2, _3));
+	scheduler.setCallback(Scheduler::EventType::Nmi, [this](uint64_t) { nmi(); });
+	scheduler.setCallback(Scheduler::EventType::OamDma, [this](uint64_t) { oamDma(); });
 }
 
 void CPU::reset()
@@ -72,7 +147,6 @@ void CPU::reset()
 	p = 0x24;
 	sp = 0xFD;
 	opcode = 0x00;
-	totalCycles = 0;
 	cycles = 0;
 	operand = { OperandType::Invalid, 0x0000 };
 
@@ -82,99 +156,215 @@ void CPU::reset()
 	printf("CPU reset\n");
 	printf("\tSet PC to $%X\n", pc);
 
-	// Reset takes 8 cycles
-	cycles += 8;
+	// Reset takes 8 cycles. Total cycles are not cleared, since they are used as a timestamp by the other components
 	totalCycles += 8;
 }
 
-void CPU::step()
+uint32_t CPU::step()
 {
-	if (cycles > 0)
+	// Process opcode
+	opcode = bus.read(pc);
+	(this->*handlers[opcode])();
+	totalCycles += cycles;
+
+	return cycles;
+}
+
+uint64_t CPU::runUntil(uint64_t targetCycle)
+{
+	// Interrupts and DMA are scheduled events, so nothing needs to be polled between instructions
+	while (totalCycles < targetCycle && totalCycles * Scheduler::CPU_CLOCK_DIVIDER < scheduler.getNextEventTime())
 	{
-		cycles--;
+		step();
 	}
-	else
+
+	return totalCycles > targetCycle ? totalCycles - targetCycle : 0;
+}
+
+void CPU::nmi()
+{
+	uint16_t returnAddress = pc;
+	bus.write(SP_ADDRESS, returnAddress >> 8); // Return address high byte
+	bus.write(SP_ADDRESS - 1, returnAddress & 0x00FF); // Return address low byte
+	bus.write(SP_ADDRESS - 2, p); // Status
+
+	setFlag(Flag::Interrupt);
+
+	// Set SP to next empty slot
+	sp -= 3;
+
+	jumpVector(NMI_VECTOR);
+}
+
+void CPU::oamDma()
+{
+	bus.dispatchOamTransfer();
+
+	// OAM data transfer takes 513 (+1) cycles
+	uint32_t transferCycles = 513;
+
+	// +1 cycle if on odd CPU cycle
+	if (totalCycles % 2 != 0)
 	{
-		// Poll for OAM data transfer request
-		if (bus.pollOamTransfer())
-		{
-			bus.dispatchOamTransfer();
-
-			// OAM data transfer takes 513 (+1) cycles
-			cycles = 513;
-
-			// +1 cycle if on odd CPU cycle
-			if (totalCycles % 2 != 0)
-			{
-				cycles++;
-			}
-
-			return;
-		}
-
-		// Poll for NMI interrupts
-		if (bus.pollNmi())
-		{
-			// TODO: Make interrupt func
-			uint16_t returnAddress = pc;
-			bus.write(SP_ADDRESS, returnAddress >> 8); // Return address high byte
-			bus.write(SP_ADDRESS - 1, returnAddress & 0x00FF); // Return address low byte
-			bus.write(SP_ADDRESS - 2, p); // Status
-
-			setFlag(Flag::Interrupt);
-
-			// Set SP to next empty slot
-			sp -= 3;
-
-			jumpVector(NMI_VECTOR);
-		}
-
-		// Process opcode
-		opcode = bus.read(pc);
-		Instruction ins = instructions[opcode];
-		instructionLength = 1;
-		int modeExtra = (this->*ins.addressingMode)();
-
-		// Write debug info to log
-		if (DEBUG_LOG)
-		{
-			char opcodeBuf[11];
-
-			switch (instructionLength)
-			{
-			case 1:
-				snprintf(opcodeBuf, 9, "%02X      ", opcode);
-				break;
-			case 2:
-				snprintf(opcodeBuf, 9, "%02X %02X    ", opcode, bus.read(pc + 1, true));
-				break;
-			case 3:
-				snprintf(opcodeBuf, 9, "%02X %02X %02X", opcode, bus.read(pc + 1, true), bus.read(pc + 2, true));
-				break;
-			}
-
-			snprintf(debugBuf, 100, "%04X  %s  %s\t\tA:%02X X:%02X Y:%02X P:%02X SP:%02X\tCYC:%d\n", pc, opcodeBuf, ins.instruction.c_str(), a, x, y, p, sp, totalCycles);
-			logger.write(debugBuf);
-		}
-
-		int runExtra = (this->*ins.run)();
-
-		// TODO: Fix cycle calculation, runs behind
-		// Likely due to not adding extra cycles on page boundary being crossed
-		pc += instructionLength;
-		cycles += ins.cycles;
-
-		if (modeExtra > 0 && runExtra > 0)
-		{
-			cycles += runExtra;
-		}
-
-		cycles--;
+		transferCycles++;
 	}
 
-	totalCycles++;
+	totalCycles += transferCycles;
 }
 
+void CPU::onBusMemoryAccess(uint16_t address, uint8_t newValue, bool write)
+{
+	// Writing to OAMDMA starts the transfer once the current instruction is done
+	if (address == Bus::OAMDMA && write)
+	{
+		scheduler.schedule(Scheduler::EventType::OamDma, totalCycles * Scheduler::CPU_CLOCK_DIVIDER);
+	}
+}
+
+uint64_t CPU::getTotalCycles() const
+{
+	return totalCycles;
+}
+
+void CPU::setTracer(CPUTracer *tracer)
+{
+	this->tracer = tracer;
+}
+
+template <uint8_t OPCODE>
+void CPU::execute()
+{
+	constexpr Opcode ins = OPCODES[OPCODE];
+	instructionLength = ins.length;
+	bool pageCrossed = resolveOperand<ins.mode>();
+
+	// Record the state before the instruction runs
+	if (tracer != nullptr)
+	{
+		CPUTracer::Record record = {};
+		record.cycle = totalCycles;
+		record.pc = pc;
+		record.a = a;
+		record.x = x;
+		record.y = y;
+		record.p = p;
+		record.sp = sp;
+		record.length = instructionLength;
+		record.bytes[0] = opcode;
+		record.bytes[1] = instructionLength > 1 ? bus.read(pc + 1, true) : 0;
+		record.bytes[2] = instructionLength > 2 ? bus.read(pc + 2, true) : 0;
+		tracer->record(record);
+	}
+
+	int extraCycles = runOperation<ins.operation>();
+
+	pc += instructionLength;
+	cycles = ins.cycles + extraCycles;
+
+	if (ins.pageCrossCycle && pageCrossed)
+	{
+		cycles++;
+	}
+}
+
+template <CPU::AddressingMode MODE>
+bool CPU::resolveOperand()
+{
+	switch (MODE)
+	{
+	case AddressingMode::IMP: return IMP();
+	case AddressingMode::ACC: return ACC();
+	case AddressingMode::IMM: return IMM();
+	case AddressingMode::ZPG: return ZPG();
+	case AddressingMode::ZPX: return ZPX();
+	case AddressingMode::ZPY: return ZPY();
+	case AddressingMode::REL: return REL();
+	case AddressingMode::ABS: return ABS();
+	case AddressingMode::ABX: return ABX();
+	case AddressingMode::ABY: return ABY();
+	case AddressingMode::IND: return IND();
+	case AddressingMode::IDX: return IDX();
+	case AddressingMode::IDY: return IDY();
+	}
+
+	return false;
+}
+
+template <CPU::Operation OPERATION>
+int CPU::runOperation()
+{
+	switch (OPERATION)
+	{
+	case Operation::ADC: return ADC();
+	case Operation::AND: return AND();
+	case Operation::ASL: return ASL();
+	case Operation::BCC: return BCC();
+	case Operation::BCS: return BCS();
+	case Operation::BEQ: return BEQ();
+	case Operation::BIT: return BIT();
+	case Operation::BMI: return BMI();
+	case Operation::BNE: return BNE();
+	case Operation::BPL: return BPL();
+	case Operation::BRK: return BRK();
+	case Operation::BVC: return BVC();
+	case Operation::BVS: return BVS();
+	case Operation::CLC: return CLC();
+	case Operation::CLD: return CLD();
+	case Operation::CLI: return CLI();
+	case Operation::CLV: return CLV();
+	case Operation::CMP: return CMP();
+	case Operation::CPX: return CPX();
+	case Operation::CPY: return CPY();
+	case Operation::DEC: return DEC();
+	case Operation::DEX: return DEX();
+	case Operation::DEY: return DEY();
+	case Operation::EOR: return EOR();
+	case Operation::INC: return INC();
+	case Operation::INX: return INX();
+	case Operation::INY: return INY();
+	case Operation::JMP: return JMP();
+	case Operation::JSR: return JSR();
+	case Operation::LDA: return LDA();
+	case Operation::LDX: return LDX();
+	case Operation::LDY: return LDY();
+	case Operation::LSR: return LSR();
+	case Operation::NOP: return NOP();
+	case Operation::ORA: return ORA();
+	case Operation::PHA: return PHA();
+	case Operation::PHP: return PHP();
+	case Operation::PLA: return PLA();
+	case Operation::PLP: return PLP();
+	case Operation::ROL: return ROL();
+	case Operation::ROR: return ROR();
+	case Operation::RTI: return RTI();
+	case Operation::RTS: return RTS();
+	case Operation::SBC: return SBC();
+	case Operation::SEC: return SEC();
+	case Operation::SED: return SED();
+	case Operation::SEI: return SEI();
+	case Operation::STA: return STA();
+	case Operation::STX: return STX();
+	case Operation::STY: return STY();
+	case Operation::TAX: return TAX();
+	case Operation::TAY: return TAY();
+	case Operation::TSX: return TSX();
+	case Operation::TXA: return TXA();
+	case Operation::TXS: return TXS();
+	case Operation::TYA: return TYA();
+	case Operation::XXX: return XXX();
+	}
+
+	return 0;
+}
+
+template <size_t... OPCODES>
+constexpr std::array<CPU::Handler, 256> CPU::makeHandlerTable(std::index_sequence<OPCODES...>)
+{
+	return { &CPU::execute<OPCODES>... };
+}
+
+const std::array<CPU::Handler, 256> CPU::handlers = CPU::makeHandlerTable(std::make_index_sequence<256>());
+
 void CPU::setFlag(Flag flag)
 {
 	p |= (uint8_t)flag;
@@ -192,7 +382,14 @@ void CPU::setStatusBit(uint8_t bit, uint8_t value)
 
 void CPU::setFlagValue(Flag flag, uint8_t value)
 {
-	setStatusBit((uint8_t)flag, value);
+	if (value)
+	{
+		setFlag(flag);
+	}
+	else
+	{
+		clearFlag(flag);
+	}
 }
 
 bool CPU::hasFlag(Flag flag) const
@@ -205,26 +402,81 @@ void CPU::setPC(uint16_t pc)
 	this->pc = pc;
 }
 
+CPU::Registers CPU::getRegisters() const
+{
+	return { a, x, y, p, sp, pc };
+}
+
+void CPU::setRegisters(const Registers &registers)
+{
+	a = registers.a;
+	x = registers.x;
+	y = registers.y;
+	p = registers.p;
+	sp = registers.sp;
+	pc = registers.pc;
+}
+
+void CPU::serialize(StateSerializer &state)
+{
+	// The operand and jump target only live during an instruction, the last opcode is kept for the debugger
+	state.beginChunk(StateSerializer::ChunkId::CPU);
+	state.value(a);
+	state.value(x);
+	state.value(y);
+	state.value(p);
+	state.value(sp);
+	state.value(pc);
+	state.value(opcode);
+	state.value(instructionLength);
+	state.value(cycles);
+	state.value(totalCycles);
+	state.endChunk();
+}
+
 CPU::State CPU::getState() const
 {
-	State state =
-	{
-		state.a = a,
-		state.x = x,
-		state.y = y,
-		state.p = p,
-		state.sp = sp,
-		state.pc = pc,
-		state.totalCycles = totalCycles,
-		state.instructionLength = instructionLength,
-
-		state.opcode = opcode,
-		state.cycles = totalCycles
-	};
+	State state;
+	state.a = a;
+	state.x = x;
+	state.y = y;
+	state.p = p;
+	state.sp = sp;
+	state.pc = pc;
+	state.totalCycles = totalCycles;
+	state.instructionLength = instructionLength;
+
+	state.opcode = opcode;
+	state.cycles = cycles;
+	state.instruction = getInstructionName(opcode);
+	state.addressingMode = getAddressingModeName(OPCODES[opcode].mode);
 
 	return state;
 }
 
+const CPU::Opcode &CPU::getOpcode(uint8_t opcode)
+{
+	return OPCODES[opcode];
+}
+
+const char *CPU::getInstructionName(uint8_t opcode)
+{
+	const Opcode &ins = OPCODES[opcode];
+
+	// Unofficial NOPs are marked to differentiate them in logs
+	if (ins.operation == Operation::NOP && !ins.official)
+	{
+		return "NOP*";
+	}
+
+	return OPERATION_NAMES[static_cast<uint8_t>(ins.operation)];
+}
+
+const char *CPU::getAddressingModeName(AddressingMode mode)
+{
+	return ADDRESSING_MODE_NAMES[static_cast<uint8_t>(mode)];
+}
+
 void CPU::writeOperand(uint8_t value, bool skipCallback)
 {
 	switch (operand.type)
@@ -258,22 +510,18 @@ uint8_t CPU::readOperand(bool skipCallback)
 	return 0;
 }
 
-void CPU::checkOverflow(int8_t target, int8_t result)
+void CPU::addWithCarry(uint8_t value)
 {
-	int8_t signedOperand = readOperand();
+	uint16_t result = a + value + hasFlag(Flag::Carry);
 
-	if (target > 0 && signedOperand > 0 && result < 0)
-	{
-		setFlag(Flag::Overflow);
-	}
-	else if (target < 0 && signedOperand < 0 && result > 0)
-	{
-		setFlag(Flag::Overflow);
-	}
-	else
-	{
-		clearFlag(Flag::Overflow);
-	}
+	checkNegative(result);
+	checkZero(result);
+
+	// Overflow if both values have the same sign, but the result has a different sign
+	setFlagValue(Flag::Overflow, ((a ^ result) & (value ^ result) & 0x80) != 0);
+	setFlagValue(Flag::Carry, result > 0xFF);
+
+	a = result;
 }
 
 void CPU::checkCarry(int16_t value)
@@ -316,9 +564,15 @@ int CPU::performBranch()
 {
 	// Update the PC
 	int8_t offset = readOperand();
+	uint16_t nextAddress = pc + instructionLength;
 	pc += offset;
 
-	// TODO: Check if branch occurs on same page or different page
+	// Taking the branch adds one cycle, and crossing over to a different page adds another
+	if ((nextAddress & 0xFF00) != ((nextAddress + offset) & 0xFF00))
+	{
+		return 2;
+	}
+
 	return 1;
 }
 
@@ -331,48 +585,48 @@ void CPU::jumpVector(uint16_t address)
 /* Addressing Modes */
 
 // Implicit or implied
-int CPU::IMP()
+bool CPU::IMP()
 {
 	// No operand
 	operand.type = OperandType::Invalid;
 	instructionLength = 1;
 
-	return 0;
+	return false;
 }
 
 // Accumulator
-int CPU::ACC()
+bool CPU::ACC()
 {
 	// Operand is accumulator
 	operand.type = OperandType::Accumulator;
 	instructionLength = 1;
 
-	return 0;
+	return false;
 }
 
 // Immediate
-int CPU::IMM()
+bool CPU::IMM()
 {
 	// Operand given in 1 byte after instruction
 	operand = { OperandType::Address,  pc + 1u };
 	instructionLength = 2;
 
-	return 0;
+	return false;
 }
 
 // Zero-page
-int CPU::ZPG()
+bool CPU::ZPG()
 {
 	// Operand is a memory address in range $0000-$00FF, in 1 byte after instruction
 	uint16_t address = bus.read(pc + 1);
 	operand = { OperandType::Address, address };
 	instructionLength = 2;
 
-	return 0;
+	return false;
 }
 
 // Zero-page, X
-int CPU::ZPX()
+bool CPU::ZPX()
 {
 	// Operand is a memory address in range $0000-$00FF added to X register
 	uint16_t address = bus.read(pc + 1) + x;
@@ -383,11 +637,11 @@ int CPU::ZPX()
 	operand = { OperandType::Address, address };
 	instructionLength = 2;
 
-	return 0;
+	return false;
 }
 
 // Zero-page, Y
-int CPU::ZPY()
+bool CPU::ZPY()
 {
 	// Operand is a memory address in range $0000-$00FF added to Y register
 	uint16_t address = bus.read(pc + 1) + y;
@@ -398,21 +652,22 @@ int CPU::ZPY()
 	operand = { OperandType::Address, address };
 	instructionLength = 2;
 
-	return 0;
+	return false;
 }
 
 // Relative (Only used by branch) [+]
-int CPU::REL()
+bool CPU::REL()
 {
 	// Operand is a SIGNED bit after the instruction
 	operand = { OperandType::Address, pc + 1u };
 	instructionLength = 2;
 
-	return 1;
+	// Page boundary crossing is handled when performing the branch
+	return false;
 }
 
 // Absolute
-int CPU::ABS()
+bool CPU::ABS()
 {
 	// Operand is an address after the instruction, stored in little-endian
 	uint16_t address = bus.read(pc + 2) << 8;
@@ -423,11 +678,11 @@ int CPU::ABS()
 	jumpTarget = address;
 	instructionLength = 3;
 
-	return 0;
+	return false;
 }
 
 // Absolute, X [+]
-int CPU::ABX()
+bool CPU::ABX()
 {
 	// Operand is an address after the instruction, stored in little-endian, added to X
 	uint16_t address = bus.read(pc + 2) << 8;
@@ -435,13 +690,12 @@ int CPU::ABX()
 	operand = { OperandType::Address, (uint16_t)(address + x) };
 	instructionLength = 3;
 
-	// TODO: Deal with carry
-	// TODO: Check if violating page boundary
-	return 1;
+	// Check if adding X crossed over to the next page
+	return (address & 0xFF00) != (operand.address & 0xFF00);
 }
 
 // Absolute, Y [+]
-int CPU::ABY()
+bool CPU::ABY()
 {
 	// Operand is an address after the instruction, stored in little-endian, added to Y
 	uint16_t address = bus.read(pc + 2) << 8;
@@ -449,13 +703,12 @@ int CPU::ABY()
 	operand = { OperandType::Address, (uint16_t)(address + y) };
 	instructionLength = 3;
 
-	// TODO: Deal with carry
-	// TODO: Check if violating page boundary
-	return 1;
+	// Check if adding Y crossed over to the next page
+	return (address & 0xFF00) != (operand.address & 0xFF00);
 }
 
 // Indirect (only used by JMP)
-int CPU::IND()
+bool CPU::IND()
 {
 	// Jump target is a 16-bit value at address specified after the instruction, stored in little-endian
 	uint16_t address = bus.read(pc + 2) << 8;
@@ -479,11 +732,11 @@ int CPU::IND()
 	operand.type = OperandType::Invalid;
 	instructionLength = 3;
 
-	return 0;
+	return false;
 }
 
 // Indirect, X
-int CPU::IDX()
+bool CPU::IDX()
 {
 	// Read the pointer address after the instruction and add X register to it
 	uint8_t pointer = bus.read(pc + 1);
@@ -497,25 +750,26 @@ int CPU::IDX()
 	operand = { OperandType::Address, address };
 	instructionLength = 2;
 
-	return 0;
+	return false;
 }
 
 // Indirect, Y [+]
-int CPU::IDY()
+bool CPU::IDY()
 {
 	// Read the pointer address after the instruction
 	uint8_t pointer = bus.read(pc + 1);
 
 	// Read the address located at the pointer (high-byte first), and add register Y to it
 	// Also ensuring that (pointer + 1) for fetching high byte follows zero-page wrap-around
-	uint16_t address = bus.read((pointer + 1) & 0xFF) << 8;
-	address |= bus.read(pointer);
-	address += y;
+	uint16_t baseAddress = bus.read((pointer + 1) & 0xFF) << 8;
+	baseAddress |= bus.read(pointer);
+	uint16_t address = baseAddress + y;
 
 	operand = { OperandType::Address, address };
 	instructionLength = 2;
 
-	return 1;
+	// Check if adding Y crossed over to the next page
+	return (baseAddress & 0xFF00) != (address & 0xFF00);
 }
 
 
@@ -530,25 +784,8 @@ int CPU::XXX()
 // A + M + C -> A, C (NZCV); Add with carry
 int CPU::ADC()
 {
-	uint16_t result = a + readOperand() + hasFlag(Flag::Carry);
-
-	checkNegative(result);
-	checkZero(result);
-	checkOverflow(a, result);
-
-	if (result > 0xFF)
-	{
-		setFlag(Flag::Carry);
-	}
-	else
-	{
-		clearFlag(Flag::Carry);
-	}
-
-	a = result;
-
-	// ABX, ABY, IDY add one cycle if page boundary crossed
-	return 1;
+	addWithCarry(readOperand());
+	return 0;
 }
 
 // A & M -> A (NZ); Logical AND on accumulator and memory
@@ -559,8 +796,7 @@ int CPU::AND()
 	checkNegative(a);
 	checkZero(a);
 
-	// ABX, ABY, IDY addressing modes add one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // M << 1 -> M; (NZC); Shift left by one bit
@@ -769,8 +1005,7 @@ int CPU::CMP()
 		clearFlag(Flag::Carry);
 	}
 
-	// ABX, ABY, IDY add one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // X - M; (NZC); Compare memory with X
@@ -791,8 +1026,7 @@ int CPU::CPX()
 		clearFlag(Flag::Carry);
 	}
 
-	// ABX, ABY, IDY add one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // Y - M; (NZC); Comapre memory with Y
@@ -813,8 +1047,7 @@ int CPU::CPY()
 		clearFlag(Flag::Carry);
 	}
 
-	// ABX, ABY, IDY add one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // M - 1 -> M; (NZ); Decrement memory by one
@@ -861,8 +1094,7 @@ int CPU::EOR()
 	checkNegative(a);
 	checkZero(a);
 
-	// ABX, ABY, IDY require extra cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // M + 1 -> M; (NZ); Increment memory by one
@@ -929,8 +1161,7 @@ int CPU::LDA()
 	checkNegative(a);
 	checkZero(a);
 
-	// ABX, ABY, IDY add one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // M -> X; (NZ); Load X with memory
@@ -941,8 +1172,7 @@ int CPU::LDX()
 	checkNegative(x);
 	checkZero(x);
 
-	// ABY adds one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // M -> Y; (NZ); Load Y with memory
@@ -953,8 +1183,7 @@ int CPU::LDY()
 	checkNegative(y);
 	checkZero(y);
 
-	// ABX adds one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // M >> 1 -> M; (NZC); Logically right shift operand
@@ -999,8 +1228,7 @@ int CPU::ORA()
 	checkZero(a);
 	checkNegative(a);
 
-	// ABX, ABY, IDY addressing modes add one cycle if page boundary crossed
-	return 1;
+	return 0;
 }
 
 // Push A; (); Push accumulator on stack
@@ -1165,14 +1393,9 @@ int CPU::RTS()
 // A - M - C -> A; (NZCV); Subtract memory from accumulator with borrow
 int CPU::SBC()
 {
-	// To perform subtraction, can invert all bits of operand (giving -operand - 1) and pass to ADC
-	uint8_t originalOperand = readOperand(true);
-
-	writeOperand(~originalOperand, true);
-	int ret = ADC();
-	writeOperand(originalOperand, true);
-
-	return ret;
+	// To perform subtraction, can invert all bits of operand (giving -operand - 1) and add with carry
+	addWithCarry(~readOperand());
+	return 0;
 }
 
 // 1 -> C; (C); Set carry flag
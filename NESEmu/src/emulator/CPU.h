@@ -1,11 +1,13 @@
 #pragma once
 
 #include "Bus.h"
-#include "../util/Logger.h"
+#include "Scheduler.h"
+#include "CPUTracer.h"
+#include "SaveState.h"
 
+#include <array>
 #include <cstdint>
-#include <string>
-#include <vector>
+#include <utility>
 
 // Handles emulation of the NES 6502 CPU
 class CPU
@@ -24,13 +26,46 @@ public:
 		Negative = 1 << 7
 	};
 
-	// A representation of the an instruction and it's associated addressing mode
-	struct Instruction
+	// All addressing modes supported by the 6502
+	enum class AddressingMode : uint8_t
 	{
-		std::string instruction;
-		int (CPU:: *run)(void);
-		int (CPU:: *addressingMode)(void);
+		IMP, ACC, IMM, ZPG, ZPX, ZPY, REL, ABS, ABX, ABY, IND, IDX, IDY
+	};
+
+	// All operations supported by the CPU (XXX is used for unknown or illegal opcodes)
+	enum class Operation : uint8_t
+	{
+		ADC, AND, ASL, BCC, BCS, BEQ, BIT, BMI, BNE, BPL, BRK, BVC, BVS, CLC,
+		CLD, CLI, CLV, CMP, CPX, CPY, DEC, DEX, DEY, EOR, INC, INX, INY, JMP,
+		JSR, LDA, LDX, LDY, LSR, NOP, ORA, PHA, PHP, PLA, PLP, ROL, ROR, RTI,
+		RTS, SBC, SEC, SED, SEI, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA,
+		XXX
+	};
+
+	// How an instruction accesses its operand in memory
+	enum class AccessType : uint8_t
+	{
+		None,
+		Read,
+		Write,
+		ReadModifyWrite
+	};
+
+	// Static description of an opcode, looked up from a constexpr table indexed by the opcode.
+	// Names are kept out of this table, since they are only needed by the debugger
+	struct Opcode
+	{
+		Operation operation;
+		AddressingMode mode;
+		AccessType access;
+		uint8_t length;
 		uint8_t cycles;
+
+		// Whether an extra cycle is needed when indexing crosses a page boundary
+		bool pageCrossCycle;
+
+		// Whether this is an official opcode
+		bool official;
 	};
 
 	// Represents current CPU state, used for debugging
@@ -39,15 +74,22 @@ public:
 		// Registers, PC, and total cycles
 		uint8_t a, x, y, p, sp;
 		uint16_t pc;
-		uint32_t totalCycles;
+		uint64_t totalCycles;
 		uint8_t instructionLength;
 
 		// Current instruction
 		uint8_t opcode, cycles;
-		std::string instruction = "";
-		std::string addressingMode = "";
+		const char *instruction;
+		const char *addressingMode;
 	} state;
 
+	// Registers, for running the CPU from outside of its own loop
+	struct Registers
+	{
+		uint8_t a, x, y, p, sp;
+		uint16_t pc;
+	};
+
 	// Type of operand
 	enum class OperandType
 	{
@@ -64,13 +106,29 @@ public:
 	};
 
 	// Initialize CPU
-	CPU(Bus &bus);
+	CPU(Bus &bus, Scheduler &scheduler);
 
 	// Reset CPU state
 	void reset();
 
-	// Step CPU by one single cycle
-	void step();
+	// Execute one whole instruction, and return the amount of cycles it took
+	uint32_t step();
+
+	// Execute whole instructions until the total cycle count reaches the target cycle or the next scheduled
+	// event is due, and return how many cycles the target was overshot by
+	uint64_t runUntil(uint64_t targetCycle);
+
+	// Handle a non-maskable interrupt
+	void nmi();
+
+	// Perform an OAM data transfer from the page written to OAMDMA, stalling the CPU
+	void oamDma();
+
+	// Returns the total amount of cycles executed since power on
+	uint64_t getTotalCycles() const;
+
+	// Record every executed instruction to the given tracer, or stop tracing if nullptr
+	void setTracer(CPUTracer *tracer);
 
 	// Set status flag
 	void setFlag(Flag flag);
@@ -90,9 +148,25 @@ public:
 	// Sets program counter
 	void setPC(uint16_t pc);
 
+	// Returns or replaces the registers
+	Registers getRegisters() const;
+	void setRegisters(const Registers &registers);
+
+	// Save or load the registers and cycle count
+	void serialize(StateSerializer &state);
+
 	// Returns current state of CPU and registers
 	State getState() const;
 
+	// Returns the opcode table entry for the given opcode
+	static const Opcode &getOpcode(uint8_t opcode);
+
+	// Returns the disassembly name of the given opcode
+	static const char *getInstructionName(uint8_t opcode);
+
+	// Returns the name of the given addressing mode
+	static const char *getAddressingModeName(AddressingMode mode);
+
 private:
 	// Registers
 	uint8_t a, x, y;
@@ -105,25 +179,45 @@ private:
 	uint16_t jumpTarget;
 	Operand operand;
 
-	// Cycle related stats
+	// Cycle related stats (cycles taken by the last instruction, and total cycles since power on)
 	uint8_t cycles;
-	uint32_t totalCycles;
+	uint64_t totalCycles;
 
 	// CPU bus
 	Bus &bus;
 
-	// Logger for debugging
-	Logger logger;
+	// Schedules interrupts and DMA
+	Scheduler &scheduler;
+
+	// Instruction trace, only recorded while set
+	CPUTracer *tracer;
+
+	// Opcode handler table, with one handler instantiated per opcode
+	using Handler = void (CPU:: *)(void);
+	static const std::array<Handler, 256> handlers;
 
-	// Instruction table
-	std::vector<Instruction> instructions;
+	// Build the opcode handler table at compile time
+	template <size_t... OPCODES>
+	static constexpr std::array<Handler, 256> makeHandlerTable(std::index_sequence<OPCODES...>);
+
+	// Execute a single opcode, with its addressing mode and operation resolved at compile time
+	template <uint8_t OPCODE>
+	void execute();
+
+	// Resolve the operand for the given addressing mode (returns true if a page boundary was crossed)
+	template <AddressingMode MODE>
+	bool resolveOperand();
+
+	// Run the given operation (returns the amount of extra cycles needed)
+	template <Operation OPERATION>
+	int runOperation();
 
 	// Accesors for operand (read and write)
 	void writeOperand(uint8_t value, bool skipCallback = false);
 	uint8_t readOperand(bool skipCallback = false);
 
-	// Sets overflow flag if result is an overflow
-	void checkOverflow(int8_t target, int8_t result);
+	// Adds value and carry to the accumulator, setting the NZCV flags (used by ADC and SBC)
+	void addWithCarry(uint8_t value);
 
 	// Sets carry flag if result requires a carry
 	void checkCarry(int16_t result);
@@ -140,14 +234,17 @@ private:
 	// Jump to a vector starting at given memory location
 	void jumpVector(uint16_t address);
 
-	// Addressing modes (return true if possible to need an extra cycle)
-	int IMP(), ACC(), IMM(), ZPG(), ZPX(), ZPY(), REL(),
+	// Called when memory on the bus is accessed
+	void onBusMemoryAccess(uint16_t address, uint8_t newValue, bool write);
+
+	// Addressing modes (return true if a page boundary was crossed while indexing)
+	bool IMP(), ACC(), IMM(), ZPG(), ZPX(), ZPY(), REL(),
 		ABS(), ABX(), ABY(), IND(), IDX(), IDY();
 
 	// Unknown or illegal instruction (same functionality as NOP)
 	int XXX();
 
-	// Instructions (return true if possible to need an extra cycle)
+	// Instructions (return the amount of extra cycles needed)
 	int ADC(), AND(), ASL(), BCC(), BCS(), BEQ(), BIT(), BMI(), BNE(), BPL(), BRK(), BVC(), BVS(), CLC(),
 		CLD(), CLI(), CLV(), CMP(), CPX(), CPY(), DEC(), DEX(), DEY(), EOR(), INC(), INX(), INY(), JMP(),
 		JSR(), LDA(), LDX(), LDY(), LSR(), NOP(), ORA(), PHA(), PHP(), PLA(), PLP(), ROL(), ROR(), RTI(),
@@ -0,0 +1,109 @@
+#include "CPUTracer.h"
+
+#include <chrono>
+
+// Enough records for a few frames of emulation, so the spill thread can fall behind without stalling the CPU
+static constexpr size_t BUFFER_CAPACITY = 1 << 17;
+
+// How long the spill thread sleeps when there is nothing to write
+static constexpr std::chrono::milliseconds IDLE_SLEEP(1);
+
+CPUTracer::CPUTracer(std::string path) : path(path), file(nullptr), buffer(BUFFER_CAPACITY), running(false), stallCount(0)
+{
+}
+
+CPUTracer::~CPUTracer()
+{
+	stop();
+}
+
+bool CPUTracer::start()
+{
+	if (running)
+	{
+		return true;
+	}
+
+	file = fopen(path.c_str(), "wb");
+
+	if (!file)
+	{
+		printf("Failed to open trace file: %s\n", path.c_str());
+		return false;
+	}
+
+	uint32_t recordSize = sizeof(Record);
+	fwrite(MAGIC, sizeof(MAGIC), 1, file);
+	fwrite(&VERSION, sizeof(VERSION), 1, file);
+	fwrite(&recordSize, sizeof(recordSize), 1, file);
+
+	stallCount = 0;
+	running = true;
+	thread = std::thread(&CPUTracer::spill, this);
+
+	return true;
+}
+
+void CPUTracer::stop()
+{
+	if (!running)
+	{
+		return;
+	}
+
+	running = false;
+	thread.join();
+
+	fclose(file);
+	file = nullptr;
+}
+
+bool CPUTracer::isRunning() const
+{
+	return running;
+}
+
+void CPUTracer::record(const Record &record)
+{
+	while (!buffer.push(record))
+	{
+		stallCount++;
+		std::this_thread::yield();
+	}
+}
+
+uint64_t CPUTracer::getStallCount() const
+{
+	return stallCount;
+}
+
+void CPUTracer::spill()
+{
+	while (running)
+	{
+		if (writePending() == 0)
+		{
+			std::this_thread::sleep_for(IDLE_SLEEP);
+		}
+	}
+
+	// The emulation thread has stopped recording, write what is left
+	writePending();
+}
+
+size_t CPUTracer::writePending()
+{
+	size_t written = 0;
+	const Record *records;
+	size_t count;
+
+	// Records wrap around the end of the ring buffer, so they may be returned in two parts
+	while ((count = buffer.peek(records)) > 0)
+	{
+		fwrite(records, sizeof(Record), count, file);
+		buffer.consume(count);
+		written += count;
+	}
+
+	return written;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../util/RingBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// Records executed CPU instructions as fixed-size binary records. Records are pushed into a lock-free ring
+// buffer by the emulation thread, and spilled to a file by a background thread. The resulting trace can be
+// converted to the nestest-compatible text log with scripts/tracedecode.py
+class CPUTracer
+{
+public:
+	// Trace file header, followed by a flat array of records
+	static constexpr char MAGIC[8] = { 'N', 'E', 'S', 'T', 'R', 'A', 'C', 'E' };
+	static constexpr uint32_t VERSION = 1;
+
+	// CPU state before executing an instruction
+	struct Record
+	{
+		uint64_t cycle;
+		uint16_t pc;
+		uint8_t a, x, y, p, sp;
+
+		// Instruction bytes, only the first length bytes are valid
+		uint8_t length;
+		uint8_t bytes[3];
+		uint8_t reserved[5];
+	};
+
+	static_assert(sizeof(Record) == 24, "Trace record layout must match the decoder");
+
+	// Create a tracer that writes to the given file once started
+	CPUTracer(std::string path);
+
+	// Stops tracing, writing any pending records
+	~CPUTracer();
+
+	// Open the trace file and start the spill thread (returns false if the file could not be opened)
+	bool start();
+
+	// Stop the spill thread after it has written all pending records, and close the file
+	void stop();
+
+	// Returns whether records are currently being written
+	bool isRunning() const;
+
+	// Add a record to the trace. Waits for the spill thread if the ring buffer is full, so no records are lost
+	void record(const Record &record);
+
+	// Returns how many times recording had to wait for the spill thread
+	uint64_t getStallCount() const;
+
+private:
+	std::string path;
+	FILE *file;
+
+	RingBuffer<Record> buffer;
+	std::thread thread;
+	std::atomic<bool> running;
+	uint64_t stallCount;
+
+	// Spill thread: writes records from the ring buffer to the file until stopped
+	void spill();
+
+	// Write all records currently in the ring buffer, and return how many were written
+	size_t writePending();
+};
@@ -1,10 +1,17 @@
 #include "Cartridge.h"
 #include "MapperFactory.h"
+#include "../util/Utils.h"
 
 #include <fstream>
 #include <cerrno>
+#include <cstring>
 
-Cartridge::Cartridge() : header({ 0 }), path(""), mapper(nullptr)
+Cartridge::Cartridge() : header({ 0 }), romHash(0), path(""), mapper(nullptr)
+{
+
+}
+
+Cartridge::~Cartridge()
 {
 
 }
@@ -56,12 +63,10 @@ bool Cartridge::load(std::string path)
 		chrRom.push_back(byte);
 	}
 
-	// Create mapper
-	if (mapper)
-	{
-		delete mapper;
-	}
+	romHash = utils::fnv1a(prgRom.data(), prgRom.size());
+	romHash = utils::fnv1a(chrRom.data(), chrRom.size(), romHash);
 
+	// Create mapper, replacing the one of the previous ROM
 	mapper = MapperFactory::createMapper(*this);
 
 	if (!mapper)
@@ -103,7 +108,17 @@ uint8_t Cartridge::getMapperID() const
 	return header.flags6.mapperLowerNibble & (header.flags7.mapperUpperNibble << 4);
 }
 
+uint64_t Cartridge::getRomHash() const
+{
+	return romHash;
+}
+
 IMapper *Cartridge::getMapper()
 {
-	return mapper;
-}
\ No newline at end of file
+	return mapper.get();
+}
+
+size_t Cartridge::getMemorySize()
+{
+	return prgRom.capacity() + chrRom.capacity() + (mapper ? mapper->getMemorySize() : 0);
+}
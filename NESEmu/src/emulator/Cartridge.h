@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 // Forward declarations
 class IMapper;
@@ -53,6 +54,9 @@ public:
 	// Initialize cartridge
 	Cartridge();
 
+	// Defined where the mapper type is complete, since the cartridge owns it
+	~Cartridge();
+
 	// Load ROM from given file path
 	bool load(std::string path);
 
@@ -67,19 +71,26 @@ public:
 	// Returns the mapper ID associated with the ROM
 	uint8_t getMapperID() const;
 
+	// Returns a hash of the PRG and CHR ROM, identifying the loaded ROM
+	uint64_t getRomHash() const;
+
 	// Returns the active mapper
 	IMapper *getMapper();
 
+	// Returns the bytes of memory used by the ROM data and the mapper
+	size_t getMemorySize();
+
 private:
 	// iNES ROM data
 	Header header;
 	std::vector<uint8_t> prgRom;
 	std::vector<uint8_t> chrRom;
+	uint64_t romHash;
 
 	// ROM path on disk
 	std::string path;
 
 	// Mapper used for this ROM
-	IMapper *mapper;
+	std::unique_ptr<IMapper> mapper;
 };
 
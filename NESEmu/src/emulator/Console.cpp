@@ -0,0 +1,268 @@
+#include "Console.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+Console::Console() : cpu(bus, scheduler), ppu(bus, scheduler), controller(bus, Bus::JOY1), tracer("../logs/cpu.trace"),
+	breakRequested(false), overshotCycles(0)
+{
+	// The PPU is only run when the CPU accesses its registers, or when one of its events is due
+	bus.setPpuSyncCallback([this]() { syncPpu(); });
+
+	scheduler.setCallback(Scheduler::EventType::Break, [this](uint64_t) { breakRequested = true; });
+}
+
+bool Console::load(std::string path)
+{
+	if (!cartridge.load(path))
+	{
+		return false;
+	}
+
+	bus.setMapper(cartridge.getMapper());
+	ppu.setMapper(cartridge.getMapper());
+
+	cpu.reset();
+	ppu.reset();
+
+	return true;
+}
+
+void Console::step()
+{
+	cpu.step();
+	dispatchEvents();
+	syncPpu();
+	controller.update();
+}
+
+bool Console::runCycles(uint32_t cycles)
+{
+	// Cycles overshot by the last instruction of the previous run are taken out of this budget
+	uint64_t targetCycle = cpu.getTotalCycles() + cycles - std::min<uint64_t>(overshotCycles, cycles);
+	bool finished = runUntil(targetCycle);
+
+	// A break stops the run before the target is reached
+	overshotCycles = cpu.getTotalCycles() > targetCycle ? cpu.getTotalCycles() - targetCycle : 0;
+
+	return finished;
+}
+
+bool Console::runFrame()
+{
+	syncPpu();
+
+	// First CPU cycle that ends at or after the PPU cycle that starts the next frame
+	uint64_t frameStart = ppu.getNextFrameCycle() * Scheduler::PPU_CLOCK_DIVIDER;
+	uint64_t targetCycle = (frameStart + Scheduler::CPU_CLOCK_DIVIDER - 1) / Scheduler::CPU_CLOCK_DIVIDER;
+
+	return runUntil(targetCycle);
+}
+
+bool Console::runDrawnFrame()
+{
+	// The first run ends within scanline 0 of the next frame, which is drawn even without pixel output
+	ppu.setPixelOutput(false);
+	bool finished = runFrame();
+	ppu.setPixelOutput(true);
+
+	return finished && runFrame();
+}
+
+bool Console::runUntil(uint64_t targetCycle)
+{
+	controller.update();
+	breakRequested = false;
+
+	while (!breakRequested && cpu.getTotalCycles() < targetCycle)
+	{
+		// Run the CPU straight to the target, or to the next scheduled event
+		cpu.runUntil(targetCycle);
+		dispatchEvents();
+	}
+
+	syncPpu();
+
+	return !breakRequested;
+}
+
+bool Console::runAhead(uint32_t frames, SaveState &state)
+{
+	// The rendered frames are left out of the savestate, so that restoring it keeps the frame drawn ahead shown.
+	// Its first scanline is drawn at the end of the frame before, even while pixel output is off
+	if (frames == 0 || !saveState(state, false))
+	{
+		return false;
+	}
+
+	// Frames run ahead did not happen yet, so they are kept out of the trace and the debugger
+	bool watchesArmed = bus.getDebugWatchesArmed();
+	cpu.setTracer(nullptr);
+
+	if (watchesArmed)
+	{
+		bus.setDebugWatchesArmed(false);
+	}
+
+	// A break stops running ahead, but the console is still restored to where it was
+	bool completed = true;
+
+	for (uint32_t i = 0; i < frames && completed; i++)
+	{
+		ppu.setPixelOutput(i + 1 == frames);
+		completed = runFrame();
+	}
+
+	ppu.setPixelOutput(true);
+	bool restored = loadState(state);
+
+	if (watchesArmed)
+	{
+		bus.setDebugWatchesArmed(true);
+	}
+
+	if (tracer.isRunning())
+	{
+		cpu.setTracer(&tracer);
+	}
+
+	return completed && restored;
+}
+
+void Console::requestBreak()
+{
+	scheduler.schedule(Scheduler::EventType::Break, cpu.getTotalCycles() * Scheduler::CPU_CLOCK_DIVIDER);
+}
+
+void Console::setTracing(bool enabled)
+{
+	if (enabled && tracer.start())
+	{
+		cpu.setTracer(&tracer);
+	}
+	else
+	{
+		cpu.setTracer(nullptr);
+		tracer.stop();
+	}
+}
+
+bool Console::getTracing() const
+{
+	return tracer.isRunning();
+}
+
+void Console::setInputCallback(Controller::InputCallback callback)
+{
+	controller.setInputCallback(callback);
+}
+
+bool Console::saveState(SaveState &state, bool framebuffers)
+{
+	if (!cartridge.getMapper())
+	{
+		return false;
+	}
+
+	// The PPU is caught up first, so that the state is the same as if it ran along with the CPU
+	syncPpu();
+
+	SaveState::Header &header = state.getHeader();
+	header.magic = SaveState::MAGIC;
+	header.version = SaveState::VERSION;
+	header.romHash = cartridge.getRomHash();
+	header.frame = ppu.getFrameCount();
+	header.flags = framebuffers ? SaveState::FRAMEBUFFERS : 0;
+
+	StateSerializer serializer(state.getChunks(), framebuffers);
+	serialize(serializer);
+
+	return true;
+}
+
+bool Console::loadState(const SaveState &state)
+{
+	const SaveState::Header &header = state.getHeader();
+
+	if (header.magic != SaveState::MAGIC || header.version != SaveState::VERSION)
+	{
+		printf("Error, savestate version %u can not be loaded\n", header.version);
+		return false;
+	}
+
+	if (header.romHash != cartridge.getRomHash() || !cartridge.getMapper())
+	{
+		printf("Error, savestate was made with another ROM\n");
+		return false;
+	}
+
+	StateSerializer serializer(Span<const uint8_t>(state.getChunks()), (header.flags & SaveState::FRAMEBUFFERS) != 0);
+	serialize(serializer);
+
+	if (serializer.hasFailed())
+	{
+		printf("Error, savestate is corrupted\n");
+		return false;
+	}
+
+	return true;
+}
+
+size_t Console::getMemorySize()
+{
+	return sizeof(Console) + cartridge.getMemorySize();
+}
+
+CPU &Console::getCPU()
+{
+	return cpu;
+}
+
+PPU &Console::getPPU()
+{
+	return ppu;
+}
+
+Bus &Console::getBus()
+{
+	return bus;
+}
+
+Cartridge &Console::getCartridge()
+{
+	return cartridge;
+}
+
+Controller &Console::getController()
+{
+	return controller;
+}
+
+void Console::syncPpu()
+{
+	// 1 CPU cycle = 3 PPU cycles
+	ppu.runUntil(cpu.getTotalCycles() * Scheduler::CPU_CLOCK_DIVIDER / Scheduler::PPU_CLOCK_DIVIDER);
+}
+
+void Console::serialize(StateSerializer &state)
+{
+	state.beginChunk(StateSerializer::ChunkId::Console);
+	state.value(overshotCycles);
+	state.endChunk();
+
+	scheduler.serialize(state);
+	bus.serialize(state);
+	cpu.serialize(state);
+	ppu.serialize(state);
+	controller.serialize(state);
+	cartridge.getMapper()->serialize(state);
+}
+
+void Console::dispatchEvents()
+{
+	// Events can stall the CPU (OAM DMA), making more events due
+	while (scheduler.getNextEventTime() <= cpu.getTotalCycles() * Scheduler::CPU_CLOCK_DIVIDER)
+	{
+		scheduler.dispatch(cpu.getTotalCycles() * Scheduler::CPU_CLOCK_DIVIDER);
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "CPU.h"
+#include "PPU.h"
+#include "Bus.h"
+#include "Cartridge.h"
+#include "Controller.h"
+#include "Scheduler.h"
+#include "CPUTracer.h"
+#include "SaveState.h"
+
+#include <string>
+
+// The emulated NES hardware, without any windowing or rendering. Keeps every component in sync,
+// and can be run on its own (headless) or driven by the NES front-end
+class Console
+{
+public:
+	// NTSC timing: a frame is 89342 PPU cycles, or 29780.67 CPU cycles, at ~60.0988Hz
+	static constexpr double FRAME_MASTER_CYCLES = PPU::CYCLES_PER_FRAME * Scheduler::PPU_CLOCK_DIVIDER;
+	static constexpr double CPU_CYCLES_PER_FRAME = FRAME_MASTER_CYCLES / Scheduler::CPU_CLOCK_DIVIDER;
+	static constexpr double FRAME_RATE_HZ = Scheduler::MASTER_CLOCK_HZ / FRAME_MASTER_CYCLES;
+
+	// Initialize and connect all components
+	Console();
+
+	// Load a ROM from given path and reset, returns false if the ROM could not be loaded
+	bool load(std::string path);
+
+	// Emulate one single CPU instruction, and catch the other components up to the CPU
+	void step();
+
+	// Emulate whole instructions for the given amount of CPU cycles. Cycles overshot are carried over to the next call.
+	// Returns false if a break stopped the run early
+	bool runCycles(uint32_t cycles);
+
+	// Emulate until the PPU starts the next frame. Returns false if a break stopped the run early
+	bool runFrame();
+
+	// Emulate without drawing until the PPU starts the next frame, then draw the whole frame after it. Shows a
+	// savestate without framebuffers, which can be anywhere in a frame. Leaves pixel output enabled, and returns false
+	// if a break stopped the run early
+	bool runDrawnFrame();
+
+	// Emulate the given amount of frames ahead with the current input, and only keep the last one's picture: every
+	// other component is restored afterwards, using the given savestate as scratch memory. Nothing is traced and no
+	// debug watch is called while running ahead. Must be called at the start of a frame, and leaves pixel output
+	// enabled. Returns false if a break stopped it early, or if the console could not be saved or restored
+	bool runAhead(uint32_t frames, SaveState &state);
+
+	// Stop the current run once the current instruction is done
+	void requestBreak();
+
+	// Start or stop recording a trace of every executed CPU instruction
+	void setTracing(bool enabled);
+
+	// Gets whether CPU instructions are being traced
+	bool getTracing() const;
+
+	// Set the callback used to read controller input
+	void setInputCallback(Controller::InputCallback callback);
+
+	// Save the state of every component into a savestate, reusing its memory. The rendered frames can be left out,
+	// when the next frame is emulated before showing one anyway: loading such a savestate keeps the frames rendered
+	// since. Returns false if no ROM is loaded
+	bool saveState(SaveState &state, bool framebuffers = true);
+
+	// Restore every component from a savestate. Returns false if it was made with another ROM or version, or is
+	// corrupted, in which case the console may be left partially restored
+	bool loadState(const SaveState &state);
+
+	// Returns the bytes of memory used by the console: its components, the ROM data and the mapper
+	size_t getMemorySize();
+
+	// Component accessors
+	CPU &getCPU();
+	PPU &getPPU();
+	Bus &getBus();
+	Cartridge &getCartridge();
+	Controller &getController();
+
+private:
+	// Components, in construction order
+	Scheduler scheduler;
+	Bus bus;
+	Cartridge cartridge;
+	CPU cpu;
+	PPU ppu;
+	Controller controller;
+
+	// CPU instruction trace, written to a binary file
+	CPUTracer tracer;
+
+	// Whether a break was hit during the current run
+	bool breakRequested;
+
+	// Amount of CPU cycles the last call to runCycles overshot its target by
+	uint64_t overshotCycles;
+
+	// Run whole instructions until the CPU reaches the target cycle, returns false if a break stopped the run early
+	bool runUntil(uint64_t targetCycle);
+
+	// Catch the PPU up to the current CPU cycle
+	void syncPpu();
+
+	// Save or load every component, in the same order
+	void serialize(StateSerializer &state);
+
+	// Dispatch all scheduled events that are due at the current CPU cycle
+	void dispatchEvents();
+};
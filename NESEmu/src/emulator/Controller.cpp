@@ -8,7 +8,7 @@ using std::placeholders::_3;
 Controller::Controller(Bus &bus, uint16_t port) : bus(bus), outputRegister(port), currentIndex(0), strobe(false)
 {
 	buttonStates.reset();
-	bus.registerMemoryAccessCallback(bind(&Controller::onBusMemoryAccess, this, _1, _2, _3));
+	bus.registerMemoryWatch(Bus::JOY1, Bus::JOY2, bind(&Controller::onBusMemoryAccess, this, _1, _2, _3));
 }
 
 Controller::ButtonStates Controller::getButtonStates()
@@ -26,6 +26,36 @@ bool Controller::isPolling()
 	return strobe;
 }
 
+void Controller::setInputCallback(InputCallback callback)
+{
+	inputCallback = callback;
+}
+
+void Controller::update()
+{
+	if (strobe && inputCallback)
+	{
+		buttonStates = inputCallback();
+	}
+}
+
+void Controller::serialize(StateSerializer &state)
+{
+	// Button states are saved as a byte, since bitset is not guaranteed to be trivially copyable
+	uint8_t buttons = static_cast<uint8_t>(buttonStates.to_ulong());
+
+	state.beginChunk(StateSerializer::ChunkId::Controller);
+	state.value(currentIndex);
+	state.value(strobe);
+	state.value(buttons);
+	state.endChunk();
+
+	if (state.isLoading())
+	{
+		buttonStates = ButtonStates(buttons);
+	}
+}
+
 void Controller::onBusMemoryAccess(uint16_t address, uint8_t newValue, bool write)
 {
 	if (address == Bus::JOY1 && write)
@@ -33,6 +63,11 @@ void Controller::onBusMemoryAccess(uint16_t address, uint8_t newValue, bool writ
 		// We only care about bit 0
 		strobe = (newValue & 0b1) == 1;
 
+		if (strobe && inputCallback)
+		{
+			buttonStates = inputCallback();
+		}
+
 		// Start reading inputs in serial mode when strobe is disabled
 		if (!strobe)
 		{
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "Bus.h"
+#include "SaveState.h"
 
 #include <cstdint>
 #include <bitset>
+#include <functional>
 
 class Controller
 {
@@ -23,12 +25,22 @@ public:
 	};
 
 	using ButtonStates = std::bitset<static_cast<size_t>(Button::COUNT)>;
+	using InputCallback = std::function<ButtonStates()>;
 
 	Controller(Bus &bus, uint16_t port);
 	ButtonStates getButtonStates();
 	void setButtonStates(ButtonStates states);
 	bool isPolling();
 
+	// Set the callback used to read the current input whenever the button states are strobed
+	void setInputCallback(InputCallback callback);
+
+	// Read the current input again if the button states are being strobed continuously
+	void update();
+
+	// Save or load the strobe and shift register state
+	void serialize(StateSerializer &state);
+
 private:
 	Bus &bus;
 	uint16_t outputRegister;
@@ -37,6 +49,7 @@ private:
 	// Poll (strobe) current button states
 	bool strobe;
 	ButtonStates buttonStates;
+	InputCallback inputCallback;
 
 	void onBusMemoryAccess(uint16_t address, uint8_t newValue, bool write);
 	void updateOutput();
@@ -0,0 +1,335 @@
+#include "EmulationThread.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+EmulationThread::EmulationThread(Console &console, double frameRate, double cyclesPerFrame)
+	: console(console), pacer(frameRate, cyclesPerFrame), stopRequested(false), consoleLockWaiters(0),
+	commands(COMMAND_CAPACITY), running(false), speed(1.0), buttons(), rewindBuffer(REWIND_BUFFER_SIZE, REWIND_SNAPSHOTS),
+	rewinding(false), lastCaptureFrame(0), runAheadFrames(0), turbo(false), frameSkip(0), framesSincePresent(0),
+	measureStartCycles(0), measureStartFrames(0), throughput()
+{
+	presentInterval = std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+
+	// Input is posted by the UI thread, and only read here whenever the game strobes the controller
+	console.setInputCallback([this]() { return buttons; });
+}
+
+EmulationThread::~EmulationThread()
+{
+	stop();
+}
+
+void EmulationThread::start(int core)
+{
+	if (thread.joinable())
+	{
+		return;
+	}
+
+	stopRequested = false;
+	thread = std::thread(&EmulationThread::threadMain, this);
+
+	if (core >= 0 && !pinToCore(core))
+	{
+		printf("Failed to pin emulation thread to core %d\n", core);
+	}
+}
+
+void EmulationThread::stop()
+{
+	if (!thread.joinable())
+	{
+		return;
+	}
+
+	stopRequested = true;
+	thread.join();
+}
+
+bool EmulationThread::post(CommandType type, double value)
+{
+	return commands.push({ type, value, Controller::ButtonStates() });
+}
+
+bool EmulationThread::postInput(Controller::ButtonStates buttons)
+{
+	return commands.push({ CommandType::SetInput, 0, buttons });
+}
+
+bool EmulationThread::updateFrame()
+{
+	return frames.update();
+}
+
+const EmulationThread::Frame &EmulationThread::getFrame() const
+{
+	return frames.getReadBuffer();
+}
+
+bool EmulationThread::isRunning() const
+{
+	return running;
+}
+
+std::unique_lock<std::mutex> EmulationThread::lockConsole()
+{
+	// Counted as waiting, so that the emulation thread does not take the lock back right away in turbo mode
+	consoleLockWaiters++;
+	std::unique_lock<std::mutex> lock(consoleMutex);
+	consoleLockWaiters--;
+
+	return lock;
+}
+
+void EmulationThread::threadMain()
+{
+	pacer.reset();
+	measureStart = FramePacer::Clock::now();
+
+	while (!stopRequested)
+	{
+		bool paced;
+
+		{
+			std::lock_guard<std::mutex> lock(consoleMutex);
+			processCommands();
+			paced = !turbo || !running || rewinding;
+
+			if (rewinding)
+			{
+				runRewindFrame();
+			}
+			else if (paced && running && runAheadFrames > 0 && speed == 1.0)
+			{
+				runAheadFrame();
+			}
+			else if (paced)
+			{
+				// Run one frame worth of cycles, scaled by the emulation speed. A break pauses the emulation
+				console.getPPU().setPixelOutput(true);
+
+				if (running && !console.runCycles(pacer.takeCycles(speed)))
+				{
+					running = false;
+				}
+
+				publishFrame();
+			}
+			else
+			{
+				runTurboFrame();
+			}
+
+			captureRewind();
+			measureThroughput();
+		}
+
+		// The console is unlocked in between frames, which is when the UI can inspect it
+		while (consoleLockWaiters > 0)
+		{
+			std::this_thread::yield();
+		}
+
+		if (paced)
+		{
+			pacer.wait();
+		}
+	}
+}
+
+void EmulationThread::processCommands()
+{
+	Command command;
+
+	while (commands.pop(command))
+	{
+		switch (command.type)
+		{
+		case CommandType::SetRunning:
+			running = command.value != 0;
+			break;
+
+		case CommandType::SetSpeed:
+			speed = command.value;
+			break;
+
+		case CommandType::SetTurbo:
+			turbo = command.value != 0;
+
+			// The paced schedule restarts from now, instead of catching up to the time spent in turbo
+			if (!turbo)
+			{
+				pacer.reset();
+			}
+
+			break;
+
+		case CommandType::SetFrameSkip:
+			frameSkip = static_cast<uint32_t>(command.value);
+			break;
+
+		case CommandType::SetTracing:
+			console.setTracing(command.value != 0);
+			break;
+
+		case CommandType::SetRewinding:
+			rewinding = command.value != 0;
+			break;
+
+		case CommandType::SetRunAhead:
+			runAheadFrames = std::min(static_cast<uint32_t>(command.value), MAX_RUN_AHEAD);
+			break;
+
+		case CommandType::SetInput:
+			buttons = command.buttons;
+			break;
+
+		case CommandType::Step:
+			console.step();
+			break;
+		}
+	}
+}
+
+void EmulationThread::runTurboFrame()
+{
+	FramePacer::Clock::time_point now = FramePacer::Clock::now();
+	bool present = frameSkip > 0 ? framesSincePresent + 1 >= frameSkip : now - lastPresent >= presentInterval;
+
+	// Frames that are not presented are not drawn either
+	console.getPPU().setPixelOutput(present);
+
+	if (!console.runFrame())
+	{
+		running = false;
+	}
+
+	if (present)
+	{
+		publishFrame();
+		framesSincePresent = 0;
+		lastPresent = now;
+	}
+	else
+	{
+		framesSincePresent++;
+	}
+}
+
+void EmulationThread::runAheadFrame()
+{
+	// Whole frames are run instead of the paced amount of cycles, so that the frame shown ahead starts at the top
+	console.getPPU().setPixelOutput(false);
+
+	if (!console.runFrame())
+	{
+		// A break leaves the frame shown last
+		running = false;
+		console.getPPU().setPixelOutput(true);
+		return;
+	}
+
+	if (!console.runAhead(runAheadFrames, runAheadState))
+	{
+		// The console may be left in the future it ran ahead to, so it is paused instead of carrying on from there
+		printf("Error, could not run ahead, pausing the emulation\n");
+		running = false;
+		console.getPPU().setPixelOutput(true);
+		return;
+	}
+
+	publishFrame();
+}
+
+void EmulationThread::runRewindFrame()
+{
+	// Snapshots have no framebuffers, and are captured wherever the paced budget ended, so the first whole frame
+	// after the snapshot is emulated to show it
+	if (rewindBuffer.rewind(console))
+	{
+		console.runDrawnFrame();
+		lastCaptureFrame = console.getPPU().getFrameCount();
+	}
+
+	publishFrame();
+}
+
+void EmulationThread::captureRewind()
+{
+	uint32_t frameCount = console.getPPU().getFrameCount();
+
+	if (!running || rewinding || frameCount == lastCaptureFrame)
+	{
+		return;
+	}
+
+	rewindBuffer.capture(console);
+	lastCaptureFrame = frameCount;
+}
+
+void EmulationThread::measureThroughput()
+{
+	FramePacer::Clock::time_point now = FramePacer::Clock::now();
+	double elapsed = std::chrono::duration<double>(now - measureStart).count();
+
+	if (elapsed < THROUGHPUT_INTERVAL)
+	{
+		return;
+	}
+
+	uint64_t cycles = console.getCPU().getTotalCycles();
+	uint32_t frameCount = console.getPPU().getFrameCount();
+
+	// Loading a savestate can move the counters back, the measurement restarts from there
+	if (cycles < measureStartCycles || frameCount < measureStartFrames)
+	{
+		measureStart = now;
+		measureStartCycles = cycles;
+		measureStartFrames = frameCount;
+		return;
+	}
+
+	throughput.fps = (frameCount - measureStartFrames) / elapsed;
+	throughput.mhz = (cycles - measureStartCycles) / elapsed / 1e6;
+
+	measureStart = now;
+	measureStartCycles = cycles;
+	measureStartFrames = frameCount;
+}
+
+void EmulationThread::publishFrame()
+{
+	Frame &frame = frames.getWriteBuffer();
+	frame.pixels = console.getPPU().getFramebuffer();
+	frame.stats = pacer.getStats();
+	frame.throughput = throughput;
+	frame.rewind = rewindBuffer.getStats();
+	frame.frameCount = console.getPPU().getFrameCount();
+	frame.cpu = console.getCPU().getState();
+	frame.tracing = console.getTracing();
+	frames.publish();
+}
+
+bool EmulationThread::pinToCore(int core)
+{
+#ifdef _WIN32
+	return SetThreadAffinityMask(thread.native_handle(), static_cast<DWORD_PTR>(1) << core) != 0;
+#elif defined(__linux__)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+	return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) == 0;
+#else
+	return false;
+#endif
+}
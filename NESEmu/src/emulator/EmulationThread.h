@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Console.h"
+#include "RewindBuffer.h"
+#include "../util/FramePacer.h"
+#include "../util/RingBuffer.h"
+#include "../util/TripleBuffer.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Runs a console on its own thread, paced to the NES frame rate, so that emulation and the UI do not slow each other
+// down. The UI thread controls it by posting commands, and takes finished frames from a triple buffer, neither of
+// which takes the console lock. The UI only locks the console briefly to copy out what its views show, or for a whole
+// UI frame while a window inspecting the live console state is open
+class EmulationThread
+{
+public:
+	enum class CommandType : uint8_t
+	{
+		SetRunning,
+		SetSpeed,
+		SetTurbo,
+		SetFrameSkip,
+		SetTracing,
+		SetRewinding,
+		SetRunAhead,
+		SetInput,
+		Step
+	};
+
+	// Command posted to the emulation thread, applied before the next frame is emulated
+	struct Command
+	{
+		CommandType type;
+		double value; // Speed, frame skip, run-ahead frames, or 0/1 for running/turbo/tracing/rewinding
+		Controller::ButtonStates buttons;
+	};
+
+	// Emulation rate measured over the last THROUGHPUT_INTERVAL seconds
+	struct Throughput
+	{
+		double fps;
+		double mhz; // CPU cycles
+	};
+
+	// A finished frame, along with the emulation timing at that point
+	struct Frame
+	{
+		PPU::Framebuffer pixels;
+		FramePacer::Stats stats;
+		Throughput throughput;
+		RewindBuffer::Stats rewind;
+		uint32_t frameCount;
+
+		// Debugger state, so that showing it does not need the console lock
+		CPU::State cpu;
+		bool tracing;
+	};
+
+	// Commands that can be queued before the emulation thread applies them
+	static constexpr size_t COMMAND_CAPACITY = 64;
+
+	// Seconds the emulation rate is measured over
+	static constexpr double THROUGHPUT_INTERVAL = 0.5;
+
+	// Memory for the rewind history, and how many snapshots (one per frame) it keeps at most: 10 minutes at 60 FPS
+	static constexpr size_t REWIND_BUFFER_SIZE = 48 * 1024 * 1024;
+	static constexpr uint32_t REWIND_SNAPSHOTS = 10 * 60 * 60;
+
+	// Most frames the emulation can run ahead of the shown frame
+	static constexpr uint32_t MAX_RUN_AHEAD = 4;
+
+	// Emulate the console at the given frame rate, each frame running the given amount of CPU cycles at normal speed
+	EmulationThread(Console &console, double frameRate, double cyclesPerFrame);
+
+	// Stops the thread
+	~EmulationThread();
+
+	// Start emulating on a new thread, optionally pinned to a CPU core (-1 for any)
+	void start(int core = -1);
+
+	// Stop the thread once the current frame is done, and wait for it
+	void stop();
+
+	// Post a command from the UI thread, returns false if the queue is full
+	bool post(CommandType type, double value = 0);
+
+	// Post the current controller input from the UI thread, returns false if the queue is full
+	bool postInput(Controller::ButtonStates buttons);
+
+	// UI thread: take the latest finished frame if there is a new one, and return whether there was
+	bool updateFrame();
+
+	// UI thread: returns the frame taken by the last call to updateFrame()
+	const Frame &getFrame() const;
+
+	// Returns whether the emulation is running or paused, as of the last emulated frame
+	bool isRunning() const;
+
+	// Lock the console to access it from another thread. The emulation thread holds the lock while emulating
+	// a frame, and lets waiting threads take it in between frames, even when it is not waiting for the next one
+	std::unique_lock<std::mutex> lockConsole();
+
+private:
+	Console &console;
+	FramePacer pacer;
+
+	std::thread thread;
+	std::atomic<bool> stopRequested;
+	std::mutex consoleMutex;
+	std::atomic<uint32_t> consoleLockWaiters;
+
+	RingBuffer<Command> commands;
+	TripleBuffer<Frame> frames;
+
+	// Emulation state, only changed by the emulation thread
+	std::atomic<bool> running;
+	double speed;
+	Controller::ButtonStates buttons;
+
+	// While rewinding, every paced frame steps back to the previous snapshot instead of emulating
+	RewindBuffer rewindBuffer;
+	bool rewinding;
+	uint32_t lastCaptureFrame;
+
+	// Paced frames at normal speed run whole frames, then show the frame that many frames ahead of them, hiding
+	// the frames of latency games have between reading input and showing its result
+	uint32_t runAheadFrames;
+	SaveState runAheadState;
+
+	// Turbo runs whole frames uncapped, and only presents every frameSkip-th frame, or once every presentInterval
+	// when frameSkip is 0
+	bool turbo;
+	uint32_t frameSkip;
+	uint32_t framesSincePresent;
+	FramePacer::Clock::duration presentInterval;
+	FramePacer::Clock::time_point lastPresent;
+
+	// Start of the current throughput measurement
+	FramePacer::Clock::time_point measureStart;
+	uint64_t measureStartCycles;
+	uint32_t measureStartFrames;
+	Throughput throughput;
+
+	// Emulation thread loop
+	void threadMain();
+
+	// Apply all posted commands
+	void processCommands();
+
+	// Emulate one whole frame as fast as possible, drawing and presenting it only if it is due
+	void runTurboFrame();
+
+	// Emulate one whole frame without drawing it, then present the frame runAheadFrames ahead of it
+	void runAheadFrame();
+
+	// Restore the newest snapshot of the rewind history, and present the first whole frame that follows it
+	void runRewindFrame();
+
+	// Snapshot the console for rewinding once per emulated frame
+	void captureRewind();
+
+	// Update the throughput once the measurement interval has passed
+	void measureThroughput();
+
+	// Copy the last rendered frame into the triple buffer
+	void publishFrame();
+
+	// Pin the thread to a CPU core, returns false if not supported or it failed
+	bool pinToCore(int core);
+};
@@ -0,0 +1,232 @@
+#include "EmulatorPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+EmulatorPool::EmulatorPool(uint32_t threads) : runGeneration(0), stopRequested(false), instancesLeft(0),
+	breakHit(false), lastRunFrames(0), lastRunSeconds(0)
+{
+	if (threads == 0)
+	{
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	for (uint32_t i = 0; i < threads; i++)
+	{
+		queues.emplace_back(new WorkQueue());
+		queues.back()->first = 0;
+		queues.back()->count = 0;
+	}
+
+	for (uint32_t i = 0; i < threads; i++)
+	{
+		workers.emplace_back(&EmulatorPool::workerMain, this, i);
+	}
+}
+
+EmulatorPool::~EmulatorPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopRequested = true;
+	}
+
+	runStarted.notify_all();
+
+	for (std::thread &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+int EmulatorPool::add(const std::string &romPath)
+{
+	std::unique_ptr<Instance> instance(new Instance());
+	instance->buttons = Controller::ButtonStates();
+	instance->framesLeft = 0;
+
+	if (!instance->console.load(romPath))
+	{
+		return -1;
+	}
+
+	Instance *added = instance.get();
+	instance->console.setInputCallback([added]() { return added->buttons; });
+	instances.push_back(std::move(instance));
+
+	// Work stealing can move every console into a single queue
+	for (std::unique_ptr<WorkQueue> &queue : queues)
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->instances.resize(instances.size());
+	}
+
+	return static_cast<int>(instances.size() - 1);
+}
+
+uint32_t EmulatorPool::getInstanceCount() const
+{
+	return static_cast<uint32_t>(instances.size());
+}
+
+uint32_t EmulatorPool::getThreadCount() const
+{
+	return static_cast<uint32_t>(workers.size());
+}
+
+Console &EmulatorPool::getConsole(uint32_t index)
+{
+	return instances[index]->console;
+}
+
+void EmulatorPool::setInput(uint32_t index, Controller::ButtonStates buttons)
+{
+	instances[index]->buttons = buttons;
+}
+
+size_t EmulatorPool::getMemorySize(uint32_t index)
+{
+	return sizeof(Instance) + instances[index]->console.getMemorySize();
+}
+
+bool EmulatorPool::runFrames(uint32_t frames)
+{
+	if (frames == 0 || instances.empty())
+	{
+		return true;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Consoles are spread evenly between the queues, and set up before any of them can be taken
+	instancesLeft = static_cast<uint32_t>(instances.size());
+	breakHit = false;
+
+	for (uint32_t i = 0; i < instances.size(); i++)
+	{
+		instances[i]->framesLeft = frames;
+		pushInstance(i % queues.size(), i);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		runGeneration++;
+	}
+
+	runStarted.notify_all();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runFinished.wait(lock, [this]() { return instancesLeft == 0; });
+	}
+
+	lastRunFrames = static_cast<uint64_t>(frames) * instances.size();
+	lastRunSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	return !breakHit;
+}
+
+EmulatorPool::Stats EmulatorPool::getStats()
+{
+	Stats stats = {};
+	stats.instances = getInstanceCount();
+	stats.frames = lastRunFrames;
+	stats.seconds = lastRunSeconds;
+	stats.framesPerSecond = lastRunSeconds > 0 ? lastRunFrames / lastRunSeconds : 0;
+
+	for (uint32_t i = 0; i < instances.size(); i++)
+	{
+		stats.memoryBytes += getMemorySize(i);
+	}
+
+	return stats;
+}
+
+void EmulatorPool::workerMain(uint32_t worker)
+{
+	uint64_t generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			runStarted.wait(lock, [&]() { return stopRequested || runGeneration != generation; });
+
+			if (stopRequested)
+			{
+				return;
+			}
+
+			generation = runGeneration;
+		}
+
+		// Queues only run empty once every console left is being run by a worker, which puts it back in its own queue
+		uint32_t index;
+
+		while (takeInstance(worker, index))
+		{
+			Instance &instance = *instances[index];
+
+			// A break stops the console for the rest of the run
+			if (instance.console.runFrame())
+			{
+				instance.framesLeft--;
+			}
+			else
+			{
+				breakHit = true;
+				instance.framesLeft = 0;
+			}
+
+			if (instance.framesLeft > 0)
+			{
+				pushInstance(worker, index);
+			}
+			else if (--instancesLeft == 0)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				runFinished.notify_all();
+			}
+		}
+	}
+}
+
+bool EmulatorPool::takeInstance(uint32_t worker, uint32_t &index)
+{
+	{
+		WorkQueue &queue = *queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.count > 0)
+		{
+			queue.count--;
+			index = queue.instances[(queue.first + queue.count) % queue.instances.size()];
+			return true;
+		}
+	}
+
+	for (size_t offset = 1; offset < queues.size(); offset++)
+	{
+		WorkQueue &queue = *queues[(worker + offset) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (queue.count > 0)
+		{
+			index = queue.instances[queue.first];
+			queue.first = (queue.first + 1) % queue.instances.size();
+			queue.count--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void EmulatorPool::pushInstance(uint32_t worker, uint32_t index)
+{
+	WorkQueue &queue = *queues[worker];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	queue.instances[(queue.first + queue.count) % queue.instances.size()] = index;
+	queue.count++;
+}
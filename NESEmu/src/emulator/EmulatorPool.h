@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Console.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs many independent consoles at once, for regression sweeps and bots. Consoles are stepped a frame at a time by
+// a pool of worker threads: each worker has its own queue of consoles, runs them one frame at a time until they are
+// done, and steals consoles from the other queues once its own is empty
+class EmulatorPool
+{
+public:
+	// Emulation rate of all consoles together, over the last call to runFrames()
+	struct Stats
+	{
+		uint32_t instances;
+		uint64_t frames;
+		double seconds;
+		double framesPerSecond;
+
+		// Memory used by all consoles
+		size_t memoryBytes;
+	};
+
+	// Start the given amount of worker threads, or one per hardware thread when 0
+	EmulatorPool(uint32_t threads = 0);
+
+	// Stops the worker threads
+	~EmulatorPool();
+
+	// Load a ROM into a new console, and return its index, or -1 if the ROM could not be loaded.
+	// Only called while the consoles are not running
+	int add(const std::string &romPath);
+
+	// Returns the amount of consoles
+	uint32_t getInstanceCount() const;
+
+	// Returns the amount of worker threads
+	uint32_t getThreadCount() const;
+
+	// Returns a console, only accessed while the consoles are not running
+	Console &getConsole(uint32_t index);
+
+	// Set the controller input of a console, read whenever its game strobes the controller
+	void setInput(uint32_t index, Controller::ButtonStates buttons);
+
+	// Returns the bytes of memory used by a console
+	size_t getMemorySize(uint32_t index);
+
+	// Run every console for the given amount of frames, and wait for all of them. Returns false if a break
+	// stopped any of them early
+	bool runFrames(uint32_t frames);
+
+	// Returns the emulation rate of the last call to runFrames()
+	Stats getStats();
+
+private:
+	// A console along with the input it reads, and the frames it has left to run
+	struct Instance
+	{
+		Console console;
+		Controller::ButtonStates buttons;
+		uint32_t framesLeft;
+	};
+
+	// Consoles waiting for a worker, as a ring. The owning worker takes from the back, so that it keeps running the
+	// console it just ran while its memory is still cached, and others steal from the front
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::vector<uint32_t> instances;
+		size_t first;
+		size_t count;
+	};
+
+	std::vector<std::unique_ptr<Instance>> instances;
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+
+	// Wakes the workers when a run starts, and the caller of runFrames() when the last console is done
+	std::mutex mutex;
+	std::condition_variable runStarted;
+	std::condition_variable runFinished;
+	uint64_t runGeneration;
+	bool stopRequested;
+
+	// Consoles not done with the current run, and whether any of them hit a break
+	std::atomic<uint32_t> instancesLeft;
+	std::atomic<bool> breakHit;
+
+	// Last call to runFrames()
+	uint64_t lastRunFrames;
+	double lastRunSeconds;
+
+	// Worker thread loop
+	void workerMain(uint32_t worker);
+
+	// Take a console from the back of the worker's own queue, or from the front of another one.
+	// Returns false if every queue is empty
+	bool takeInstance(uint32_t worker, uint32_t &index);
+
+	// Add a console to the back of a queue
+	void pushInstance(uint32_t worker, uint32_t index);
+};
@@ -1,19 +1,26 @@
 #pragma once
 
 #include "MirroringMode.h"
+#include "SaveState.h"
 
 #include <cstdint>
+#include <functional>
 #include <unordered_map>
 #include <string>
 
 // Forward declaration
+class Bus;
 class Cartridge;
 
 // Base interface for mapper representation
 class IMapper
 {
 public:
+	// Called with the range of CHR memory ($0000 - $1FFF) whose contents changed, from writes or bank switches
+	using ChrChangedCallback = std::function<void(uint16_t address, uint16_t size)>;
+
 	IMapper(Cartridge &cartridge) { }
+	virtual ~IMapper() = default;
 	virtual uint8_t getId() = 0;
 	virtual std::string getName() = 0;
 	virtual MirroringMode getMirroringMode() = 0;
@@ -22,6 +29,10 @@ public:
 	virtual bool nametableRead(uint16_t address, uint8_t &value) = 0;
 	virtual bool nametableWrite(uint16_t address, uint8_t value) = 0;
 
+	// Map PRG memory directly into the bus page tables. Called when the mapper is attached to the bus, and
+	// should be repeated by the mapper on bank switches. Unmapped pages are accessed through prgRead/prgWrite
+	virtual void mapPrg(Bus &bus) = 0;
+
 	// PRG memory operations
 	virtual uint8_t prgRead(uint16_t address) = 0;
 	virtual void prgWrite(uint16_t address, uint8_t value) = 0;
@@ -29,5 +40,31 @@ public:
 	// CHR memory operations
 	virtual uint8_t chrRead(uint16_t address) = 0;
 	virtual void chrWrite(uint16_t address, uint8_t value) = 0;
+
+	// Save or load the cartridge RAM and mapper registers. Loading must restore the PRG mapping of the bus and
+	// report the CHR memory that changed
+	virtual void serialize(StateSerializer &state) = 0;
+
+	// Returns the bytes of memory used by the mapper, including its cartridge RAM
+	virtual size_t getMemorySize() = 0;
+
+	// Set the callback notified when CHR memory changes
+	void setChrChangedCallback(ChrChangedCallback callback)
+	{
+		chrChangedCallback = callback;
+	}
+
+protected:
+	// Mappers must call this whenever the contents of CHR memory change
+	void onChrChanged(uint16_t address, uint16_t size)
+	{
+		if (chrChangedCallback)
+		{
+			chrChangedCallback(address, size);
+		}
+	}
+
+private:
+	ChrChangedCallback chrChangedCallback;
 };
 
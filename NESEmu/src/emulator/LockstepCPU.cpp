@@ -0,0 +1,471 @@
+#include "LockstepCPU.h"
+#include "../util/Simd.h"
+
+#include <algorithm>
+
+using Operation = CPU::Operation;
+using AddressingMode = CPU::AddressingMode;
+using AccessType = CPU::AccessType;
+using Flag = CPU::Flag;
+
+#ifdef NESEMU_SSE2
+// Returns the new value in the lanes of the mask, and the old value in the others
+static inline __m128i select(__m128i mask, __m128i newValue, __m128i oldValue)
+{
+	return _mm_or_si128(_mm_and_si128(mask, newValue), _mm_andnot_si128(mask, oldValue));
+}
+
+// Returns 0xFF in the lanes where the top bit of the value is set
+static inline __m128i topBit(__m128i value)
+{
+	return _mm_cmplt_epi8(value, _mm_setzero_si128());
+}
+
+// Returns the status with the given flag set in the lanes where the condition is 0xFF, and cleared in the others
+static inline __m128i setFlag(__m128i p, Flag flag, __m128i condition)
+{
+	__m128i bit = _mm_set1_epi8(static_cast<char>(flag));
+	return _mm_or_si128(_mm_andnot_si128(bit, p), _mm_and_si128(condition, bit));
+}
+
+// Returns the status with the negative and zero flags set from the value
+static inline __m128i setNegativeZero(__m128i p, __m128i value)
+{
+	p = setFlag(p, Flag::Negative, topBit(value));
+	return setFlag(p, Flag::Zero, _mm_cmpeq_epi8(value, _mm_setzero_si128()));
+}
+
+// Returns the status of a comparison of the register with the operand, as done by CMP, CPX and CPY
+static inline __m128i compare(__m128i p, __m128i value, __m128i operand)
+{
+	p = setNegativeZero(p, _mm_sub_epi8(value, operand));
+	return setFlag(p, Flag::Carry, _mm_cmpeq_epi8(_mm_max_epu8(value, operand), value));
+}
+
+// Returns 0xFF in the lanes where the flag is set
+static inline __m128i hasFlag(__m128i p, Flag flag)
+{
+	__m128i bit = _mm_set1_epi8(static_cast<char>(flag));
+	return _mm_cmpeq_epi8(_mm_and_si128(p, bit), bit);
+}
+
+// Expand a lane bitmask into 0xFF bytes
+static inline __m128i expandMask(uint32_t mask)
+{
+	const __m128i bits = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+	__m128i bytes = _mm_set_epi64x(0x0101010101010101LL * ((mask >> 8) & 0xFF), 0x0101010101010101LL * (mask & 0xFF));
+	return _mm_cmpeq_epi8(_mm_and_si128(bytes, bits), bits);
+}
+
+// Flag tested by a branch, and whether it has to be set for the branch to be taken
+static bool getBranchCondition(Operation operation, Flag &flag, bool &set)
+{
+	switch (operation)
+	{
+	case Operation::BCC: flag = Flag::Carry; set = false; return true;
+	case Operation::BCS: flag = Flag::Carry; set = true; return true;
+	case Operation::BEQ: flag = Flag::Zero; set = true; return true;
+	case Operation::BNE: flag = Flag::Zero; set = false; return true;
+	case Operation::BMI: flag = Flag::Negative; set = true; return true;
+	case Operation::BPL: flag = Flag::Negative; set = false; return true;
+	case Operation::BVC: flag = Flag::Overflow; set = false; return true;
+	case Operation::BVS: flag = Flag::Overflow; set = true; return true;
+	default: return false;
+	}
+}
+#endif
+
+LockstepCPU::LockstepCPU() : stats()
+{
+	for (std::unique_ptr<Lane> &lane : lanes)
+	{
+		lane.reset(new Lane());
+	}
+
+	reset(0x0000);
+	totalCycles.fill(0);
+}
+
+Bus &LockstepCPU::getBus(uint32_t lane)
+{
+	return lanes[lane]->bus;
+}
+
+void LockstepCPU::reset(uint16_t address)
+{
+	// Same registers as CPU::reset
+	a.fill(0x00);
+	x.fill(0x00);
+	y.fill(0x00);
+	p.fill(0x24);
+	sp.fill(0xFD);
+	pc.fill(address);
+}
+
+void LockstepCPU::runUntil(uint64_t targetCycle)
+{
+	while (true)
+	{
+		// Lanes that are not done yet, and the next PC to run: the lowest PC of the lanes deepest in subroutines.
+		// Lanes ahead wait for the others to catch up, which makes lanes that took different paths meet again
+		// after a forward branch, or after returning from a subroutine the others did not call
+		uint32_t running = 0;
+		uint32_t lowestKey = UINT32_MAX;
+
+		for (uint32_t lane = 0; lane < LANES; lane++)
+		{
+			if (totalCycles[lane] < targetCycle)
+			{
+				running |= 1 << lane;
+				lowestKey = std::min(lowestKey, static_cast<uint32_t>(sp[lane]) << 16 | pc[lane]);
+			}
+		}
+
+		if (running == 0)
+		{
+			return;
+		}
+
+		// Memory can differ between lanes, so only the lanes with the same opcode at the PC run together
+		uint32_t mask = 0;
+		int opcode = -1;
+
+		for (uint32_t bits = running; bits != 0; bits &= bits - 1)
+		{
+			uint32_t lane = countTrailingZeros(bits);
+
+			if ((static_cast<uint32_t>(sp[lane]) << 16 | pc[lane]) != lowestKey)
+			{
+				continue;
+			}
+
+			uint8_t laneOpcode = read(lane, pc[lane]);
+
+			if (opcode < 0)
+			{
+				opcode = laneOpcode;
+			}
+
+			if (laneOpcode == opcode)
+			{
+				mask |= 1 << lane;
+			}
+		}
+
+		uint32_t count = countSetBits(mask);
+
+		if (count >= MIN_LOCKSTEP_LANES && stepLockstep(CPU::getOpcode(static_cast<uint8_t>(opcode)), mask))
+		{
+			stats.lockstepInstructions += count;
+			stats.lockstepSteps++;
+			continue;
+		}
+
+		for (uint32_t bits = mask; bits != 0; bits &= bits - 1)
+		{
+			stepScalar(countTrailingZeros(bits));
+		}
+	}
+}
+
+CPU::Registers LockstepCPU::getRegisters(uint32_t lane) const
+{
+	return { a[lane], x[lane], y[lane], p[lane], sp[lane], pc[lane] };
+}
+
+uint64_t LockstepCPU::getTotalCycles(uint32_t lane) const
+{
+	return totalCycles[lane];
+}
+
+LockstepCPU::Stats LockstepCPU::getStats() const
+{
+	return stats;
+}
+
+bool LockstepCPU::stepLockstep(const CPU::Opcode &ins, uint32_t mask)
+{
+#ifdef NESEMU_SSE2
+	// Instructions using the stack or jumping somewhere else than the operand are left to the scalar CPUs
+	switch (ins.operation)
+	{
+	case Operation::BRK: case Operation::JSR: case Operation::RTI: case Operation::RTS:
+	case Operation::PHA: case Operation::PHP: case Operation::PLA: case Operation::PLP:
+		return false;
+	case Operation::JMP:
+		if (ins.mode != AddressingMode::ABS)
+		{
+			return false;
+		}
+		break;
+	default:
+		break;
+	}
+
+	uint16_t address = pc[countTrailingZeros(mask)];
+	uint16_t addresses[LANES];
+	alignas(16) uint8_t operands[LANES] = {};
+	uint32_t pageCrossed = 0;
+
+	// Operands are read from the memory of each lane, addressed the same way as the scalar CPU does
+	for (uint32_t bits = mask; bits != 0; bits &= bits - 1)
+	{
+		uint32_t lane = countTrailingZeros(bits);
+		uint16_t target = 0;
+		uint16_t base = 0;
+
+		switch (ins.mode)
+		{
+		case AddressingMode::IMM:
+		case AddressingMode::REL:
+			target = address + 1;
+			break;
+		case AddressingMode::ZPG:
+			target = read(lane, address + 1);
+			break;
+		case AddressingMode::ZPX:
+			target = (read(lane, address + 1) + x[lane]) & 0xFF;
+			break;
+		case AddressingMode::ZPY:
+			target = (read(lane, address + 1) + y[lane]) & 0xFF;
+			break;
+		case AddressingMode::ABS:
+			target = read(lane, address + 1) | (read(lane, address + 2) << 8);
+			break;
+		case AddressingMode::ABX:
+			base = read(lane, address + 1) | (read(lane, address + 2) << 8);
+			target = base + x[lane];
+			break;
+		case AddressingMode::ABY:
+			base = read(lane, address + 1) | (read(lane, address + 2) << 8);
+			target = base + y[lane];
+			break;
+		case AddressingMode::IDX:
+		{
+			uint8_t pointer = read(lane, address + 1) + x[lane];
+			target = read(lane, pointer) | (read(lane, (pointer + 1) & 0xFF) << 8);
+			break;
+		}
+		case AddressingMode::IDY:
+		{
+			uint8_t pointer = read(lane, address + 1);
+			base = read(lane, pointer) | (read(lane, (pointer + 1) & 0xFF) << 8);
+			target = base + y[lane];
+			break;
+		}
+		default:
+			break;
+		}
+
+		if ((ins.mode == AddressingMode::ABX || ins.mode == AddressingMode::ABY || ins.mode == AddressingMode::IDY) &&
+			(base & 0xFF00) != (target & 0xFF00))
+		{
+			pageCrossed |= 1 << lane;
+		}
+
+		addresses[lane] = target;
+
+		if (ins.access == AccessType::Read || ins.access == AccessType::ReadModifyWrite || ins.mode == AddressingMode::REL)
+		{
+			operands[lane] = read(lane, target);
+		}
+	}
+
+	__m128i laneMask = expandMask(mask);
+	__m128i vA = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a.data()));
+	__m128i vX = _mm_loadu_si128(reinterpret_cast<const __m128i *>(x.data()));
+	__m128i vY = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y.data()));
+	__m128i vP = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p.data()));
+	__m128i vSp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sp.data()));
+	__m128i m = ins.mode == AddressingMode::ACC ? vA : _mm_load_si128(reinterpret_cast<const __m128i *>(operands));
+	__m128i carry = _mm_and_si128(vP, _mm_set1_epi8(static_cast<char>(Flag::Carry)));
+	const __m128i one = _mm_set1_epi8(1);
+
+	// Value written back to memory (or A) by stores and read-modify-write instructions
+	__m128i result = m;
+
+	switch (ins.operation)
+	{
+	case Operation::LDA: vA = m; vP = setNegativeZero(vP, m); break;
+	case Operation::LDX: vX = m; vP = setNegativeZero(vP, m); break;
+	case Operation::LDY: vY = m; vP = setNegativeZero(vP, m); break;
+	case Operation::STA: result = vA; break;
+	case Operation::STX: result = vX; break;
+	case Operation::STY: result = vY; break;
+	case Operation::TAX: vX = vA; vP = setNegativeZero(vP, vX); break;
+	case Operation::TAY: vY = vA; vP = setNegativeZero(vP, vY); break;
+	case Operation::TXA: vA = vX; vP = setNegativeZero(vP, vA); break;
+	case Operation::TYA: vA = vY; vP = setNegativeZero(vP, vA); break;
+	case Operation::TSX: vX = vSp; vP = setNegativeZero(vP, vX); break;
+	case Operation::TXS: vSp = vX; break;
+	case Operation::AND: vA = _mm_and_si128(vA, m); vP = setNegativeZero(vP, vA); break;
+	case Operation::ORA: vA = _mm_or_si128(vA, m); vP = setNegativeZero(vP, vA); break;
+	case Operation::EOR: vA = _mm_xor_si128(vA, m); vP = setNegativeZero(vP, vA); break;
+	case Operation::INX: vX = _mm_add_epi8(vX, one); vP = setNegativeZero(vP, vX); break;
+	case Operation::INY: vY = _mm_add_epi8(vY, one); vP = setNegativeZero(vP, vY); break;
+	case Operation::DEX: vX = _mm_sub_epi8(vX, one); vP = setNegativeZero(vP, vX); break;
+	case Operation::DEY: vY = _mm_sub_epi8(vY, one); vP = setNegativeZero(vP, vY); break;
+	case Operation::INC: result = _mm_add_epi8(m, one); vP = setNegativeZero(vP, result); break;
+	case Operation::DEC: result = _mm_sub_epi8(m, one); vP = setNegativeZero(vP, result); break;
+	case Operation::CMP: vP = compare(vP, vA, m); break;
+	case Operation::CPX: vP = compare(vP, vX, m); break;
+	case Operation::CPY: vP = compare(vP, vY, m); break;
+	case Operation::ADC:
+	case Operation::SBC:
+	{
+		// SBC adds the inverted operand. The carry out of bit 7 is set if both inputs have it set, or one of them
+		// does and the sum does not
+		__m128i value = ins.operation == Operation::SBC ? _mm_xor_si128(m, _mm_set1_epi8(-1)) : m;
+		__m128i sum = _mm_add_epi8(_mm_add_epi8(vA, value), carry);
+		__m128i carryOut = _mm_or_si128(_mm_and_si128(vA, value), _mm_andnot_si128(sum, _mm_or_si128(vA, value)));
+		__m128i overflow = _mm_and_si128(_mm_xor_si128(vA, sum), _mm_xor_si128(value, sum));
+
+		vP = setNegativeZero(vP, sum);
+		vP = setFlag(vP, Flag::Overflow, topBit(overflow));
+		vP = setFlag(vP, Flag::Carry, topBit(carryOut));
+		vA = sum;
+		break;
+	}
+	case Operation::ASL:
+		vP = setFlag(vP, Flag::Carry, topBit(m));
+		result = _mm_add_epi8(m, m);
+		vP = setNegativeZero(vP, result);
+		break;
+	case Operation::ROL:
+		vP = setFlag(vP, Flag::Carry, topBit(m));
+		result = _mm_or_si128(_mm_add_epi8(m, m), carry);
+		vP = setNegativeZero(vP, result);
+		break;
+	case Operation::LSR:
+	case Operation::ROR:
+	{
+		// SSE2 has no 8-bit shifts, so the bits shifted in from the neighboring byte are masked out
+		__m128i shifted = _mm_and_si128(_mm_srli_epi16(m, 1), _mm_set1_epi8(0x7F));
+
+		if (ins.operation == Operation::ROR)
+		{
+			shifted = _mm_or_si128(shifted, _mm_and_si128(_mm_cmpeq_epi8(carry, one), _mm_set1_epi8(-128)));
+		}
+
+		vP = setFlag(vP, Flag::Carry, _mm_cmpeq_epi8(_mm_and_si128(m, one), one));
+		vP = setNegativeZero(vP, shifted);
+		result = shifted;
+		break;
+	}
+	case Operation::BIT:
+		vP = setFlag(vP, Flag::Negative, topBit(m));
+		vP = setFlag(vP, Flag::Overflow, hasFlag(m, Flag::Overflow));
+		vP = setFlag(vP, Flag::Zero, _mm_cmpeq_epi8(_mm_and_si128(vA, m), _mm_setzero_si128()));
+		break;
+	case Operation::CLC: vP = setFlag(vP, Flag::Carry, _mm_setzero_si128()); break;
+	case Operation::SEC: vP = setFlag(vP, Flag::Carry, _mm_set1_epi8(-1)); break;
+	case Operation::CLI: vP = setFlag(vP, Flag::Interrupt, _mm_setzero_si128()); break;
+	case Operation::SEI: vP = setFlag(vP, Flag::Interrupt, _mm_set1_epi8(-1)); break;
+	case Operation::CLD: vP = setFlag(vP, Flag::Decimal, _mm_setzero_si128()); break;
+	case Operation::SED: vP = setFlag(vP, Flag::Decimal, _mm_set1_epi8(-1)); break;
+	case Operation::CLV: vP = setFlag(vP, Flag::Overflow, _mm_setzero_si128()); break;
+	default:
+		// Branches, jumps and NOPs only move the PC
+		break;
+	}
+
+	// Shifts of the accumulator write their result back into it
+	if (ins.mode == AddressingMode::ACC)
+	{
+		vA = result;
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(a.data()), select(laneMask, vA, _mm_loadu_si128(reinterpret_cast<const __m128i *>(a.data()))));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(x.data()), select(laneMask, vX, _mm_loadu_si128(reinterpret_cast<const __m128i *>(x.data()))));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(y.data()), select(laneMask, vY, _mm_loadu_si128(reinterpret_cast<const __m128i *>(y.data()))));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(p.data()), select(laneMask, vP, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p.data()))));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(sp.data()), select(laneMask, vSp, _mm_loadu_si128(reinterpret_cast<const __m128i *>(sp.data()))));
+
+	alignas(16) uint8_t results[LANES];
+	_mm_store_si128(reinterpret_cast<__m128i *>(results), result);
+
+	bool writes = ins.mode != AddressingMode::ACC &&
+		(ins.access == AccessType::Write || ins.access == AccessType::ReadModifyWrite);
+
+	Flag branchFlag;
+	bool branchSet;
+	bool branch = getBranchCondition(ins.operation, branchFlag, branchSet);
+
+	// The PC and cycles are updated per lane, since taken branches and page crossings differ between lanes
+	for (uint32_t bits = mask; bits != 0; bits &= bits - 1)
+	{
+		uint32_t lane = countTrailingZeros(bits);
+
+		if (writes)
+		{
+			write(lane, addresses[lane], results[lane]);
+		}
+
+		uint16_t next = address + ins.length;
+		uint32_t cycles = ins.cycles;
+
+		if (ins.pageCrossCycle && (pageCrossed & (1 << lane)) != 0)
+		{
+			cycles++;
+		}
+
+		if (branch && ((p[lane] & static_cast<uint8_t>(branchFlag)) != 0) == branchSet)
+		{
+			// Taking the branch adds one cycle, and crossing over to a different page adds another
+			uint16_t target = next + static_cast<int8_t>(operands[lane]);
+			cycles += (next & 0xFF00) != (target & 0xFF00) ? 2 : 1;
+			next = target;
+		}
+		else if (ins.operation == Operation::JMP)
+		{
+			next = addresses[lane];
+		}
+
+		pc[lane] = next;
+		totalCycles[lane] += cycles;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void LockstepCPU::stepScalar(uint32_t lane)
+{
+	CPU &cpu = lanes[lane]->cpu;
+	cpu.setRegisters(getRegisters(lane));
+	totalCycles[lane] += cpu.step();
+
+	CPU::Registers registers = cpu.getRegisters();
+	a[lane] = registers.a;
+	x[lane] = registers.x;
+	y[lane] = registers.y;
+	p[lane] = registers.p;
+	sp[lane] = registers.sp;
+	pc[lane] = registers.pc;
+
+	stats.scalarInstructions++;
+}
+
+inline uint8_t LockstepCPU::read(uint32_t lane, uint16_t address)
+{
+	// Internal RAM is mirrored up to $1FFF
+	if (address < 0x2000)
+	{
+		return lanes[lane]->ram[address & 0x07FF];
+	}
+
+	return lanes[lane]->bus.read(address);
+}
+
+inline void LockstepCPU::write(uint32_t lane, uint16_t address, uint8_t value)
+{
+	if (address < 0x2000)
+	{
+		lanes[lane]->ram[address & 0x07FF] = value;
+		return;
+	}
+
+	lanes[lane]->bus.write(address, value);
+}
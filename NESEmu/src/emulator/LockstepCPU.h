@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Bus.h"
+#include "CPU.h"
+#include "Scheduler.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+// Experimental: runs LANES copies of the 6502 in lock-step, for batches of the same program with different inputs.
+// Registers are stored as structure of arrays, so that the 8-bit registers of all lanes fit in one SSE2 register.
+// Every step runs the instruction at the lowest PC of the lanes deepest in subroutines, on the lanes at that PC and
+// stack pointer: ALU, load/store, flag and branch instructions are run for all of them at once, masking out the
+// other lanes. Stack, subroutine and indirect jump instructions, and instructions that too few lanes have reached,
+// are run by the scalar CPU of each lane instead.
+// Only the CPU is emulated: every lane has its own bus, but no PPU, interrupts or DMA
+class LockstepCPU
+{
+public:
+	// One lane per byte of an SSE2 register
+	static constexpr uint32_t LANES = 16;
+
+	// Instructions reached by fewer lanes are run by their scalar CPUs, since the lanes have diverged too much
+	// for lock-step to pay off
+	static constexpr uint32_t MIN_LOCKSTEP_LANES = 4;
+
+	// Instructions run since construction, counted once per lane
+	struct Stats
+	{
+		uint64_t lockstepInstructions;
+		uint64_t scalarInstructions;
+
+		// Instructions run for several lanes at once
+		uint64_t lockstepSteps;
+	};
+
+	LockstepCPU();
+
+	// Returns the bus of a lane, to load its program and inputs into memory
+	Bus &getBus(uint32_t lane);
+
+	// Set the registers of every lane as after a reset, starting at the given address
+	void reset(uint16_t pc);
+
+	// Execute whole instructions on every lane until its total cycle count reaches the target cycle
+	void runUntil(uint64_t targetCycle);
+
+	// Returns the registers of a lane
+	CPU::Registers getRegisters(uint32_t lane) const;
+
+	// Returns the total amount of cycles a lane executed
+	uint64_t getTotalCycles(uint32_t lane) const;
+
+	Stats getStats() const;
+
+private:
+	// Memory of a lane, and the scalar CPU running the instructions that are not run in lock-step
+	struct Lane
+	{
+		Scheduler scheduler;
+		Bus bus;
+		CPU cpu;
+
+		// Internal RAM of the bus, accessed directly by lock-step instructions
+		uint8_t *ram;
+
+		Lane() : cpu(bus, scheduler), ram(bus.get(0x0000))
+		{
+		}
+	};
+
+	// Registers of every lane
+	alignas(16) std::array<uint8_t, LANES> a;
+	alignas(16) std::array<uint8_t, LANES> x;
+	alignas(16) std::array<uint8_t, LANES> y;
+	alignas(16) std::array<uint8_t, LANES> p;
+	alignas(16) std::array<uint8_t, LANES> sp;
+	std::array<uint16_t, LANES> pc;
+	std::array<uint64_t, LANES> totalCycles;
+
+	std::array<std::unique_ptr<Lane>, LANES> lanes;
+	Stats stats;
+
+	// Run an instruction on all lanes of the mask at once, which are all at the same PC. Returns false if the
+	// instruction can not be run in lock-step
+	bool stepLockstep(const CPU::Opcode &ins, uint32_t mask);
+
+	// Run one instruction on the scalar CPU of a lane
+	void stepScalar(uint32_t lane);
+
+	// Access the memory of a lane, directly for internal RAM and through its bus otherwise
+	uint8_t read(uint32_t lane, uint16_t address);
+	void write(uint32_t lane, uint16_t address, uint8_t value);
+};
@@ -2,12 +2,12 @@
 
 #include "../mappers/NROM.h"
 
-IMapper *MapperFactory::createMapper(Cartridge &cartridge)
+std::unique_ptr<IMapper> MapperFactory::createMapper(Cartridge &cartridge)
 {
 	switch (cartridge.getMapperID())
 	{
 	case 0:
-		return new mappers::NROM(cartridge);
+		return std::unique_ptr<IMapper>(new mappers::NROM(cartridge));
 	}
 
 	return nullptr;
@@ -3,8 +3,11 @@
 #include "IMapper.h"
 #include "Cartridge.h"
 
+#include <memory>
+
 class MapperFactory
 {
 public:
-	static IMapper *createMapper(Cartridge &cartridge);
+	// Returns the mapper used by the cartridge's ROM, or nothing if it is not implemented
+	static std::unique_ptr<IMapper> createMapper(Cartridge &cartridge);
 };
\ No newline at end of file
@@ -6,10 +6,14 @@
 #include "../graphics/windows/InputDebugWindow.h"
 #include "../graphics/windows/CartridgeDebugWindow.h"
 #include "../graphics/Texture.h"
+#include "../graphics/FrameTexture.h"
+#include "../graphics/TileBatch.h"
 #include "../graphics/Shader.h"
 #include "../graphics/ResourceManager.h"
 #include "../util/Input.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdio.h>
 
@@ -23,33 +27,46 @@ static constexpr float BACKGROUND_SPRITE_DEPTH = -1.0f;
 static constexpr float BACKGROUND_TILE_DEPTH = 0.0f;
 static constexpr float FOREGROUND_SPRITE_DEPTH = 1.0f;
 
+// Palettes of the tile layers, as set by getLayerPalettes()
+static constexpr uint8_t SPRITE_PALETTE_START = 4;
+static constexpr uint8_t BACKGROUND_COLOR_PALETTE = 8;
+
+// Held to rewind
+static constexpr int REWIND_KEY = GLFW_KEY_BACKSPACE;
+
+// Bytes of scratch memory the drawables can use per UI frame
+static constexpr size_t FRAME_ARENA_SIZE = 64 * 1024;
+
 static void glfwErrorCallback(int error, const char *desc)
 {
     printf("GLFW error: %i %s\n", error, desc);
 }
 
-NES::NES(): cpu(bus), ppu(bus), controller(bus, Bus::JOY1)
+NES::NES() : pacer(Console::FRAME_RATE_HZ, Console::CPU_CYCLES_PER_FRAME), frameArena(FRAME_ARENA_SIZE),
+    emulation(console, Console::FRAME_RATE_HZ, Console::CPU_CYCLES_PER_FRAME)
 {
     // TODO: Use initializer list
     windowWidth = 1280;
     windowHeight = 720;
     viewportWidth = 0;
     viewportHeight = 0;
-    running = false;
     shouldShutdown = false;
     window = nullptr;
     renderingScale = 2.0f;
-    emulationSpeed = 1.0;
+    drawTileLayers = false;
+    turbo = false;
+    turboFrameSkip = 0;
+    runAheadFrames = 0;
+    frameTexture = nullptr;
+    tileBatch = nullptr;
+    emulationCore = -1;
+    postedRewind = false;
+    consoleLocked = false;
 }
 
 void NES::load(std::string path)
 {
-    cartridge.load(path);
-    bus.setMapper(cartridge.getMapper());
-    ppu.setMapper(cartridge.getMapper());
-
-    cpu.reset();
-    ppu.reset();
+    console.load(path);
 }
 
 bool NES::init()
@@ -93,7 +110,7 @@ bool NES::init()
 
     printf("Loaded OpenGL version %s\n", glGetString(GL_VERSION));
 
-    Input::init(window);
+    input.init(window);
 
     // TODO: Move to graphics.cpp / graphics.h
 #ifdef OPENGL_DEBUG
@@ -119,24 +136,35 @@ bool NES::init()
 
     GL_ERROR_CHECK();
 
+    // Colors are only needed for rendering, so the palette is loaded with the window
+    console.getPPU().loadPalette("palette.pal");
+
     int patternTableSize = PPU::PATTERN_TABLE_SIZE * PPU::TILE_SIZE;
-    ResourceManager::loadShader("pattern_shader", "shader.frag", "shader.vert");
-    ResourceManager::loadTexture("pattern_left", "pattern_shader", patternTableSize, patternTableSize);
-    ResourceManager::loadTexture("pattern_right", "pattern_shader", patternTableSize, patternTableSize);
+    resources.loadShader("pattern_shader", "shader.frag", "shader.vert");
+    resources.loadTexture("pattern_left", "pattern_shader", patternTableSize, patternTableSize);
+    resources.loadTexture("pattern_right", "pattern_shader", patternTableSize, patternTableSize);
+
+    resources.loadShader("frame_shader", "frame.frag", "shader.vert");
+    frameTexture = new FrameTexture(resources.getShader("frame_shader"));
+    frameTexture->load();
+
+    resources.loadShader("tile_shader", "tile.frag", "tile.vert");
+    tileBatch = new TileBatch(resources.getShader("tile_shader"));
+    tileBatch->load();
 
     GL_ERROR_CHECK();
 
     // Init drawables
     drawables.push_back(new DemoWindow());
-    drawables.push_back(new DebugWindow(*this, cpu));
-    drawables.push_back(new MemoryViewWindow(bus));
-    drawables.push_back(new PPUDebugWindow(*this, ppu, cartridge));
-    drawables.push_back(new CartridgeDebugWindow(cartridge));
-    drawables.push_back(new InputDebugWindow(controller));
+    drawables.push_back(new DebugWindow(*this));
+    drawables.push_back(new MemoryViewWindow(console.getBus(), frameArena));
+    drawables.push_back(new PPUDebugWindow(*this, console.getPPU(), console.getCartridge(), resources));
+    drawables.push_back(new CartridgeDebugWindow(console.getCartridge()));
+    drawables.push_back(new InputDebugWindow(input, console.getController()));
 
     GL_ERROR_CHECK();
 
-    Input::registerKeyMap("joy1",
+    input.registerKeyMap("joy1",
         {
             { GLFW_KEY_A, Controller::Button::B },
             { GLFW_KEY_S, Controller::Button::A },
@@ -153,82 +181,114 @@ bool NES::init()
 
 void NES::run()
 {
-    const double targetFps = 1.0 / 60.0;
-    double lastUpdateTime = 0;  // number of seconds since the last loop
-    double lastFrameTime = 0;   // number of seconds since the last frame
-    const double cyclesPerFrame = 1790000 / 60; // Amount of CPU cycles needed per UI frame
+    printf("Running at %.4lfHz, with %.2lf CPU cycles per frame\n", pacer.getFrameRate(), Console::CPU_CYCLES_PER_FRAME);
 
-    printf("Running display at %.2lfHz, with %.2lf CPU cycles per frame\n", 1 / targetFps, cyclesPerFrame);
+    // Pattern tables are kept up to date with the tiles the PPU marks as changed
+    Texture *leftPatternTable = resources.getTexture("pattern_left");
+    Texture *rightPatternTable = resources.getTexture("pattern_right");
+    leftPatternTable->load(console.getPPU(), 0x0000);
+    rightPatternTable->load(console.getPPU(), 0x1000);
+    console.getPPU().clearDirtyChrTiles();
 
-    // TODO: Create a PPU callback for loading/updating pattern tables
-    Texture *leftPatternTable = ResourceManager::getTexture("pattern_left");
-    Texture *rightPatternTable = ResourceManager::getTexture("pattern_right");
-    leftPatternTable->load(ppu, 0x0000);
-    rightPatternTable->load(ppu, 0x1000);
+    emulation.start(emulationCore);
+    pacer.reset();
 
-    // Draw window and poll events
+    // Draw the latest emulated frame per loop, paced to the NES frame rate
     while (!glfwWindowShouldClose(window) && !shouldShutdown)
     {
-        double now = glfwGetTime();
-        double deltaTime = now - lastUpdateTime;
-        double modifiedCyclesPerFrame = cyclesPerFrame * emulationSpeed;
+        frameArena.reset();
 
         // Poll events
         glfwPollEvents();
         glfwGetWindowSize(window, &windowWidth, &windowHeight);
+        postInput();
+
+        // Start new ImGui frame
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        // Update OpenGL
+        glfwGetFramebufferSize(window, &viewportWidth, &viewportHeight);
+        glViewport(0, 0, viewportWidth, viewportHeight);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (!drawTileLayers)
+        {
+            drawFrame();
+        }
 
-        // Update UI at 60Hz
-        if (now - lastFrameTime >= targetFps)
+        // The console is only locked to copy out what the pattern tables and tile layers show, which are drawn after
         {
-            // Start new ImGui frame
-            ImGui_ImplOpenGL3_NewFrame();
-            ImGui_ImplGlfw_NewFrame();
-            ImGui::NewFrame();
+            std::unique_lock<std::mutex> lock = emulation.lockConsole();
+            copyConsoleViews();
+        }
 
-            // Update OpenGL
-            glfwGetFramebufferSize(window, &viewportWidth, &viewportHeight);
-            glViewport(0, 0, viewportWidth, viewportHeight);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Draw graphics from PPU
+        updatePatternTables();
 
-            // Draw graphics from PPU
+        if (drawTileLayers)
+        {
+            tileBatch->setPalettes(tileLayers.colors);
             drawBackground();
             drawSprites();
+        }
 
-            // Draw all drawable components
-            for (IDrawable *drawable : drawables)
+        for (IDrawable *drawable : drawables)
+        {
+            if (drawable->isActive())
             {
-                if (!drawable->isActive())
-                {
-                    continue;
-                }
-
                 drawable->update();
-
-                if (drawable->isVisible())
-                {
-                    drawable->draw();
-                }
             }
+        }
+
+        // Windows inspecting the live console state keep it locked while drawing, stalling the emulation thread
+        // for as long as they take, so the lock is only held for the whole UI frame while one is visible
+        std::unique_lock<std::mutex> inspectionLock;
 
-            // Render ImGui
-            ImGui::Render();
-            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if (isInspectingConsole())
+        {
+            inspectionLock = emulation.lockConsole();
+            consoleLocked = true;
+        }
 
-            // Swap buffers and finish frame
-            glfwSwapBuffers(window);
-            lastFrameTime = now;
+        // Draw all drawable components
+        for (IDrawable *drawable : drawables)
+        {
+            if (drawable->isActive() && drawable->isVisible())
+            {
+                drawable->draw();
+            }
         }
 
-        // Update NES components independently of UI
-        for (int i = 0; running && i < (int)modifiedCyclesPerFrame; i++)
+        if (consoleLocked)
         {
-            step();
+            inspectionLock.unlock();
+            consoleLocked = false;
         }
 
-        lastUpdateTime = now;
+        // Render ImGui
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        // Swap buffers and wait for the next frame
+        glfwSwapBuffers(window);
+        pacer.wait();
     }
 
+    emulation.stop();
+
+    FramePacer::Stats stats = pacer.getStats();
+    printf("Ran %llu frames, %.3lfms average frame time, %.3lfms jitter, %llu missed\n",
+        (unsigned long long)stats.frames, stats.averageFrameTime, stats.jitter, (unsigned long long)stats.missedFrames);
+
     // Cleanup
+    delete frameTexture;
+    frameTexture = nullptr;
+    delete tileBatch;
+    tileBatch = nullptr;
+    resources.clear();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -240,19 +300,12 @@ void NES::run()
 
 void NES::step()
 {
-    // 1 CPU cycle = 3 PPU cycles
-    cpu.step();
-    
-    // TODO: Improve performance in the future. Fast-forward PPU when relevant registers update
-    ppu.step();
-    ppu.step();
-    ppu.step();
+    emulation.post(EmulationThread::CommandType::Step);
+}
 
-    if (controller.isPolling())
-    {
-        Controller::ButtonStates keyMap = Input::getKeyMap("joy1");
-        controller.setButtonStates(keyMap);
-    }
+void NES::runCycles(uint32_t cycles)
+{
+    console.runCycles(cycles);
 }
 
 void NES::shutdown()
@@ -262,36 +315,39 @@ void NES::shutdown()
 
 void NES::setRunning(bool running)
 {
-    this->running = running;
+    emulation.post(EmulationThread::CommandType::SetRunning, running);
 }
 
 bool NES::getRunning() const
 {
-    return running;
+    return emulation.isRunning();
 }
 
 void NES::loadDebugMode()
 {
     load("..\\roms\\test\\nestest.nes");
-    cpu.setPC(0xC000);
+    console.getCPU().setPC(0xC000);
     printf("Set PC to 0xC000 for nestest automation mode\n");
 
+    // The trace is decoded into the log compared by scripts/logcompare.py
+    setTracing(true);
+
     // 26554 cycles for entire NESTest ROM
-    for (int i = 0; i < 26554; i++)
-    {
-        cpu.step();
-    }
+    runCycles(26554);
 
     printf("Executed 26554 cycles of NESTest ROM\n");
 
+    // Stopping writes the rest of the trace
+    setTracing(false);
+
     // Read NESTest test result codes
     printf("Test results:\n");
-    printf("\t0x02: %02X\n", bus.read(0x02));
-    printf("\t0x03: %02X\n", bus.read(0x03));
+    printf("\t0x02: %02X\n", console.getBus().read(0x02));
+    printf("\t0x03: %02X\n", console.getBus().read(0x03));
 
     // Dump memory post-run
     Logger memlog("..\\logs\\post-run-memory.log");
-    bus.dump(memlog);
+    console.getBus().dump(memlog);
     printf("Memory dumped post-run");
 }
 
@@ -305,14 +361,143 @@ float NES::getRenderingScale()
     return renderingScale;
 }
 
+void NES::setDrawTileLayers(bool enabled)
+{
+    drawTileLayers = enabled;
+}
+
+bool NES::getDrawTileLayers() const
+{
+    return drawTileLayers;
+}
+
 void NES::setEmulationSpeed(double speed)
 {
-    emulationSpeed = speed;
+    emulation.post(EmulationThread::CommandType::SetSpeed, speed);
+}
+
+void NES::setTurbo(bool enabled)
+{
+    if (emulation.post(EmulationThread::CommandType::SetTurbo, enabled))
+    {
+        turbo = enabled;
+    }
+}
+
+bool NES::getTurbo() const
+{
+    return turbo;
+}
+
+void NES::setTurboFrameSkip(uint32_t frames)
+{
+    if (emulation.post(EmulationThread::CommandType::SetFrameSkip, frames))
+    {
+        turboFrameSkip = frames;
+    }
+}
+
+uint32_t NES::getTurboFrameSkip() const
+{
+    return turboFrameSkip;
+}
+
+void NES::setRunAhead(uint32_t frames)
+{
+    frames = std::min(frames, EmulationThread::MAX_RUN_AHEAD);
+
+    if (emulation.post(EmulationThread::CommandType::SetRunAhead, frames))
+    {
+        runAheadFrames = frames;
+    }
+}
+
+uint32_t NES::getRunAhead() const
+{
+    return runAheadFrames;
+}
+
+void NES::setEmulationCore(int core)
+{
+    emulationCore = core;
+}
+
+void NES::requestBreak()
+{
+    // Debug watches are called by the bus, so this is already on the emulation thread
+    console.requestBreak();
+}
+
+void NES::setTracing(bool enabled)
+{
+    emulation.post(EmulationThread::CommandType::SetTracing, enabled);
+}
+
+bool NES::getTracing() const
+{
+    return emulation.getFrame().tracing;
+}
+
+bool NES::saveState(size_t slot)
+{
+    std::unique_lock<std::mutex> lock = lockConsole();
+    return console.saveState(saveSlots[slot]);
+}
+
+bool NES::loadState(size_t slot)
+{
+    if (saveSlots[slot].isEmpty())
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock = lockConsole();
+    return console.loadState(saveSlots[slot]);
+}
+
+std::unique_lock<std::mutex> NES::lockConsole()
+{
+    if (consoleLocked)
+    {
+        return std::unique_lock<std::mutex>();
+    }
+
+    return emulation.lockConsole();
+}
+
+const SaveState &NES::getSaveSlot(size_t slot) const
+{
+    return saveSlots[slot];
+}
+
+FramePacer::Stats NES::getEmulationStats() const
+{
+    return emulation.getFrame().stats;
+}
+
+EmulationThread::Throughput NES::getEmulationThroughput() const
+{
+    return emulation.getFrame().throughput;
+}
+
+RewindBuffer::Stats NES::getRewindStats() const
+{
+    return emulation.getFrame().rewind;
+}
+
+CPU::State NES::getCpuState() const
+{
+    return emulation.getFrame().cpu;
 }
 
 Cartridge & NES::getCartridge()
 {
-    return cartridge;
+    return console.getCartridge();
+}
+
+Bus & NES::getBus()
+{
+    return console.getBus();
 }
 
 float NES::getTileSize()
@@ -330,18 +515,135 @@ glm::vec2 NES::getGraphicsOffset()
     );
 }
 
-void NES::drawBackground()
+void NES::copyConsoleViews()
 {
+    PPU &ppu = console.getPPU();
+    const PPU::ChrTileSet &changedTiles = ppu.getDirtyChrTiles();
+
+    // Only the tiles that changed are copied, and stay marked until they are uploaded
+    if (changedTiles.any())
+    {
+        for (uint16_t tile = 0; tile < PPU::CHR_TILE_COUNT; tile++)
+        {
+            if (changedTiles.test(tile))
+            {
+                memcpy(chrTiles[tile].data(), ppu.getDecodedTile(tile), TileCache::TILE_PIXELS);
+            }
+        }
+
+        dirtyChrTiles |= changedTiles;
+        ppu.clearDirtyChrTiles();
+    }
+
+    if (!drawTileLayers)
+    {
+        return;
+    }
+
     uint16_t start = ppu.getActiveNametableAddress();
+    uint8_t nametable = ppu.getRegisters()->ctrl.baseNametable;
+
+    tileLayers.colors = getLayerPalettes();
+    tileLayers.registers = *ppu.getRegisters();
+    tileLayers.bgPatternTable = ppu.getActiveBgPatternTableAddress();
+    tileLayers.spritePatternTable = ppu.getActiveSpritePatternTableAddress();
+
+    for (uint16_t index = 0; index < tileLayers.patternIndices.size(); index++)
+    {
+        tileLayers.patternIndices[index] = ppu.readMemory(start + index);
+        tileLayers.paletteIndices[index] = ppu.getNametableEntryPalette(nametable, index);
+    }
+
+    for (uint32_t i = 0; i < PPU::OAM_ENTRIES; i++)
+    {
+        tileLayers.sprites[i] = *ppu.getOamSprite(i * sizeof(PPU::OamSprite));
+    }
+}
+
+bool NES::isInspectingConsole()
+{
+    for (IDrawable *drawable : drawables)
+    {
+        if (drawable->isActive() && drawable->isVisible() && drawable->inspectsConsole())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void NES::updatePatternTables()
+{
+    if (dirtyChrTiles.none())
+    {
+        return;
+    }
+
+    resources.getTexture("pattern_left")->updateTiles(chrTiles, 0x0000, dirtyChrTiles);
+    resources.getTexture("pattern_right")->updateTiles(chrTiles, 0x1000, dirtyChrTiles);
+    dirtyChrTiles.reset();
+}
+
+void NES::postInput()
+{
+    Controller::ButtonStates buttons = input.getKeyMap("joy1");
+
+    // Posted again next loop if the queue is full
+    if (buttons != postedInput && emulation.postInput(buttons))
+    {
+        postedInput = buttons;
+    }
+
+    bool rewind = input.isKeyDown(REWIND_KEY);
+
+    if (rewind != postedRewind && emulation.post(EmulationThread::CommandType::SetRewinding, rewind))
+    {
+        postedRewind = rewind;
+    }
+}
+
+void NES::drawFrame()
+{
+    glm::vec2 size(PPU::SCREEN_WIDTH * renderingScale, PPU::SCREEN_HEIGHT * renderingScale);
+
+    // Only uploaded when the emulation thread has finished a new frame
+    if (emulation.updateFrame())
+    {
+        frameTexture->update(emulation.getFrame().pixels);
+    }
+
+    // The whole picture is a single quad. The system palette is only loaded before the emulation thread starts
+    frameTexture->draw(getGraphicsOffset(), size, console.getPPU().getSystemPalette());
+}
+
+NES::LayerPalettes NES::getLayerPalettes()
+{
+    Span<const PPU::Color> resolved = console.getPPU().getResolvedPalette();
+    LayerPalettes colors;
+
+    // Background palettes, then sprite palettes, where color 0 is transparent
+    for (uint32_t i = 0; i < PPU::PALETTE_TABLE_SIZE; i++)
+    {
+        colors[i] = i % PPU::PALETTE_SIZE == 0 ? PPU::Color{ 0, 0, 0, 0 } : resolved[i];
+    }
+
+    // Solid background color
+    for (uint32_t i = PPU::PALETTE_TABLE_SIZE; i < colors.size(); i++)
+    {
+        colors[i] = resolved[0];
+    }
+
+    return colors;
+}
+
+void NES::drawBackground()
+{
     float tileSize = getTileSize();
     glm::vec2 offset = getGraphicsOffset();
 
-    uint8_t nametable = ppu.getRegisters()->ctrl.baseNametable;
-    Texture *patternTable = ResourceManager::getTexture(
-        ppu.getActiveBgPatternTableAddress() == 0x0000 ? "pattern_left" : "pattern_right");
-    uint16_t bgColorAddress = 0x3F00;
-	uint16_t bgPaletteAddresses[] = { 0x3F01, 0x3F05, 0x3F09, 0x3F0D };
-    std::vector<PPU::Color> grayscalePalette = { { 0, 0, 0, 0 }, { 50, 50, 50, 255 }, { 100, 100, 100, 255 }, { 200, 200, 200, 255 } };
+    Texture *patternTable = resources.getTexture(
+        tileLayers.bgPatternTable == 0x0000 ? "pattern_left" : "pattern_right");
 
     // Solid background color
     {
@@ -350,19 +652,15 @@ void NES::drawBackground()
         glm::vec2 texPos(0.0f, 0.0f);
         glm::vec2 texEndPos(patternTable->getWidth(), patternTable->getHeight());
 
-        // TODO: Draw this without needlessly using texture
-        PPU::Color bgColor = ppu.getPalette(bgColorAddress)[0];
-        std::vector<PPU::Color> palette(4, bgColor);
-
-        patternTable->draw(pos, size, texPos, texEndPos, palette);
+        tileBatch->add(pos, size, texPos, texEndPos, BACKGROUND_COLOR_PALETTE);
     }
 
     // Nametable background tiles
-    if (ppu.getRegisters()->mask.showBg)
+    if (tileLayers.registers.mask.showBg)
     {
         for (uint32_t r = 0; r < PPU::NAMETABLE_ROWS; r++)
         {
-            if (!ppu.getRegisters()->mask.showLeftmostBg)
+            if (!tileLayers.registers.mask.showLeftmostBg)
             {
                 continue;
             }
@@ -370,7 +668,7 @@ void NES::drawBackground()
             for (uint32_t c = 0; c < PPU::NAMETABLE_COLS; c++)
             {
                 uint16_t nametableIndex = r * PPU::NAMETABLE_COLS + c;
-                uint8_t patternIndex = ppu.readMemory(start + nametableIndex);
+                uint8_t patternIndex = tileLayers.patternIndices[nametableIndex];
                 float cTex = floor(patternIndex % PPU::PATTERN_TABLE_SIZE * PPU::TILE_SIZE);
                 float rTex = floor(patternIndex / PPU::PATTERN_TABLE_SIZE * PPU::TILE_SIZE);
 
@@ -378,58 +676,43 @@ void NES::drawBackground()
                 glm::vec2 size(tileSize, tileSize);
                 glm::vec2 texPos(cTex, rTex);
                 glm::vec2 texPosEnd(cTex + PPU::TILE_SIZE, rTex + PPU::TILE_SIZE);
-                glm::vec4 color(1.0f);
-
-                uint8_t paletteTableIndex = ppu.getNametableEntryPalette(nametable, nametableIndex);
-                uint16_t paletteAddress = bgPaletteAddresses[paletteTableIndex];
-                auto palette = ppu.getPalette(paletteAddress);
 
-                if (ppu.getRegisters()->mask.grayscale)
-                {
-                    palette = grayscalePalette;
-                }
-
-                patternTable->draw(pos, size, texPos, texPosEnd, palette, color);
+                uint8_t paletteTableIndex = tileLayers.paletteIndices[nametableIndex];
+                tileBatch->add(pos, size, texPos, texPosEnd, paletteTableIndex);
             }
         }
     }
+
+    // The whole layer is a single draw call
+    tileBatch->draw(patternTable);
 }
 
 void NES::drawSprites()
 {
-    if (!ppu.getRegisters()->mask.showSprites)
+    if (!tileLayers.registers.mask.showSprites)
     {
         return;
     }
 
     float tileSize = getTileSize();
     glm::vec2 offset = getGraphicsOffset();
-    Texture *patternTable = ResourceManager::getTexture(
-        ppu.getActiveSpritePatternTableAddress() == 0x0000 ? "pattern_left" : "pattern_right");
+    Texture *patternTable = resources.getTexture(
+        tileLayers.spritePatternTable == 0x0000 ? "pattern_left" : "pattern_right");
 
-    uint16_t paletteAddresses[] = { 0x3F11, 0x3F15, 0x3F19, 0x3F1D };
     uint16_t nesWidth = PPU::NAMETABLE_COLS * PPU::TILE_SIZE;
     uint16_t nesHeight = PPU::NAMETABLE_ROWS * PPU::TILE_SIZE;
-    std::vector<PPU::Color> grayscalePalette = { { 0, 0, 0, 0 }, { 50, 50, 50, 255 }, { 100, 100, 100, 255 }, { 200, 200, 200, 255 } };
 
     // 64 sprites in Oam to draw. Sprites with lower address are drawn on top
     for (int i = PPU::OAM_ENTRIES - 1; i >= 0; i--)
     {
-        PPU::OamSprite *sprite = ppu.getOamSprite(i * sizeof(PPU::OamSprite));
-        uint16_t paletteAddress = paletteAddresses[sprite->attributes.palette];
-        auto palette = ppu.getPalette(paletteAddress);
-
-        if (ppu.getRegisters()->mask.grayscale)
-        {
-            palette = grayscalePalette;
-        }
+        const PPU::OamSprite *sprite = &tileLayers.sprites[i];
 
         if (sprite->xPos > nesWidth || sprite->yPos > nesHeight)
         {
             continue;
         }
 
-        if (!ppu.getRegisters()->mask.showLeftmostSprite && sprite->xPos < 8)
+        if (!tileLayers.registers.mask.showLeftmostSprite && sprite->xPos < 8)
         {
             continue;
         }
@@ -441,7 +724,6 @@ void NES::drawSprites()
             sprite->attributes.priority == 0 ? FOREGROUND_SPRITE_DEPTH : BACKGROUND_SPRITE_DEPTH
         );
         glm::vec2 size(tileSize, tileSize);
-        glm::vec4 color(1.0f);
 
         // Texture coordinates
         float cTex = floor(sprite->tileIndex % PPU::PATTERN_TABLE_SIZE * PPU::TILE_SIZE);
@@ -462,6 +744,9 @@ void NES::drawSprites()
             texPosEnd.y = rTex;
         }
 
-        patternTable->draw(pos, size, texPos, texPosEnd, palette, color);
+        // Sprite palettes come after the 4 background palettes
+        tileBatch->add(pos, size, texPos, texPosEnd, SPRITE_PALETTE_START + sprite->attributes.palette);
     }
+
+    tileBatch->draw(patternTable);
 }
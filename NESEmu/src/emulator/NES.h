@@ -2,17 +2,23 @@
 
 #include <vector>
 
-#include "CPU.h"
-#include "PPU.h"
-#include "Bus.h"
-#include "Cartridge.h"
-#include "Controller.h"
+#include "Console.h"
+#include "EmulationThread.h"
+#include "../util/FramePacer.h"
+#include "../util/FrameArena.h"
 #include "../graphics/Graphics.h"
 #include "../graphics/IDrawable.h"
+#include "../graphics/FrameTexture.h"
+#include "../graphics/TileBatch.h"
+#include "../graphics/ResourceManager.h"
+#include "../util/Input.h"
 
 class NES
 {
 public:
+	// Amount of savestate slots
+	static constexpr size_t SAVE_SLOTS = 4;
+
 	// Initialize
 	NES();
 
@@ -25,9 +31,13 @@ public:
 	// Main window event loop
 	void run();
 
-	// Emulate one single NES cycle step
+	// Emulate one single CPU instruction, and catch the other components up to the CPU
 	void step();
 
+	// Emulate whole instructions for the given amount of CPU cycles. Cycles overshot are carried over to the next call.
+	// Runs on the calling thread, so only used before the emulation thread is started
+	void runCycles(uint32_t cycles);
+
 	// Close window on next loop
 	void shutdown();
 
@@ -46,12 +56,77 @@ public:
 	// Gets the current rendering scale
 	float getRenderingScale();
 
+	// Set whether the tile layers are drawn from the nametables and OAM, instead of the frame rendered by the PPU
+	void setDrawTileLayers(bool enabled);
+
+	// Gets whether the tile layers are drawn instead of the rendered frame
+	bool getDrawTileLayers() const;
+
 	// Set emulation speed
 	void setEmulationSpeed(double speed);
 
+	// Set whether the emulation runs uncapped (turbo), only drawing the frames that are presented
+	void setTurbo(bool enabled);
+
+	// Gets whether turbo is enabled
+	bool getTurbo() const;
+
+	// Set how often turbo presents a frame: every Nth emulated frame, or at the display rate when 0
+	void setTurboFrameSkip(uint32_t frames);
+
+	// Gets how often turbo presents a frame
+	uint32_t getTurboFrameSkip() const;
+
+	// Set how many frames ahead of the emulated one are shown, to hide input latency at the cost of emulating
+	// those frames again every frame. Only applies at normal speed
+	void setRunAhead(uint32_t frames);
+
+	// Gets how many frames ahead are shown
+	uint32_t getRunAhead() const;
+
+	// Pin the emulation thread to a CPU core (-1 for any), before the main loop starts
+	void setEmulationCore(int core);
+
+	// Pause emulation once the current instruction is done. Only called from within emulation (debug watches)
+	void requestBreak();
+
+	// Start or stop recording a trace of every executed CPU instruction
+	void setTracing(bool enabled);
+
+	// Gets whether CPU instructions are being traced
+	bool getTracing() const;
+
+	// Save the console into a savestate slot, locking it
+	bool saveState(size_t slot);
+
+	// Restore the console from a savestate slot, locking it
+	bool loadState(size_t slot);
+
+	// Lock the console for a drawable that changes it. The returned lock does not own the mutex when the console is
+	// already locked for the whole UI frame
+	std::unique_lock<std::mutex> lockConsole();
+
+	// Returns a savestate slot, which is empty until saved into
+	const SaveState &getSaveSlot(size_t slot) const;
+
+	// Returns the timing statistics of the emulation thread, as of the last frame it finished
+	FramePacer::Stats getEmulationStats() const;
+
+	// Returns the measured emulation rate, as of the last frame the emulation thread finished
+	EmulationThread::Throughput getEmulationThroughput() const;
+
+	// Returns how much of the rewind history is used, as of the last frame the emulation thread finished
+	RewindBuffer::Stats getRewindStats() const;
+
+	// Returns the CPU registers and instruction, as of the last frame the emulation thread finished
+	CPU::State getCpuState() const;
+
 	// Returns the currently loaded cartridge
 	Cartridge& getCartridge();
 
+	// Returns the CPU bus
+	Bus& getBus();
+
 	// Gets the current tile size with the applied rendering scale
 	float getTileSize();
 	
@@ -63,30 +138,98 @@ private:
 	int windowWidth, windowHeight;
 	int viewportWidth, viewportHeight;
 	
-	// Whether the emulation is running or paused
-	bool running;
-
 	// Whether the emulator window should close or not
 	bool shouldShutdown;
 
 	// The scale to apply when rendering the graphics
 	float renderingScale;
 
-	// Emulation speed
-	double emulationSpeed;
+	// Debug view that draws the background and sprites from the current nametables and OAM
+	bool drawTileLayers;
+
+	// Turbo settings, as last posted to the emulation thread
+	bool turbo;
+	uint32_t turboFrameSkip;
+
+	// Run-ahead frames, as last posted to the emulation thread
+	uint32_t runAheadFrames;
+
+	// Paces the main (UI) loop to the NES frame rate
+	FramePacer pacer;
 
 	// GLFW window handle
 	GLFWwindow *window;
 
+	// Keyboard state and shaders/textures of the window
+	Input input;
+	ResourceManager resources;
+
 	// List of all drawable components
 	std::vector<IDrawable*> drawables;
 
-	// NES Components
-	Bus bus;
-	Cartridge cartridge;
-	CPU cpu;
-	PPU ppu;
-	Controller controller;
+	// Set while the console is locked for the whole UI frame, for drawables inspecting it
+	bool consoleLocked;
+
+	// Scratch memory for the drawables, released at the start of every UI frame
+	FrameArena frameArena;
+
+	// Emulated hardware, run on its own thread
+	Console console;
+	EmulationThread emulation;
+	int emulationCore;
+
+	// Last controller input and rewind key state posted to the emulation thread
+	Controller::ButtonStates postedInput;
+	bool postedRewind;
+
+	// Savestates made from the debugger
+	std::array<SaveState, SAVE_SLOTS> saveSlots;
+
+	// Frame rendered by the PPU
+	FrameTexture *frameTexture;
+
+	// Batches the tiles of the tile layers debug view
+	TileBatch *tileBatch;
+
+	// Decoded pattern table tiles copied from the PPU, and the ones that changed since they were last uploaded
+	std::array<TileCache::Tile, PPU::CHR_TILE_COUNT> chrTiles;
+	PPU::ChrTileSet dirtyChrTiles;
+
+	// Copy what the pattern tables and tile layers show out of the console, which must be locked
+	void copyConsoleViews();
+
+	// Returns whether a visible drawable inspects the live console state
+	bool isInspectingConsole();
+
+	// Upload the pattern table tiles that changed since they were last copied
+	void updatePatternTables();
+
+	// Post the controller input and whether the rewind key is held to the emulation thread when they change
+	void postInput();
+
+	// Upload and draw the last frame finished by the emulation thread
+	void drawFrame();
+
+	// Palettes used by the tile layers: 4 background palettes, 4 sprite palettes and the background color
+	using LayerPalettes = std::array<PPU::Color, TileBatch::PALETTE_COUNT * TileBatch::PALETTE_SIZE>;
+
+	// Gets the colors of the tile layer palettes
+	LayerPalettes getLayerPalettes();
+
+	// Copy of the console state the tile layers are drawn from, so that they are drawn without the console locked
+	struct TileLayers
+	{
+		LayerPalettes colors;
+		PPU::Registers registers;
+		uint16_t bgPatternTable;
+		uint16_t spritePatternTable;
+
+		// Pattern and palette index of every entry of the active nametable
+		std::array<uint8_t, PPU::NAMETABLE_ROWS * PPU::NAMETABLE_COLS> patternIndices;
+		std::array<uint8_t, PPU::NAMETABLE_ROWS * PPU::NAMETABLE_COLS> paletteIndices;
+
+		std::array<PPU::OamSprite, PPU::OAM_ENTRIES> sprites;
+	} tileLayers;
 
 	// Draw PPU background
 	void drawBackground();
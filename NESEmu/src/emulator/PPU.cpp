@@ -1,5 +1,7 @@
 #include "PPU.h"
+#include "../util/Simd.h"
 
+#include <algorithm>
 #include <fstream>
 #include <bitset>
 #include <iostream>
@@ -9,7 +11,7 @@ using std::placeholders::_1;
 using std::placeholders::_2;
 using std::placeholders::_3;
 
-PPU::PPU(Bus &bus) : logger("..\\logs\\ppu.log"), bus(bus), mapper(nullptr)
+PPU::PPU(Bus &bus, Scheduler &scheduler) : bus(bus), scheduler(scheduler), mapper(nullptr)
 {
 	// TODO: Convert to modern C++ arrays
 	ciram = new uint8_t[CIRAM_SIZE]();
@@ -28,22 +30,46 @@ PPU::PPU(Bus &bus) : logger("..\\logs\\ppu.log"), bus(bus), mapper(nullptr)
 	registers->addr = 0;
 	registers->data = 0;
 
-	// Load system palette from .pal file
-	loadPalette("palette.pal");
-
 	// Set cycle related stats
 	cycles = 0;
 	scanlines = 0;
 	frames = 0;
+	totalCycles = 0;
 
-	// Set access info for PPUADDR/PPUDATA/OAMDMA
-	accessAddress = 0;
-	accessAddressHighByte = true;
+	// Set access info for PPUSCROLL/PPUADDR/PPUDATA/OAMDMA
+	vramAddress = 0;
+	tempAddress = 0;
+	fineX = 0;
+	writeToggle = false;
 	oamTransferRequested = false;
 
+	// Clear framebuffers
+	for (Framebuffer &framebuffer : framebuffers)
+	{
+		framebuffer.fill(0);
+	}
+
+	backBuffer = 0;
+	pixelOutput = true;
+	secondaryOamCount = 0;
+	spriteZeroOnScanline = false;
+	spriteZeroOpaque = 0;
+	spriteZeroHitCycle = 0;
+
+	// Palette colors are resolved on first use
+	resolvedPalette.fill({ 0, 0, 0, 255 });
+	resolvedPaletteDirty = true;
+	resolvedPaletteMask = 0;
+
 	// Callbacks
-	bus.registerMemoryAccessCallback(bind(&PPU::onRegisterAccess, this, _1, _2, _3));
+	bus.registerMemoryWatch(REGISTER_START_ADDRESS, REGISTER_END_ADDRESS, bind(&PPU::onRegisterAccess, this, _1, _2, _3));
 	bus.setPpuOamTransferCallback(bind(&PPU::writeOamData, this, _1));
+	scheduler.setCallback(Scheduler::EventType::VblankStart, bind(&PPU::onVblankStart, this, _1));
+	scheduler.setCallback(Scheduler::EventType::VblankEnd, bind(&PPU::onVblankEnd, this, _1));
+
+	// Events are scheduled at the end of the cycle they happen on, since that is when the CPU can observe them
+	scheduler.schedule(Scheduler::EventType::VblankStart, (getNextCycleAt(VBLANK_START_CYCLE) + 1) * Scheduler::PPU_CLOCK_DIVIDER);
+	scheduler.schedule(Scheduler::EventType::VblankEnd, (getNextCycleAt(VBLANK_END_CYCLE) + 1) * Scheduler::PPU_CLOCK_DIVIDER);
 
 	reset();
 }
@@ -62,8 +88,10 @@ void PPU::reset()
 	registers->scroll = 0;
 	registers->addr = 0;
 
-	accessAddress = 0;
-	accessAddressHighByte = true;
+	vramAddress = 0;
+	tempAddress = 0;
+	fineX = 0;
+	writeToggle = false;
 	isResetting = true;
 }
 
@@ -75,75 +103,169 @@ void PPU::step()
 		reset();
 	}
 
-	// 341 PPU cycles per scanline (0 - 340)
-	if (cycles >= 341)
+	if (scanlines <= 239)
 	{
-		cycles -= 341;
-		scanlines++;
+		// (0 - 239) Rendering, visible scanlines
 
-		// 261 scanlines per frame
-		if (scanlines > 261)
+		if (cycles == 1)
 		{
-			scanlines = 0;
-			frames++;
+			// The whole scanline is rendered at once, from the scroll position it starts at
+			renderScanline();
+		}
+		else if (cycles == spriteZeroHitCycle && spriteZeroHitCycle != 0)
+		{
+			// Sprite 0 hit is only visible to the CPU once the PPU reaches the pixel it happened on
+			registers->status.sprite0Hit = 1;
 		}
-	}
-
-	if (scanlines <= 239)
-	{
-		// (0 - 239) Rendering, visible scanlines
 
-		if (cycles >= 257 && cycles <= 320)
+		if (isRenderingEnabled())
 		{
-			registers->oamAddr = 0;
+			if (cycles == 256)
+			{
+				incrementScrollY();
+			}
+			else if (cycles == 257)
+			{
+				copyScrollX();
+			}
+
+			// OAMADDR is only reset by sprite fetching, which does not happen while rendering is disabled
+			if (cycles >= 257 && cycles <= 320)
+			{
+				registers->oamAddr = 0;
+			}
 		}
 	}
 	else if (scanlines == 240)
 	{
-		// (240) Post-render scan line - PPU idles
+		// (240) Post-render scan line - PPU idles, and the finished frame can be displayed
+
+		if (cycles == 0)
+		{
+			backBuffer ^= 1;
+		}
 	}
 	else if (scanlines >= 241 && scanlines <= 260)
 	{
-		// (241 - 260) Vblank
+		// (241 - 260) Vblank, set by a scheduled event
+	}
+	else if (scanlines >= 261)
+	{
+		// (261) Pre-render scanline, VBlank cleared by a scheduled event
 
-		if (scanlines == 241 && cycles == 1)
+		if (isRenderingEnabled())
 		{
-			// Set VBlank and trigger NMI
-			registers->status.vblank = 1;
-			nmiOccured = true;
+			if (cycles == 256)
+			{
+				incrementScrollY();
+			}
+			else if (cycles == 257)
+			{
+				copyScrollX();
+			}
+			else if (cycles >= 280 && cycles <= 304)
+			{
+				copyScrollY();
+			}
 
-			if (registers->ctrl.nmiEnable)
+			if (cycles >= 257 && cycles <= 320)
 			{
-				bus.dispatchNmi();
+				registers->oamAddr = 0;
 			}
 		}
 	}
-	else if (scanlines >= 261)
+
+	advanceCycles(1);
+}
+
+void PPU::run(uint32_t dots)
+{
+	// Registers can only change through the CPU, which syncs the PPU before any access. So within a run, the cycles
+	// between two that have work to do can be skipped over, and the first cycle of the run is always emulated
+	while (dots > 0)
 	{
-		// (261) Pre-render scanline
+		uint32_t cycle = cycles;
+		step();
+		dots--;
 
-		if (cycles == 1)
+		// The scanline has ended, and the next one starts with work to check
+		if (cycles == 0)
 		{
-			// Clear VBlank
-			registers->status.vblank = 0;
-			nmiOccured = false;
+			continue;
+		}
+
+		uint32_t idle = std::min(getNextWorkCycle(cycle) - cycles, dots);
+		advanceCycles(idle);
+		dots -= idle;
+	}
+}
 
-			// Clear sprite flags
-			registers->status.sprite0Hit = 0;
-			registers->status.spriteOverflow = 0;
+void PPU::runUntil(uint64_t targetCycle)
+{
+	while (totalCycles < targetCycle)
+	{
+		run(static_cast<uint32_t>(std::min<uint64_t>(targetCycle - totalCycles, CYCLES_PER_FRAME)));
+	}
+}
+
+uint32_t PPU::getNextWorkCycle(uint32_t cycle)
+{
+	uint32_t next = CYCLES_PER_SCANLINE;
 
-			// Clear resetting status
-			isResetting = false;
+	auto consider = [&](uint32_t workCycle)
+	{
+		if (workCycle > cycle && workCycle < next)
+		{
+			next = workCycle;
 		}
+	};
+
+	if (scanlines <= 239)
+	{
+		// Scanline rendering and the delayed sprite 0 hit
+		consider(1);
+
+		if (spriteZeroHitCycle != 0)
+		{
+			consider(spriteZeroHitCycle);
+		}
+	}
+
+	if ((scanlines <= 239 || scanlines == 261) && isRenderingEnabled())
+	{
+		// Scroll updates, and the start of the OAMADDR reset (257 - 320)
+		consider(256);
+		consider(257);
 
-		if (cycles >= 257 && cycles <= 320)
+		// Vertical scroll copy (280 - 304)
+		if (scanlines == 261)
 		{
-			registers->oamAddr = 0;
+			consider(280);
 		}
 	}
 
-	cycles++;
-	totalCycles++;
+	// The post-render and VBlank scanlines only have work on cycle 0, and VBlank itself is a scheduled event
+	return next;
+}
+
+void PPU::advanceCycles(uint32_t count)
+{
+	cycles += count;
+	totalCycles += count;
+
+	// 341 PPU cycles per scanline (0 - 340). Counters wrap as soon as a scanline ends, so that a finished frame is counted
+	if (cycles >= CYCLES_PER_SCANLINE)
+	{
+		cycles -= CYCLES_PER_SCANLINE;
+		scanlines++;
+
+		// 262 scanlines per frame (0 - 261)
+		if (scanlines > 261)
+		{
+			scanlines = 0;
+			frames++;
+		}
+	}
 }
 
 uint8_t PPU::readMemory(uint16_t address)
@@ -185,7 +307,7 @@ uint8_t PPU::readMemory(uint16_t address)
 	{
 		// $3F00 - $3F1F: Palette RAM
 		// $3F20 - $3FFF: Mirrors $3F00 - $3F1F
-		uint16_t offset = (address - 0x3F00) % 0x20;
+		uint16_t offset = mirrorPaletteAddress(address);
 		return paletteTables[offset];
 	}
 
@@ -229,8 +351,9 @@ void PPU::writeMemory(uint16_t address, uint8_t value)
 	{
 		// $3F00 - $3F1F: Palette RAM
 		// $3F20 - $3FFF: Mirrors $3F00 - $3F1F
-		uint16_t offset = (address - 0x3F00) % 0x20;
+		uint16_t offset = mirrorPaletteAddress(address);
 		paletteTables[offset] = value;
+		resolvedPaletteDirty = true;
 	}
 }
 
@@ -316,36 +439,20 @@ uint16_t PPU::getActiveSpritePatternTableAddress()
 	return registers->ctrl.spritePatternTable * 0x1000;
 }
 
-std::vector<PPU::Color> PPU::getPalette(uint16_t address)
+Span<const PPU::Color> PPU::getResolvedPalette()
 {
-	std::vector<Color> palette;
-
-	if (address == 0x3F00)
-	{
-		// If only requesting background, return correct color
-		uint8_t bgIndex = readMemory(0x3F00);
-		palette.push_back(systemPalette[bgIndex]);
-	}
-	else if (address >= 0x3F01 && address <= 0x3F1F)
-	{
-		// For other palettes, return transparent color as background
-		Color transparent = { 0, 0, 0, 0 };
-		palette.push_back(transparent);
-
-		// Background and sprite palettes
-		for (uint16_t i = 0; i < 3; i++)
-		{
-			uint8_t colorIndex = readMemory(address + i);
-			palette.push_back(systemPalette[colorIndex]);
-		}
-	}
+	resolvePalette();
+	return Span<const Color>(resolvedPalette);
+}
 
-	return palette;
+Span<const PPU::Color> PPU::getResolvedPalette(uint8_t palette)
+{
+	return getResolvedPalette().subspan((palette % PALETTE_COUNT) * PALETTE_SIZE, PALETTE_SIZE);
 }
 
-std::vector<PPU::Color> PPU::getSystemPalette()
+Span<const PPU::Color> PPU::getSystemPalette()
 {
-	return systemPalette;
+	return Span<const Color>(systemPalette);
 }
 
 bool PPU::getNmiOccured()
@@ -359,9 +466,126 @@ bool PPU::isOamTransferRequested()
 	return oamTransferRequested;
 }
 
+void PPU::serialize(StateSerializer &state)
+{
+	// Sprite evaluation is only kept within a scanline, and the resolved palette is derived from the palette table
+	state.beginChunk(StateSerializer::ChunkId::PPU);
+	state.value(cycles);
+	state.value(scanlines);
+	state.value(frames);
+	state.value(totalCycles);
+	state.bytes(ciram, CIRAM_SIZE);
+	state.bytes(paletteTables, PALETTE_TABLE_SIZE);
+	state.bytes(oam, OAM_SIZE);
+	state.value(vramAddress);
+	state.value(tempAddress);
+	state.value(fineX);
+	state.value(writeToggle);
+
+	// Without the framebuffers, the buffers are left as they are, so that the last finished frame is still shown
+	if (state.hasFramebuffers())
+	{
+		state.value(backBuffer);
+		state.value(framebuffers);
+	}
+
+	state.value(spriteZeroHitCycle);
+	state.value(nmiOccured);
+	state.value(oamTransferRequested);
+	state.value(isResetting);
+	state.endChunk();
+
+	if (state.isLoading())
+	{
+		backBuffer &= 1;
+		resolvedPaletteDirty = true;
+	}
+}
+
 void PPU::setMapper(IMapper *mapper)
 {
 	this->mapper = mapper;
+
+	// All of CHR memory is new
+	dirtyChrTiles.set();
+	tileCache.setMapper(mapper);
+	mapper->setChrChangedCallback(bind(&PPU::markChrChanged, this, _1, _2));
+}
+
+void PPU::markChrChanged(uint16_t address, uint16_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	tileCache.invalidate(address, size);
+
+	uint32_t first = address / CHR_TILE_BYTES;
+	uint32_t last = std::min<uint32_t>((address + size - 1) / CHR_TILE_BYTES, CHR_TILE_COUNT - 1);
+
+	for (uint32_t tile = first; tile <= last; tile++)
+	{
+		dirtyChrTiles.set(tile);
+	}
+}
+
+void PPU::resolvePalette()
+{
+	// Only grayscale and color emphasis bits of PPUMASK change colors
+	uint8_t mask = *reinterpret_cast<uint8_t *>(&registers->mask) & 0xE1;
+
+	if (!resolvedPaletteDirty && mask == resolvedPaletteMask)
+	{
+		return;
+	}
+
+	resolvedPaletteDirty = false;
+	resolvedPaletteMask = mask;
+
+	// Grayscale only keeps the column of gray colors from the system palette
+	uint8_t colorMask = registers->mask.grayscale ? 0x30 : 0x3F;
+	bool emphasis = registers->mask.emphasizeRed || registers->mask.emphasizeGreen || registers->mask.emphasizeBlue;
+
+	for (uint16_t i = 0; i < PALETTE_TABLE_SIZE; i++)
+	{
+		uint8_t index = paletteTables[mirrorPaletteAddress(0x3F00 + i)] & colorMask;
+		Color color = index < systemPalette.size() ? systemPalette[index] : Color{ 0, 0, 0, 255 };
+
+		// Emphasizing colors darkens the other ones, by roughly 25%
+		if (emphasis)
+		{
+			if (!registers->mask.emphasizeRed)
+			{
+				color.r = color.r * 3 / 4;
+			}
+
+			if (!registers->mask.emphasizeGreen)
+			{
+				color.g = color.g * 3 / 4;
+			}
+
+			if (!registers->mask.emphasizeBlue)
+			{
+				color.b = color.b * 3 / 4;
+			}
+		}
+
+		resolvedPalette[i] = color;
+	}
+}
+
+uint16_t PPU::mirrorPaletteAddress(uint16_t address)
+{
+	uint16_t offset = (address - 0x3F00) % PALETTE_TABLE_SIZE;
+
+	// $3F10/$3F14/$3F18/$3F1C mirror the background color entries $3F00/$3F04/$3F08/$3F0C
+	if ((offset & 0x13) == 0x10)
+	{
+		offset &= 0x0F;
+	}
+
+	return offset;
 }
 
 uint16_t PPU::mirrorNametableAddress(uint16_t address)
@@ -400,7 +624,7 @@ uint16_t PPU::mirrorNametableAddress(uint16_t address)
 	return 0;
 }
 
-void PPU::loadPalette(std::string path)
+bool PPU::loadPalette(std::string path)
 {
 	std::ifstream stream;
 	stream.open(path, std::ifstream::binary);
@@ -408,7 +632,7 @@ void PPU::loadPalette(std::string path)
 	if (!stream.is_open())
 	{
 		printf("Error, failed to load palette: %s\n", path.c_str());
-		return;
+		return false;
 	}
 
 	// NES colors have no alpha value, so set to max
@@ -416,13 +640,18 @@ void PPU::loadPalette(std::string path)
 	color.a = 255;
 
 	// Read first 64 palette color entries
+	systemPalette.clear();
+
 	while (!stream.eof() && systemPalette.size() < 64)
 	{
 		stream.read((char *)&color, 3);
 		systemPalette.push_back(color);
 	}
 
+	resolvedPaletteDirty = true;
+
 	printf("Loaded %zu system palette colors\n", systemPalette.size());
+	return true;
 }
 
 void PPU::onRegisterAccess(uint16_t address, uint8_t newValue, bool write)
@@ -436,6 +665,9 @@ void PPU::onRegisterAccess(uint16_t address, uint8_t newValue, bool write)
 		if (write)
 		{
 			// TODO: Add this
+
+			// t: ...GH.. ........ <- d: ......GH
+			tempAddress = (tempAddress & ~0x0C00) | ((newValue & 0x03) << 10);
 		}
 
 		break;
@@ -449,6 +681,7 @@ void PPU::onRegisterAccess(uint16_t address, uint8_t newValue, bool write)
 		{
 			registers->status.vblank = 0;
 			nmiOccured = false;
+			writeToggle = false;
 		}
 
 		break;
@@ -467,30 +700,54 @@ void PPU::onRegisterAccess(uint16_t address, uint8_t newValue, bool write)
 		break;
 	}
 
+	// PPUSCROLL ($2005)
+	case 0x2005:
+	{
+		if (write)
+		{
+			if (!writeToggle)
+			{
+				// t: ....... ...ABCDE <- d: ABCDE...
+				// x:              FGH <- d: .....FGH
+				tempAddress = (tempAddress & ~0x001F) | (newValue >> 3);
+				fineX = newValue & 0x07;
+			}
+			else
+			{
+				// t: FGH..AB CDE..... <- d: ABCDEFGH
+				tempAddress = (tempAddress & ~0x73E0) | ((newValue & 0x07) << 12) | ((newValue & 0xF8) << 2);
+			}
+
+			writeToggle = !writeToggle;
+		}
+
+		break;
+	}
+
 	// PPUADDR ($2006)
 	case 0x2006:
 	{
 		if (write)
 		{
-			uint16_t mask = 0x00FF;
-			uint16_t val = newValue;
-
-			if (accessAddressHighByte)
+			if (!writeToggle)
 			{
-				mask = 0xFF00;
-				val <<= 8;
+				// t: .CDEFGH ........ <- d: ..CDEFGH, and bit 14 of t is cleared
+				tempAddress = (tempAddress & 0x00FF) | ((newValue & 0x3F) << 8);
+			}
+			else
+			{
+				// t: ....... ABCDEFGH <- d: ABCDEFGH, then v is set to t
+				tempAddress = (tempAddress & 0xFF00) | newValue;
+				vramAddress = tempAddress;
 			}
-
-			accessAddress &= ~mask;
-			accessAddress |= val;
 
 			registers->data = 0;
-			accessAddressHighByte = !accessAddressHighByte;
+			writeToggle = !writeToggle;
 
 			// If reading palette data, update immediately
-			if (accessAddress >= 0x3F00 && accessAddress <= 0x3FFF)
+			if (vramAddress >= 0x3F00 && vramAddress <= 0x3FFF)
 			{
-				registers->data = readMemory(accessAddress);
+				registers->data = readMemory(vramAddress);
 			}
 		}
 
@@ -500,25 +757,32 @@ void PPU::onRegisterAccess(uint16_t address, uint8_t newValue, bool write)
 	// PPUDATA ($2007)
 	case 0x2007:
 	{
+		uint16_t address = vramAddress & 0x3FFF;
+
 		if (write)
 		{
-			writeMemory(accessAddress, newValue);
+			writeMemory(address, newValue);
 		}
 
 		// Update value post-read if from memory before the palette data
-		if (accessAddress <= 0x3EFF)
+		if (address <= 0x3EFF)
 		{
-			registers->data = readMemory(accessAddress);
+			registers->data = readMemory(address);
 		}
 
-		// Increment after access
-		if (registers->ctrl.addressIncrement == 0)
+		// Increment after access. While rendering, the access increments v the same way rendering does
+		if (isRenderingEnabled() && (scanlines <= 239 || scanlines == 261))
 		{
-			accessAddress++;
+			incrementScrollX(vramAddress);
+			incrementScrollY();
+		}
+		else if (registers->ctrl.addressIncrement == 0)
+		{
+			vramAddress = (vramAddress + 1) & 0x7FFF;
 		}
 		else
 		{
-			accessAddress += 32;
+			vramAddress = (vramAddress + 32) & 0x7FFF;
 		}
 
 		break;
@@ -541,7 +805,428 @@ uint32_t PPU::getFrameCount()
 	return frames;
 }
 
-uint32_t PPU::getTotalCycles()
+uint64_t PPU::getTotalCycles()
 {
 	return totalCycles;
-}
\ No newline at end of file
+}
+
+uint64_t PPU::getNextFrameCycle()
+{
+	// If the current frame has just started, the next one is a whole frame away
+	uint64_t next = getNextCycleAt(0);
+	return next == totalCycles ? next + CYCLES_PER_FRAME : next;
+}
+
+const PPU::Framebuffer &PPU::getFramebuffer() const
+{
+	return framebuffers[backBuffer ^ 1];
+}
+
+void PPU::setPixelOutput(bool enabled)
+{
+	pixelOutput = enabled;
+}
+
+const PPU::ChrTileSet &PPU::getDirtyChrTiles() const
+{
+	return dirtyChrTiles;
+}
+
+void PPU::clearDirtyChrTiles()
+{
+	dirtyChrTiles.reset();
+}
+
+const uint8_t *PPU::getDecodedTile(uint16_t index)
+{
+	return tileCache.getTile(index % CHR_TILE_COUNT);
+}
+
+uint64_t PPU::getNextCycleAt(uint32_t framePosition)
+{
+	// Position of the next cycle to be emulated within the current frame
+	uint32_t position = scanlines * CYCLES_PER_SCANLINE + cycles;
+	uint32_t remaining = (framePosition + CYCLES_PER_FRAME - position % CYCLES_PER_FRAME) % CYCLES_PER_FRAME;
+
+	return totalCycles + remaining;
+}
+
+void PPU::onVblankStart(uint64_t time)
+{
+	runUntil(time / Scheduler::PPU_CLOCK_DIVIDER);
+
+	// Set VBlank and trigger NMI, which the CPU handles before its next instruction
+	registers->status.vblank = 1;
+	nmiOccured = true;
+
+	if (registers->ctrl.nmiEnable)
+	{
+		scheduler.schedule(Scheduler::EventType::Nmi, scheduler.getCurrentTime());
+	}
+
+	scheduler.schedule(Scheduler::EventType::VblankStart, time + CYCLES_PER_FRAME * Scheduler::PPU_CLOCK_DIVIDER);
+}
+
+void PPU::onVblankEnd(uint64_t time)
+{
+	runUntil(time / Scheduler::PPU_CLOCK_DIVIDER);
+
+	// Clear VBlank
+	registers->status.vblank = 0;
+	nmiOccured = false;
+
+	// Clear sprite flags
+	registers->status.sprite0Hit = 0;
+	registers->status.spriteOverflow = 0;
+
+	// Clear resetting status
+	isResetting = false;
+
+	scheduler.schedule(Scheduler::EventType::VblankEnd, time + CYCLES_PER_FRAME * Scheduler::PPU_CLOCK_DIVIDER);
+}
+
+bool PPU::isRenderingEnabled()
+{
+	return registers->mask.showBg || registers->mask.showSprites;
+}
+
+void PPU::renderScanline()
+{
+	// Scanline 0 is rendered as soon as a frame starts, which is usually within the last instruction of the run
+	// before, so it is always drawn: the frame after one that is skipped can then be drawn whole
+	if (!pixelOutput && scanlines != 0)
+	{
+		evaluateScanline();
+		return;
+	}
+
+	uint8_t *output = framebuffers[backBuffer].data() + scanlines * SCREEN_WIDTH;
+	spriteZeroOpaque = 0;
+	spriteZeroHitCycle = 0;
+
+	if (!isRenderingEnabled())
+	{
+		// Only the background color is output while rendering is disabled
+		std::fill(output, output + SCREEN_WIDTH, paletteTables[0] & 0x3F);
+		return;
+	}
+
+	// Palette RAM offsets of each pixel, where 0 is transparent
+	uint8_t background[SCREEN_WIDTH] = { 0 };
+	uint8_t sprites[SCREEN_WIDTH] = { 0 };
+	bool behindBackground[SCREEN_WIDTH] = { false };
+
+	if (registers->mask.showBg)
+	{
+		renderBackground(background);
+	}
+
+	if (registers->mask.showSprites)
+	{
+		evaluateSprites();
+		renderSprites(sprites, behindBackground, secondaryOamCount);
+		detectSpriteZeroHit(background);
+	}
+
+	// Grayscale only keeps the column of gray colors from the system palette
+	uint8_t colorMask = registers->mask.grayscale ? 0x30 : 0x3F;
+
+	for (uint16_t x = 0; x < SCREEN_WIDTH; x++)
+	{
+		uint8_t bgPixel = background[x];
+		uint8_t spritePixel = sprites[x];
+		uint8_t offset = bgPixel;
+
+		if (spritePixel != 0 && (bgPixel == 0 || !behindBackground[x]))
+		{
+			offset = spritePixel;
+		}
+
+		output[x] = paletteTables[offset] & colorMask;
+	}
+}
+
+void PPU::evaluateScanline()
+{
+	spriteZeroOpaque = 0;
+	spriteZeroHitCycle = 0;
+
+	if (!registers->mask.showSprites)
+	{
+		return;
+	}
+
+	evaluateSprites();
+
+	// Sprite 0 hit needs both layers, but sprite 0 has priority over every other sprite, so it is drawn alone
+	if (spriteZeroOnScanline && registers->mask.showBg)
+	{
+		uint8_t background[SCREEN_WIDTH] = { 0 };
+		uint8_t sprites[SCREEN_WIDTH] = { 0 };
+		bool behindBackground[SCREEN_WIDTH] = { false };
+
+		renderBackground(background);
+		renderSprites(sprites, behindBackground, 1);
+		detectSpriteZeroHit(background);
+	}
+}
+
+void PPU::renderBackground(uint8_t *pixels)
+{
+	// Enough tiles to cover the scanline when it is scrolled by a partial tile
+	uint8_t tilePixels[SCREEN_WIDTH + TILE_SIZE];
+	uint16_t address = vramAddress;
+	uint16_t firstTile = registers->ctrl.bgPatternTable * 256;
+	uint16_t fineY = (vramAddress >> 12) & 0x07;
+
+	for (uint16_t tile = 0; tile <= SCREEN_WIDTH / TILE_SIZE; tile++)
+	{
+		uint8_t tileIndex = readMemory(0x2000 | (address & 0x0FFF));
+		uint8_t attribute = readMemory(0x23C0 | (address & 0x0C00) | ((address >> 4) & 0x38) | ((address >> 2) & 0x07));
+
+		// Each attribute byte covers 4x4 tiles, 2 bits per 2x2 tile quadrant
+		uint8_t attributeShift = ((address >> 4) & 0x04) | (address & 0x02);
+		uint8_t palette = (attribute >> attributeShift) & 0x03;
+
+		const uint8_t *row = tileCache.getTile(firstTile + tileIndex) + fineY * TILE_SIZE;
+
+		for (uint8_t x = 0; x < TILE_SIZE; x++)
+		{
+			uint8_t pixel = row[x];
+			tilePixels[tile * TILE_SIZE + x] = pixel == 0 ? 0 : (palette << 2) | pixel;
+		}
+
+		incrementScrollX(address);
+	}
+
+	uint16_t start = registers->mask.showLeftmostBg ? 0 : TILE_SIZE;
+
+	for (uint16_t x = start; x < SCREEN_WIDTH; x++)
+	{
+		pixels[x] = tilePixels[x + fineX];
+	}
+}
+
+void PPU::evaluateSprites()
+{
+	uint8_t height = registers->ctrl.spriteSize ? 16 : 8;
+	uint64_t found = findScanlineSprites(height);
+
+	secondaryOamCount = 0;
+	spriteZeroOnScanline = (found & 1) != 0;
+
+	// Take the sprites in OAM order, as lower entries have priority
+	while (found != 0)
+	{
+		// Only 8 sprites fit on a scanline
+		if (secondaryOamCount == SPRITES_PER_SCANLINE)
+		{
+			registers->status.spriteOverflow = 1;
+			break;
+		}
+
+		uint32_t entry = countTrailingZeros(found);
+		found &= found - 1;
+
+		secondaryOam[secondaryOamCount] = *reinterpret_cast<OamSprite *>(&oam[entry * 4]);
+		secondaryOamCount++;
+	}
+}
+
+uint64_t PPU::findScanlineSprites(uint8_t height)
+{
+#ifdef NESEMU_SSE2
+	// Sprites are delayed by one scanline, so a sprite covers the scanlines Y + 1 to Y + height, and none are on
+	// the first one
+	if (scanlines == 0)
+	{
+		return 0;
+	}
+
+	const __m128i yMask = _mm_set1_epi32(0xFF);
+	const __m128i lastY = _mm_set1_epi8(static_cast<char>(scanlines - 1));
+	const __m128i lastRow = _mm_set1_epi8(static_cast<char>(height - 1));
+	uint64_t found = 0;
+
+	for (int group = 0; group < 4; group++)
+	{
+		const __m128i *entries = reinterpret_cast<const __m128i *>(oam + group * 64);
+
+		// Y is the first byte of each 4 byte entry: gather it from 16 entries into one register
+		__m128i y0 = _mm_and_si128(_mm_loadu_si128(entries), yMask);
+		__m128i y1 = _mm_and_si128(_mm_loadu_si128(entries + 1), yMask);
+		__m128i y2 = _mm_and_si128(_mm_loadu_si128(entries + 2), yMask);
+		__m128i y3 = _mm_and_si128(_mm_loadu_si128(entries + 3), yMask);
+		__m128i y = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+
+		// The sprite is on the scanline if Y <= scanline - 1, and its row (scanline - 1 - Y) is within its height.
+		// Only unsigned min/max exist for bytes, so both compares are done with them
+		__m128i above = _mm_cmpeq_epi8(_mm_max_epu8(y, lastY), lastY);
+		__m128i row = _mm_subs_epu8(lastY, y);
+		__m128i inside = _mm_cmpeq_epi8(_mm_min_epu8(row, lastRow), row);
+
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(above, inside)));
+		found |= static_cast<uint64_t>(mask) << (group * 16);
+	}
+
+	return found;
+#else
+	return findScanlineSpritesScalar(height);
+#endif
+}
+
+uint64_t PPU::findScanlineSpritesScalar(uint8_t height)
+{
+	uint64_t found = 0;
+
+	for (uint16_t i = 0; i < OAM_ENTRIES; i++)
+	{
+		// Sprites are delayed by one scanline, so Y is the scanline above the top of the sprite
+		uint32_t row = scanlines - oam[i * 4] - 1;
+
+		if (row < height)
+		{
+			found |= 1ull << i;
+		}
+	}
+
+	return found;
+}
+
+void PPU::renderSprites(uint8_t *pixels, bool *behindBackground, uint8_t count)
+{
+	uint8_t height = registers->ctrl.spriteSize ? 16 : 8;
+	uint16_t start = registers->mask.showLeftmostSprite ? 0 : TILE_SIZE;
+
+	for (uint8_t i = 0; i < std::min(count, secondaryOamCount); i++)
+	{
+		const OamSprite &sprite = secondaryOam[i];
+		uint32_t row = scanlines - sprite.yPos - 1;
+
+		if (sprite.attributes.flipVertical)
+		{
+			row = height - 1 - row;
+		}
+
+		uint16_t tile;
+
+		if (height == 16)
+		{
+			// 8x16 sprites pick the pattern table with bit 0 of the tile index, and are made of 2 consecutive tiles
+			tile = (sprite.tileIndex & 0x01) * 256 + (sprite.tileIndex & 0xFE) + (row >= 8 ? 1 : 0);
+		}
+		else
+		{
+			tile = registers->ctrl.spritePatternTable * 256 + sprite.tileIndex;
+		}
+
+		const uint8_t *tileRow = tileCache.getTile(tile) + (row & 0x07) * TILE_SIZE;
+		bool isSpriteZero = i == 0 && spriteZeroOnScanline;
+
+		for (uint8_t bit = 0; bit < TILE_SIZE; bit++)
+		{
+			uint16_t x = sprite.xPos + bit;
+
+			// Pixels of sprites with a lower OAM index have priority
+			if (x >= SCREEN_WIDTH || x < start || pixels[x] != 0)
+			{
+				continue;
+			}
+
+			uint8_t pixel = tileRow[sprite.attributes.flipHorizontal ? 7 - bit : bit];
+
+			if (pixel == 0)
+			{
+				continue;
+			}
+
+			pixels[x] = 0x10 | (sprite.attributes.palette << 2) | pixel;
+			behindBackground[x] = sprite.attributes.priority;
+
+			if (isSpriteZero)
+			{
+				spriteZeroOpaque |= 1 << bit;
+			}
+		}
+	}
+}
+
+void PPU::detectSpriteZeroHit(const uint8_t *background)
+{
+	if (spriteZeroOpaque == 0 || registers->status.sprite0Hit != 0)
+	{
+		return;
+	}
+
+	// Sprite 0 hit happens when an opaque sprite 0 pixel overlaps an opaque background pixel, except at x = 255.
+	// Only the 8 pixels of sprite 0 need to be checked
+	uint16_t spriteX = secondaryOam[0].xPos;
+
+	for (uint8_t bit = 0; bit < TILE_SIZE; bit++)
+	{
+		uint16_t x = spriteX + bit;
+
+		if ((spriteZeroOpaque & (1 << bit)) && background[x] != 0 && x != 255)
+		{
+			spriteZeroHitCycle = x + 2;
+			return;
+		}
+	}
+}
+
+void PPU::incrementScrollX(uint16_t &address)
+{
+	if ((address & 0x001F) == 31)
+	{
+		// Wrap coarse X, and switch horizontal nametable
+		address &= ~0x001F;
+		address ^= 0x0400;
+	}
+	else
+	{
+		address++;
+	}
+}
+
+void PPU::incrementScrollY()
+{
+	if ((vramAddress & 0x7000) != 0x7000)
+	{
+		// Increment fine Y
+		vramAddress += 0x1000;
+		return;
+	}
+
+	vramAddress &= ~0x7000;
+	uint16_t coarseY = (vramAddress & 0x03E0) >> 5;
+
+	if (coarseY == 29)
+	{
+		// Last row of the nametable, switch vertical nametable
+		coarseY = 0;
+		vramAddress ^= 0x0800;
+	}
+	else if (coarseY == 31)
+	{
+		// Coarse Y set out of bounds wraps without switching nametable
+		coarseY = 0;
+	}
+	else
+	{
+		coarseY++;
+	}
+
+	vramAddress = (vramAddress & ~0x03E0) | (coarseY << 5);
+}
+
+void PPU::copyScrollX()
+{
+	// v: ....A.. ...BCDEF <- t: ....A.. ...BCDEF
+	vramAddress = (vramAddress & ~0x041F) | (tempAddress & 0x041F);
+}
+
+void PPU::copyScrollY()
+{
+	// v: GHIA.BC DEF..... <- t: GHIA.BC DEF.....
+	vramAddress = (vramAddress & ~0x7BE0) | (tempAddress & 0x7BE0);
+}
@@ -1,8 +1,13 @@
 #pragma once
 
-#include "../util/Logger.h"
 #include "Bus.h"
+#include "Scheduler.h"
+#include "TileCache.h"
+#include "SaveState.h"
+#include "../util/Span.h"
 
+#include <array>
+#include <bitset>
 #include <vector>
 
 class PPU
@@ -27,17 +32,42 @@ public:
 	// Amount of entries in OAM
 	static constexpr uint16_t OAM_ENTRIES = 64;
 
+	// Amount of sprites that can be drawn on a scanline, held in secondary OAM
+	static constexpr uint8_t SPRITES_PER_SCANLINE = 8;
+
 	// Size of OAM in bytes
 	static constexpr uint16_t OAM_SIZE = 256;
 
+	// Pattern tables ($0000 - $1FFF) hold 512 tiles of 16 bytes
+	static constexpr uint16_t CHR_TILE_COUNT = TileCache::TILE_COUNT;
+	static constexpr uint16_t CHR_TILE_BYTES = TileCache::TILE_BYTES;
+
 	// Size of palette table in bytes
 	static constexpr uint16_t PALETTE_TABLE_SIZE = 0x20;
 
+	// Palette table holds 4 background palettes, then 4 sprite palettes, of 4 colors each
+	static constexpr uint8_t PALETTE_COUNT = 8;
+	static constexpr uint8_t PALETTE_SIZE = 4;
+
+	// Frame timing: 341 cycles per scanline, 262 scanlines per frame
+	static constexpr uint32_t CYCLES_PER_SCANLINE = 341;
+	static constexpr uint32_t SCANLINES_PER_FRAME = 262;
+	static constexpr uint32_t CYCLES_PER_FRAME = CYCLES_PER_SCANLINE * SCANLINES_PER_FRAME;
+
+	// Position of the cycles that set VBlank (scanline 241, cycle 1) and clear it (scanline 261, cycle 1) within a frame
+	static constexpr uint32_t VBLANK_START_CYCLE = 241 * CYCLES_PER_SCANLINE + 1;
+	static constexpr uint32_t VBLANK_END_CYCLE = 261 * CYCLES_PER_SCANLINE + 1;
+
 	// Size of CIRAM, enough to hold two nametables: 2 KiB ($800)
 	static constexpr uint16_t CIRAM_SIZE = 0x800;
 
+	// Size of the visible picture in pixels
+	static constexpr uint16_t SCREEN_WIDTH = 256;
+	static constexpr uint16_t SCREEN_HEIGHT = 240;
+
 	// Location of registers on CPU memory bus
 	static constexpr uint16_t REGISTER_START_ADDRESS = Bus::PPUCTRL;
+	static constexpr uint16_t REGISTER_END_ADDRESS = 0x2007;
 
 	// Represents a system palette color
 	struct Color
@@ -95,8 +125,14 @@ public:
 		uint8_t data;
 	};
 
+	// A rendered picture, as the 6-bit system palette index of every pixel
+	using Framebuffer = std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>;
+
+	// One bit per pattern table tile
+	using ChrTileSet = std::bitset<CHR_TILE_COUNT>;
+
 	// Initialize memory
-	PPU(Bus &bus);
+	PPU(Bus &bus, Scheduler &scheduler);
 	
 	// Cleanup memory
 	~PPU();
@@ -107,6 +143,12 @@ public:
 	// Emulate one PPU cycle
 	void step();
 
+	// Emulate the given amount of PPU cycles, skipping over the cycles that do no work
+	void run(uint32_t dots);
+
+	// Emulate PPU cycles until the total cycle count reaches the target cycle
+	void runUntil(uint64_t targetCycle);
+
 	// Reads from memory location
 	uint8_t readMemory(uint16_t address);
 
@@ -134,11 +176,17 @@ public:
 	// Gets the address of the sprite pattern table
 	uint16_t getActiveSpritePatternTableAddress();
 
-	// Gets the color palette starting at the given address
-	std::vector<Color> getPalette(uint16_t address);
+	// Returns the colors of the whole palette table, with grayscale and color emphasis applied
+	Span<const Color> getResolvedPalette();
+
+	// Returns the 4 colors of one palette (0 - 3: background, 4 - 7: sprites), with grayscale and color emphasis applied
+	Span<const Color> getResolvedPalette(uint8_t palette);
 
 	// Returns the system palette
-	std::vector<Color> getSystemPalette();
+	Span<const Color> getSystemPalette();
+
+	// Load the system palette from a .pal file, only needed to get colors for rendering
+	bool loadPalette(std::string path);
 
 	// Get the amount of cycles that have occured in the current frame
 	uint32_t getCycles();
@@ -149,8 +197,28 @@ public:
 	// Return the total amount of frames that have finished rendering
 	uint32_t getFrameCount();
 
-	// Get the total amount of cycles that have occured since reset
-	uint32_t getTotalCycles();
+	// Get the total amount of cycles that have occured since power on
+	uint64_t getTotalCycles();
+
+	// Get the total cycle count at which the next frame starts
+	uint64_t getNextFrameCycle();
+
+	// Returns the last completely rendered frame
+	const Framebuffer &getFramebuffer() const;
+
+	// Set whether scanlines are drawn into the framebuffer. When disabled (frames that are skipped), only the work
+	// the game can observe is done: sprite evaluation, and the pixels sprite 0 hit depends on. Scanline 0 is always
+	// drawn, since it starts the next frame
+	void setPixelOutput(bool enabled);
+
+	// Returns the pattern table tiles that changed since the last call to clearDirtyChrTiles()
+	const ChrTileSet &getDirtyChrTiles() const;
+
+	// Mark all pattern table tiles as up to date
+	void clearDirtyChrTiles();
+
+	// Returns the pixels of a pattern table tile (0 - 511) as 8 rows of 8 color indices (0 - 3)
+	const uint8_t *getDecodedTile(uint16_t index);
 
 	// Returns whether an NMI has occured
 	bool getNmiOccured();
@@ -161,9 +229,14 @@ public:
 	// Sets the active mapper
 	void setMapper(IMapper *mapper);
 
+	// Save or load the video memory, internal registers, timing and rendered frames (if included). The memory
+	// mapped registers are saved by the bus
+	void serialize(StateSerializer &state);
+
 private:
 	// Cycle related stats
-	uint32_t cycles, scanlines, frames, totalCycles;
+	uint32_t cycles, scanlines, frames;
+	uint64_t totalCycles;
 
 	// PPU internal VRAM of 2 KiB ($800)
 	uint8_t *ciram;
@@ -179,17 +252,46 @@ private:
 
 	// System color palette
 	std::vector<Color> systemPalette;
-	
-	// Log PPU activities
-	Logger logger;
+
+	// Colors of the palette table, only resolved again after it changes, or the grayscale/emphasis bits change
+	std::array<Color, PALETTE_TABLE_SIZE> resolvedPalette;
+	bool resolvedPaletteDirty;
+	uint8_t resolvedPaletteMask;
 
 	// Other NES components
 	Bus &bus;
+	Scheduler &scheduler;
 	IMapper *mapper;
 
-	// Control the address that the CPU can access through PPUADDR/PPUDATA
-	uint16_t accessAddress;
-	bool accessAddressHighByte;
+	// Internal scroll registers ("loopy" registers): the current VRAM address (v) accessed through PPUDATA and
+	// used for rendering, the temporary VRAM address (t) written through PPUCTRL/PPUSCROLL/PPUADDR,
+	// the fine X scroll (x), and the first/second write toggle (w) shared by PPUSCROLL and PPUADDR
+	uint16_t vramAddress;
+	uint16_t tempAddress;
+	uint8_t fineX;
+	bool writeToggle;
+
+	// Frames are rendered into the back buffer, and the buffers are swapped once all visible scanlines are done
+	std::array<Framebuffer, 2> framebuffers;
+	uint8_t backBuffer;
+	bool pixelOutput;
+
+	// Pattern table tiles changed by CHR writes or bank switches
+	ChrTileSet dirtyChrTiles;
+
+	// Decoded pattern table tiles, used for rendering
+	TileCache tileCache;
+
+	// Sprites found on the current scanline by sprite evaluation, in OAM order
+	std::array<OamSprite, SPRITES_PER_SCANLINE> secondaryOam;
+	uint8_t secondaryOamCount;
+	bool spriteZeroOnScanline;
+
+	// Opaque pixels of sprite 0 on the current scanline, one bit per pixel starting at its X position
+	uint8_t spriteZeroOpaque;
+
+	// Cycle of the current scanline at which sprite 0 hit gets set, 0 if there is no hit
+	uint32_t spriteZeroHitCycle;
 
 	// Track when NMI has occured
 	bool nmiOccured;
@@ -200,12 +302,64 @@ private:
 	// If the PPU is currently being reset or not
 	bool isResetting;
 
+	// Get the total cycle count at which the given position within a frame is next emulated
+	uint64_t getNextCycleAt(uint32_t framePosition);
+
+	// Returns whether the background or sprites are being rendered
+	bool isRenderingEnabled();
+
+	// Get the first cycle of the current scanline after the given one that has work to do, or the end of the scanline.
+	// Work that is repeated on every cycle of a range (OAMADDR reset, vertical scroll copy) only needs its first cycle
+	uint32_t getNextWorkCycle(uint32_t cycle);
+
+	// Advance the cycle counters, without going past the end of the current scanline
+	void advanceCycles(uint32_t count);
+
+	// Render the current scanline into the back buffer
+	void renderScanline();
+
+	// Do only the rendering work of the current scanline that the game can observe
+	void evaluateScanline();
+
+	// Render the background of the current scanline, as palette RAM offsets (0 when transparent)
+	void renderBackground(uint8_t *pixels);
+
+	// Fill secondary OAM with the first 8 sprites on the current scanline, and set the sprite overflow flag
+	// when there are more
+	void evaluateSprites();
+
+	// Returns the OAM entries whose Y range covers the current scanline, as one bit per entry
+	uint64_t findScanlineSprites(uint8_t height);
+	uint64_t findScanlineSpritesScalar(uint8_t height);
+
+	// Render the first given amount of sprites in secondary OAM, as palette RAM offsets (0 when transparent)
+	void renderSprites(uint8_t *pixels, bool *behindBackground, uint8_t count);
+
+	// Set when sprite 0 hit happens on the current scanline, from the background pixels under sprite 0
+	void detectSpriteZeroHit(const uint8_t *background);
+
+	// Scroll register updates done while rendering
+	void incrementScrollX(uint16_t &address);
+	void incrementScrollY();
+	void copyScrollX();
+	void copyScrollY();
+
+	// Scheduled event callbacks
+	void onVblankStart(uint64_t time);
+	void onVblankEnd(uint64_t time);
+
+	// Resolve the colors of the palette table if they have changed
+	void resolvePalette();
+
+	// Mark the pattern table tiles overlapping the given CHR memory range as changed
+	void markChrChanged(uint16_t address, uint16_t size);
+
+	// Get the offset in palette RAM of a palette address
+	uint16_t mirrorPaletteAddress(uint16_t address);
+
 	// Mirror the nametable address according to the mapper
 	uint16_t mirrorNametableAddress(uint16_t address);
 
-	// Load the system palette
-	void loadPalette(std::string path);
-
 	// Called when one of the PPU's memory mapped registers is accessed
 	void onRegisterAccess(uint16_t address, uint8_t newValue, bool write);
 };
\ No newline at end of file
@@ -0,0 +1,410 @@
+#include "RewindBuffer.h"
+
+#include <cstdio>
+#include <cstring>
+
+// No keyframe decoded yet
+static constexpr uint64_t NO_KEYFRAME = UINT64_MAX;
+
+// Zero bytes in a row that end a literal run, shorter runs are cheaper to keep as literals
+static constexpr size_t MIN_ZERO_RUN = 4;
+
+// Most bytes a single run can count
+static constexpr size_t MAX_RUN = 0xFFFF;
+
+RewindBuffer::RewindBuffer(size_t capacity, uint32_t maxSnapshots)
+	: storage(capacity), entries(maxSnapshots), firstEntry(0), entryCount(0), writeOffset(0), usedBytes(0),
+	nextSequence(0), droppedSnapshots(0), keyframeSequence(NO_KEYFRAME), firstPending(0), pendingCount(0),
+	stopRequested(false)
+{
+	worker = std::thread(&RewindBuffer::workerMain, this);
+}
+
+RewindBuffer::~RewindBuffer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopRequested = true;
+	}
+
+	pendingChanged.notify_all();
+	worker.join();
+}
+
+bool RewindBuffer::capture(Console &console)
+{
+	uint32_t slot;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (pendingCount == PENDING_SNAPSHOTS)
+		{
+			droppedSnapshots++;
+			return false;
+		}
+
+		slot = (firstPending + pendingCount) % PENDING_SNAPSHOTS;
+	}
+
+	// The worker thread does not touch the slot until it is pending
+	console.saveState(snapshots[slot], false);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingCount++;
+	}
+
+	pendingChanged.notify_all();
+	return true;
+}
+
+bool RewindBuffer::rewind(Console &console)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		pendingChanged.wait(lock, [this]() { return pendingCount == 0; });
+
+		if (entryCount == 0)
+		{
+			return false;
+		}
+
+		if (!pop(restored))
+		{
+			printf("Error, rewind snapshot is corrupted, dropping it\n");
+			return false;
+		}
+	}
+
+	return console.loadState(restored);
+}
+
+void RewindBuffer::flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	pendingChanged.wait(lock, [this]() { return pendingCount == 0; });
+}
+
+void RewindBuffer::clear()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	pendingChanged.wait(lock, [this]() { return pendingCount == 0; });
+
+	firstEntry = 0;
+	entryCount = 0;
+	writeOffset = 0;
+	usedBytes = 0;
+}
+
+RewindBuffer::Stats RewindBuffer::getStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return { static_cast<uint32_t>(entryCount), usedBytes, storage.size(), droppedSnapshots };
+}
+
+void RewindBuffer::workerMain()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			pendingChanged.wait(lock, [this]() { return stopRequested || pendingCount > 0; });
+
+			if (stopRequested)
+			{
+				return;
+			}
+		}
+
+		Entry entry = compress(snapshots[firstPending]);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			push(entry);
+			firstPending = (firstPending + 1) % PENDING_SNAPSHOTS;
+			pendingCount--;
+		}
+
+		pendingChanged.notify_all();
+	}
+}
+
+RewindBuffer::Entry RewindBuffer::compress(const SaveState &snapshot)
+{
+	const std::vector<uint8_t> &raw = snapshot.getChunks();
+
+	Entry entry = {};
+	entry.header = snapshot.getHeader();
+	entry.rawSize = static_cast<uint32_t>(raw.size());
+	entry.sequence = nextSequence++;
+
+	if (encoded.size() < getMaxEncodedSize(raw.size()))
+	{
+		encoded.resize(getMaxEncodedSize(raw.size()));
+	}
+
+	// Snapshots are XORed against the keyframe of the newest one, so that only the bytes that changed since are left
+	if (entryCount > 0)
+	{
+		// A keyframe that fails to decode is not used, and this snapshot becomes a keyframe instead
+		const Entry &newest = getEntry(entryCount - 1);
+
+		if (loadKeyframe(entryCount - 1) && newest.sinceKeyframe + 1 < KEYFRAME_INTERVAL &&
+			keyframe.size() == raw.size())
+		{
+			delta.resize(raw.size());
+
+			for (size_t i = 0; i < raw.size(); i++)
+			{
+				delta[i] = raw[i] ^ keyframe[i];
+			}
+
+			entry.size = static_cast<uint32_t>(encode(delta.data(), delta.size(), encoded.data()));
+			entry.sinceKeyframe = newest.sinceKeyframe + 1;
+			entry.keyframeSequence = newest.keyframeSequence;
+			return entry;
+		}
+	}
+
+	entry.size = static_cast<uint32_t>(encode(raw.data(), raw.size(), encoded.data()));
+	entry.sinceKeyframe = 0;
+	entry.keyframeSequence = entry.sequence;
+
+	keyframe = raw;
+	keyframeSequence = entry.sequence;
+
+	return entry;
+}
+
+void RewindBuffer::push(const Entry &entry)
+{
+	if (entry.size > storage.size() || entries.empty())
+	{
+		droppedSnapshots++;
+		return;
+	}
+
+	if (entryCount == entries.size())
+	{
+		evictOldest();
+	}
+
+	// Entries past the write offset are the oldest ones, so they go first when wrapping around to the start
+	if (writeOffset + entry.size > storage.size())
+	{
+		while (entryCount > 0 && getEntry(0).offset >= writeOffset)
+		{
+			evictOldest();
+		}
+
+		writeOffset = 0;
+	}
+
+	evictRange(writeOffset, entry.size);
+
+	// Overwriting the oldest snapshots can evict the keyframe this one is XORed against
+	if (entry.sinceKeyframe != 0 && entryCount == 0)
+	{
+		droppedSnapshots++;
+		return;
+	}
+
+	memcpy(storage.data() + writeOffset, encoded.data(), entry.size);
+
+	entryCount++;
+	Entry &newest = getEntry(entryCount - 1);
+	newest = entry;
+	newest.offset = writeOffset;
+
+	writeOffset += entry.size;
+	usedBytes += entry.size;
+}
+
+bool RewindBuffer::pop(SaveState &snapshot)
+{
+	Entry &newest = getEntry(entryCount - 1);
+	std::vector<uint8_t> &chunks = snapshot.getChunks();
+	const uint8_t *data = storage.data() + newest.offset;
+
+	snapshot.getHeader() = newest.header;
+	chunks.resize(newest.rawSize);
+
+	bool decoded;
+	size_t removed = 1;
+
+	if (newest.sinceKeyframe == 0)
+	{
+		decoded = decode(data, newest.size, chunks.data(), chunks.size(), false);
+	}
+	else if (!loadKeyframe(entryCount - 1))
+	{
+		// Every snapshot XORed against a corrupted keyframe is lost along with it
+		decoded = false;
+		removed += newest.sinceKeyframe;
+	}
+	else
+	{
+		memcpy(chunks.data(), keyframe.data(), chunks.size());
+		decoded = decode(data, newest.size, chunks.data(), chunks.size(), true);
+	}
+
+	// The next snapshot is written where the oldest removed one was
+	for (size_t i = 0; i < removed; i++)
+	{
+		const Entry &entry = getEntry(entryCount - 1);
+		writeOffset = entry.offset;
+		usedBytes -= entry.size;
+		entryCount--;
+	}
+
+	return decoded;
+}
+
+bool RewindBuffer::loadKeyframe(size_t index)
+{
+	const Entry &entry = getEntry(index);
+
+	if (keyframeSequence == entry.keyframeSequence)
+	{
+		return true;
+	}
+
+	// The snapshots XORed against a keyframe directly follow it
+	const Entry &keyframeEntry = getEntry(index - entry.sinceKeyframe);
+
+	keyframe.resize(keyframeEntry.rawSize);
+
+	if (!decode(storage.data() + keyframeEntry.offset, keyframeEntry.size, keyframe.data(), keyframe.size(), false))
+	{
+		keyframeSequence = NO_KEYFRAME;
+		return false;
+	}
+
+	keyframeSequence = keyframeEntry.sequence;
+	return true;
+}
+
+RewindBuffer::Entry &RewindBuffer::getEntry(size_t index)
+{
+	return entries[(firstEntry + index) % entries.size()];
+}
+
+void RewindBuffer::evictOldest()
+{
+	do
+	{
+		usedBytes -= getEntry(0).size;
+		firstEntry = (firstEntry + 1) % entries.size();
+		entryCount--;
+	}
+	while (entryCount > 0 && getEntry(0).sinceKeyframe != 0);
+}
+
+void RewindBuffer::evictRange(size_t offset, size_t size)
+{
+	while (entryCount > 0)
+	{
+		const Entry &oldest = getEntry(0);
+
+		if (oldest.offset >= offset + size || oldest.offset + oldest.size <= offset)
+		{
+			return;
+		}
+
+		evictOldest();
+	}
+}
+
+size_t RewindBuffer::encode(const uint8_t *data, size_t size, uint8_t *output)
+{
+	size_t in = 0;
+	size_t out = 0;
+
+	while (in < size)
+	{
+		size_t zeros = 0;
+
+		while (in < size && data[in] == 0 && zeros < MAX_RUN)
+		{
+			in++;
+			zeros++;
+		}
+
+		// Literals go on until enough zero bytes in a row, or the end
+		size_t start = in;
+
+		while (in < size && in - start < MAX_RUN)
+		{
+			size_t run = 0;
+
+			while (run < MIN_ZERO_RUN && in + run < size && data[in + run] == 0)
+			{
+				run++;
+			}
+
+			if (run > 0 && (run == MIN_ZERO_RUN || in + run == size))
+			{
+				break;
+			}
+
+			in++;
+		}
+
+		uint16_t counts[2] = { static_cast<uint16_t>(zeros), static_cast<uint16_t>(in - start) };
+		memcpy(output + out, counts, sizeof(counts));
+		memcpy(output + out + sizeof(counts), data + start, in - start);
+		out += sizeof(counts) + in - start;
+	}
+
+	return out;
+}
+
+bool RewindBuffer::decode(const uint8_t *data, size_t size, uint8_t *output, size_t outputSize, bool xorOutput)
+{
+	size_t in = 0;
+	size_t out = 0;
+
+	while (in + 2 * sizeof(uint16_t) <= size)
+	{
+		uint16_t counts[2];
+		memcpy(counts, data + in, sizeof(counts));
+		in += sizeof(counts);
+
+		if (counts[0] + counts[1] > outputSize - out || counts[1] > size - in)
+		{
+			return false;
+		}
+
+		// XORed zeros leave the output as it is
+		if (!xorOutput)
+		{
+			memset(output + out, 0, counts[0]);
+		}
+
+		out += counts[0];
+
+		if (xorOutput)
+		{
+			for (uint16_t i = 0; i < counts[1]; i++)
+			{
+				output[out + i] ^= data[in + i];
+			}
+		}
+		else
+		{
+			memcpy(output + out, data + in, counts[1]);
+		}
+
+		in += counts[1];
+		out += counts[1];
+	}
+
+	return in == size && out == outputSize;
+}
+
+size_t RewindBuffer::getMaxEncodedSize(size_t size)
+{
+	// Every run but the last ends at MIN_ZERO_RUN zero bytes or MAX_RUN literal bytes, and takes 4 bytes of counts
+	return size + 2 * sizeof(uint16_t) * (size / MIN_ZERO_RUN + size / MAX_RUN + 2);
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Console.h"
+#include "SaveState.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// History of console snapshots for rewinding, in a fixed amount of memory. Snapshots are captured by the emulation
+// thread without their framebuffers, and compressed on a worker thread: every KEYFRAME_INTERVAL-th one is a keyframe,
+// the others are XORed against the last keyframe, and both are run-length encoded. Once full, the oldest snapshots
+// are overwritten
+class RewindBuffer
+{
+public:
+	// Snapshots in between keyframes
+	static constexpr uint32_t KEYFRAME_INTERVAL = 60;
+
+	// Captured snapshots that can wait for the worker thread, further captures are dropped until it catches up
+	static constexpr uint32_t PENDING_SNAPSHOTS = 8;
+
+	// Memory used by the history, as of the last capture or rewind
+	struct Stats
+	{
+		uint32_t snapshots;
+		size_t usedBytes;
+		size_t capacityBytes;
+		uint64_t droppedSnapshots;
+	};
+
+	// Allocate the given amount of bytes for compressed snapshots, holding at most the given amount of snapshots,
+	// and start the worker thread
+	RewindBuffer(size_t capacity, uint32_t maxSnapshots);
+
+	// Stops the worker thread
+	~RewindBuffer();
+
+	// Emulation thread: snapshot the console, to be compressed by the worker thread. Returns false if the snapshot
+	// was dropped because the worker thread is behind
+	bool capture(Console &console);
+
+	// Emulation thread: restore the console to the newest snapshot, and remove it from the history. Waits for the
+	// snapshots still being compressed. Returns false if the history is empty, or if the newest snapshot is corrupted,
+	// which drops it so that the next rewind goes further back
+	bool rewind(Console &console);
+
+	// Wait until every captured snapshot is compressed
+	void flush();
+
+	// Remove every snapshot
+	void clear();
+
+	// Returns how much of the history is used
+	Stats getStats();
+
+private:
+	// A compressed snapshot in the storage ring
+	struct Entry
+	{
+		SaveState::Header header;
+		size_t offset;
+		uint32_t size;
+		uint32_t rawSize;
+
+		// Snapshots since the keyframe this one is XORed against, 0 for keyframes
+		uint32_t sinceKeyframe;
+
+		// Increases with every snapshot, and the one of the keyframe XORed against
+		uint64_t sequence;
+		uint64_t keyframeSequence;
+	};
+
+	// Compressed snapshots, with the entries describing them in a ring from oldest to newest
+	std::vector<uint8_t> storage;
+	std::vector<Entry> entries;
+	size_t firstEntry;
+	size_t entryCount;
+	size_t writeOffset;
+	size_t usedBytes;
+	uint64_t nextSequence;
+	uint64_t droppedSnapshots;
+
+	// Decoded contents of a keyframe, used to encode and decode the snapshots XORed against it
+	std::vector<uint8_t> keyframe;
+	uint64_t keyframeSequence;
+
+	// Scratch memory of the worker thread, only growing when snapshots do
+	std::vector<uint8_t> delta;
+	std::vector<uint8_t> encoded;
+
+	// Snapshots captured by the emulation thread, as a ring compressed by the worker thread in order. A slot stays
+	// pending until it is compressed, and is only written by the emulation thread while it is not
+	std::array<SaveState, PENDING_SNAPSHOTS> snapshots;
+	uint32_t firstPending;
+	uint32_t pendingCount;
+
+	// Snapshot restored by rewind()
+	SaveState restored;
+
+	// Protects the entries and pending snapshots. The worker thread compresses without it, since the entries and
+	// decoded keyframe are only changed by others while no snapshot is pending
+	std::mutex mutex;
+	std::condition_variable pendingChanged;
+	bool stopRequested;
+	std::thread worker;
+
+	// Worker thread loop
+	void workerMain();
+
+	// Compress a snapshot into the encoded scratch memory, and returns its entry
+	Entry compress(const SaveState &snapshot);
+
+	// Add a compressed snapshot as the newest entry, overwriting the oldest ones if needed
+	void push(const Entry &entry);
+
+	// Decode the newest entry into a savestate, and remove it. Returns false if it is corrupted, in which case the
+	// snapshots XORed against a corrupted keyframe are removed as well
+	bool pop(SaveState &snapshot);
+
+	// Make the decoded keyframe the one the entry at the given age is XORed against. Returns false if the keyframe
+	// is corrupted
+	bool loadKeyframe(size_t index);
+
+	// Returns the entry at the given age, 0 being the oldest
+	Entry &getEntry(size_t index);
+
+	// Remove the oldest entry, along with the snapshots XORed against it
+	void evictOldest();
+
+	// Remove the oldest entries until the given range of the storage is free
+	void evictRange(size_t offset, size_t size);
+
+	// Run-length encode the given bytes, as pairs of a zero byte count and a literal byte count, each followed by
+	// the literal bytes. Returns the encoded size, the output must hold getMaxEncodedSize(size) bytes
+	static size_t encode(const uint8_t *data, size_t size, uint8_t *output);
+
+	// Decode run-length encoded bytes, XORed into the output instead of replacing it when xorOutput is set.
+	// Returns false if they do not decode to exactly the output size
+	static bool decode(const uint8_t *data, size_t size, uint8_t *output, size_t outputSize, bool xorOutput);
+
+	// Returns the most bytes encoding the given amount of bytes can take
+	static size_t getMaxEncodedSize(size_t size);
+};
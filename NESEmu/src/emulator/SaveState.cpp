@@ -0,0 +1,155 @@
+#include "SaveState.h"
+
+#include <cstring>
+
+SaveState::SaveState() : header()
+{
+
+}
+
+bool SaveState::isEmpty() const
+{
+	return chunks.empty();
+}
+
+void SaveState::clear()
+{
+	header = Header();
+	chunks.clear();
+}
+
+size_t SaveState::getSize() const
+{
+	return sizeof(Header) + chunks.size();
+}
+
+SaveState::Header &SaveState::getHeader()
+{
+	return header;
+}
+
+const SaveState::Header &SaveState::getHeader() const
+{
+	return header;
+}
+
+std::vector<uint8_t> &SaveState::getChunks()
+{
+	return chunks;
+}
+
+const std::vector<uint8_t> &SaveState::getChunks() const
+{
+	return chunks;
+}
+
+StateSerializer::StateSerializer(std::vector<uint8_t> &output, bool framebuffers)
+	: output(&output), position(0), chunkStart(0), chunkEnd(0), framebuffers(framebuffers), failed(false)
+{
+	output.clear();
+}
+
+StateSerializer::StateSerializer(Span<const uint8_t> input, bool framebuffers)
+	: output(nullptr), input(input), position(0), chunkStart(0), chunkEnd(0), framebuffers(framebuffers), failed(false)
+{
+
+}
+
+bool StateSerializer::isLoading() const
+{
+	return output == nullptr;
+}
+
+bool StateSerializer::hasFailed() const
+{
+	return failed;
+}
+
+bool StateSerializer::hasFramebuffers() const
+{
+	return framebuffers;
+}
+
+void StateSerializer::beginChunk(ChunkId id)
+{
+	ChunkHeader header = { static_cast<uint32_t>(id), 0 };
+
+	if (output)
+	{
+		// The size is filled in once the chunk ends
+		const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&header);
+		output->insert(output->end(), bytes, bytes + sizeof(header));
+		chunkStart = output->size();
+		return;
+	}
+
+	if (failed || input.size() - position < sizeof(header))
+	{
+		failed = true;
+		return;
+	}
+
+	memcpy(&header, input.data() + position, sizeof(header));
+	position += sizeof(header);
+
+	if (header.id != static_cast<uint32_t>(id) || header.size > input.size() - position)
+	{
+		failed = true;
+		return;
+	}
+
+	chunkStart = position;
+	chunkEnd = position + header.size;
+}
+
+void StateSerializer::endChunk()
+{
+	if (output)
+	{
+		uint32_t size = static_cast<uint32_t>(output->size() - chunkStart);
+		memcpy(output->data() + chunkStart - sizeof(uint32_t), &size, sizeof(size));
+		return;
+	}
+
+	// Every field of the chunk must have been visited, otherwise it was saved with different fields
+	if (position != chunkEnd)
+	{
+		failed = true;
+	}
+}
+
+bool StateSerializer::size(uint32_t &count, size_t elementSize)
+{
+	value(count);
+
+	if (isLoading() && (failed || count > (chunkEnd - position) / elementSize))
+	{
+		failed = true;
+	}
+
+	return !failed;
+}
+
+void StateSerializer::fail()
+{
+	failed = true;
+}
+
+void StateSerializer::bytes(void *data, size_t size)
+{
+	if (output)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t *>(data);
+		output->insert(output->end(), bytes, bytes + size);
+		return;
+	}
+
+	if (failed || size > chunkEnd - position)
+	{
+		failed = true;
+		return;
+	}
+
+	memcpy(data, input.data() + position, size);
+	position += size;
+}
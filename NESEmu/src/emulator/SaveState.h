@@ -0,0 +1,154 @@
+#pragma once
+
+#include "../util/Span.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Snapshot of every emulated component, in a versioned binary format: a header, followed by one chunk per
+// component. Each chunk starts with its ID and size, then holds the fields of the component as raw bytes.
+// The memory is kept between saves, so saving into the same savestate again does not allocate
+class SaveState
+{
+public:
+	// "NESS"
+	static constexpr uint32_t MAGIC = 0x5353454E;
+
+	// Bumped whenever the fields of any chunk change, since older savestates can not be loaded anymore
+	static constexpr uint32_t VERSION = 3;
+
+	// Header flags: set when the rendered frames are included, which rewind snapshots leave out to save space
+	static constexpr uint32_t FRAMEBUFFERS = 1 << 0;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+
+		// Hash of the ROM the savestate was made with, since it can only be loaded with the same ROM
+		uint64_t romHash;
+
+		// Frame the PPU was on when saving
+		uint32_t frame;
+
+		uint32_t flags;
+	};
+
+	SaveState();
+
+	// Returns whether nothing has been saved into the savestate yet
+	bool isEmpty() const;
+
+	// Remove the saved state, keeping its memory
+	void clear();
+
+	// Returns the total size of the savestate in bytes
+	size_t getSize() const;
+
+	Header &getHeader();
+	const Header &getHeader() const;
+
+	// All chunks, one after the other
+	std::vector<uint8_t> &getChunks();
+	const std::vector<uint8_t> &getChunks() const;
+
+private:
+	Header header;
+	std::vector<uint8_t> chunks;
+};
+
+// Passed to the serialize() function of every component, which visits its fields in the same order to either save
+// them into a savestate or load them back. Fields are copied as raw bytes, so only trivially copyable types can be
+// visited. Loading fails instead of reading past a chunk, or when a chunk does not match what is being loaded
+class StateSerializer
+{
+public:
+	// IDs of the chunks, as 4 characters
+	enum class ChunkId : uint32_t
+	{
+		Console = 0x534E4F43, // "CONS"
+		Scheduler = 0x44484353, // "SCHD"
+		Bus = 0x20535542, // "BUS "
+		CPU = 0x20555043, // "CPU "
+		PPU = 0x20555050, // "PPU "
+		Controller = 0x4C525443, // "CTRL"
+		Mapper = 0x5250414D // "MAPR"
+	};
+
+	// Save into the chunks of a savestate, replacing them
+	StateSerializer(std::vector<uint8_t> &output, bool framebuffers);
+
+	// Load from the chunks of a savestate
+	StateSerializer(Span<const uint8_t> input, bool framebuffers);
+
+	// Returns whether fields are being loaded, for components that need to update after loading
+	bool isLoading() const;
+
+	// Returns whether loading failed. Fields visited after a failure are left unchanged
+	bool hasFailed() const;
+
+	// Returns whether the rendered frames are visited
+	bool hasFramebuffers() const;
+
+	// Start and end the chunk of a component, all of its fields are visited in between
+	void beginChunk(ChunkId id);
+	void endChunk();
+
+	// Visit a single field
+	template <typename T>
+	void value(T &value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable fields can be serialized");
+		bytes(&value, sizeof(T));
+	}
+
+	// Visit a vector along with its size. Loading only allocates if the vector has to grow past its capacity
+	template <typename T>
+	void vector(std::vector<T> &values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable fields can be serialized");
+		uint32_t count = static_cast<uint32_t>(values.size());
+
+		if (!size(count, sizeof(T)))
+		{
+			return;
+		}
+
+		values.resize(count);
+		bytes(values.data(), count * sizeof(T));
+	}
+
+	// Visit the amount of elements of a container, before its elements are visited. Returns false if loading failed,
+	// or if that many elements of the given size can not fit in the rest of the chunk
+	bool size(uint32_t &count, size_t elementSize);
+
+	// Fail loading, for fields that were read but are not valid
+	void fail();
+
+	// Visit a block of memory
+	void bytes(void *data, size_t size);
+
+private:
+	// Chunk ID and size, before the fields of every chunk
+	struct ChunkHeader
+	{
+		uint32_t id;
+		uint32_t size;
+	};
+
+	// Set when saving
+	std::vector<uint8_t> *output;
+
+	// Set when loading
+	Span<const uint8_t> input;
+	size_t position;
+
+	// Start of the current chunk's fields, and end of them when loading
+	size_t chunkStart;
+	size_t chunkEnd;
+
+	bool framebuffers;
+	bool failed;
+};
@@ -0,0 +1,111 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+
+// Enough for every event type to have a few pending events without reallocating
+static constexpr size_t INITIAL_CAPACITY = 16;
+
+Scheduler::Scheduler() : nextEventTime(NO_EVENT), currentTime(0)
+{
+	events.reserve(INITIAL_CAPACITY);
+}
+
+void Scheduler::setCallback(EventType type, EventCallback callback)
+{
+	callbacks[static_cast<size_t>(type)] = callback;
+}
+
+void Scheduler::schedule(EventType type, uint64_t time)
+{
+	events.push_back({ time, type });
+	std::push_heap(events.begin(), events.end(), isLater);
+	nextEventTime = events.front().time;
+}
+
+void Scheduler::cancel(EventType type)
+{
+	events.erase(std::remove_if(events.begin(), events.end(),
+		[type](const Event &event) { return event.type == type; }), events.end());
+	std::make_heap(events.begin(), events.end(), isLater);
+	nextEventTime = events.empty() ? NO_EVENT : events.front().time;
+}
+
+void Scheduler::dispatch(uint64_t time)
+{
+	currentTime = time;
+
+	while (nextEventTime <= time)
+	{
+		std::pop_heap(events.begin(), events.end(), isLater);
+		Event event = events.back();
+		events.pop_back();
+		nextEventTime = events.empty() ? NO_EVENT : events.front().time;
+
+		// Callbacks may schedule new events, so the heap must be consistent before calling them
+		EventCallback &callback = callbacks[static_cast<size_t>(event.type)];
+
+		if (callback)
+		{
+			callback(event.time);
+		}
+	}
+}
+
+uint64_t Scheduler::getNextEventTime() const
+{
+	return nextEventTime;
+}
+
+uint64_t Scheduler::getCurrentTime() const
+{
+	return currentTime;
+}
+
+void Scheduler::serialize(StateSerializer &state)
+{
+	state.beginChunk(StateSerializer::ChunkId::Scheduler);
+
+	// Events are visited field by field, since copying them whole would save their padding bytes
+	uint32_t count = static_cast<uint32_t>(events.size());
+
+	if (state.size(count, sizeof(Event::time) + sizeof(Event::type)))
+	{
+		events.resize(count);
+
+		for (Event &event : events)
+		{
+			state.value(event.time);
+			state.value(event.type);
+
+			if (state.isLoading() && event.type >= EventType::COUNT)
+			{
+				state.fail();
+			}
+		}
+
+		// A partly loaded heap could dispatch events without a callback slot
+		if (state.hasFailed())
+		{
+			events.clear();
+		}
+	}
+
+	state.value(currentTime);
+	state.endChunk();
+
+	// Events are saved in heap order
+	if (state.isLoading())
+	{
+		nextEventTime = events.empty() ? NO_EVENT : events.front().time;
+	}
+}
+
+bool Scheduler::isLater(const Event &a, const Event &b)
+{
+	if (a.time != b.time)
+	{
+		return a.time > b.time;
+	}
+
+	return a.type > b.type;
+}
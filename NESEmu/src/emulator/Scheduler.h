@@ -0,0 +1,85 @@
+#pragma once
+
+#include "SaveState.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Keeps track of future events, ordered by their timestamp on the NES master clock.
+// Components run freely until the next event is due, instead of polling for it every cycle
+class Scheduler
+{
+public:
+	// Master clock dividers (NTSC): 1 CPU cycle = 12 master cycles, 1 PPU cycle = 4 master cycles
+	static constexpr uint64_t CPU_CLOCK_DIVIDER = 12;
+	static constexpr uint64_t PPU_CLOCK_DIVIDER = 4;
+
+	// Master clock frequency (NTSC): 21.477272 MHz
+	static constexpr double MASTER_CLOCK_HZ = 236250000.0 / 11.0;
+
+	// Timestamp used when no event is scheduled
+	static constexpr uint64_t NO_EVENT = UINT64_MAX;
+
+	// All types of events. Events due at the same time are dispatched in this order
+	enum class EventType : uint8_t
+	{
+		VblankStart,
+		VblankEnd,
+		OamDma,
+		Nmi,
+		Break,
+
+		COUNT
+	};
+
+	// Called with the timestamp the event was scheduled at
+	using EventCallback = std::function<void(uint64_t time)>;
+
+	// Initialize an empty event queue
+	Scheduler();
+
+	// Set the callback to dispatch for the given event type
+	void setCallback(EventType type, EventCallback callback);
+
+	// Schedule an event at the given master clock timestamp
+	void schedule(EventType type, uint64_t time);
+
+	// Remove all pending events of the given type
+	void cancel(EventType type);
+
+	// Dispatch every event due at or before the given timestamp, in order
+	void dispatch(uint64_t time);
+
+	// Returns the timestamp of the next pending event, or NO_EVENT if there is none
+	uint64_t getNextEventTime() const;
+
+	// Returns the timestamp that events are currently being dispatched at
+	uint64_t getCurrentTime() const;
+
+	// Save or load the pending events
+	void serialize(StateSerializer &state);
+
+private:
+	struct Event
+	{
+		uint64_t time;
+		EventType type;
+	};
+
+	// Min-heap of pending events
+	std::vector<Event> events;
+
+	// Callback for each event type
+	std::array<EventCallback, static_cast<size_t>(EventType::COUNT)> callbacks;
+
+	// Cached timestamp of the earliest event
+	uint64_t nextEventTime;
+
+	// Timestamp of the last dispatch
+	uint64_t currentTime;
+
+	// Heap ordering: earliest time first, then by event type
+	static bool isLater(const Event &a, const Event &b);
+};
@@ -0,0 +1,126 @@
+#include "TileCache.h"
+
+#include "../util/Simd.h"
+
+#include <cstring>
+
+// Each bit of a byte spread out to its own byte, most significant bit first, as pixels are stored left to right
+struct SpreadTable
+{
+	uint64_t rows[256];
+
+	SpreadTable()
+	{
+		for (uint32_t value = 0; value < 256; value++)
+		{
+			uint8_t bytes[8];
+
+			for (uint8_t bit = 0; bit < 8; bit++)
+			{
+				bytes[bit] = (value >> (7 - bit)) & 1;
+			}
+
+			memcpy(&rows[value], bytes, sizeof(bytes));
+		}
+	}
+};
+
+static const SpreadTable SPREAD_TABLE;
+
+TileCache::TileCache() : mapper(nullptr), tiles()
+{
+	stale.set();
+}
+
+void TileCache::setMapper(IMapper *mapper)
+{
+	this->mapper = mapper;
+	stale.set();
+}
+
+void TileCache::invalidate(uint16_t address, uint16_t size)
+{
+	if (size == 0 || address >= TILE_COUNT * TILE_BYTES)
+	{
+		return;
+	}
+
+	uint32_t first = address / TILE_BYTES;
+	uint32_t last = (static_cast<uint32_t>(address) + size - 1) / TILE_BYTES;
+
+	for (uint32_t tile = first; tile <= last && tile < TILE_COUNT; tile++)
+	{
+		stale.set(tile);
+	}
+}
+
+void TileCache::decode(uint16_t index)
+{
+	uint8_t planes[TILE_BYTES] = { 0 };
+
+	if (mapper != nullptr)
+	{
+		for (uint16_t i = 0; i < TILE_BYTES; i++)
+		{
+			planes[i] = mapper->chrRead(index * TILE_BYTES + i);
+		}
+	}
+
+	decodeTile(planes, tiles[index].data());
+	stale.reset(index);
+}
+
+void TileCache::decodeTile(const uint8_t *planes, uint8_t *pixels)
+{
+	for (uint8_t row = 0; row < 8; row++)
+	{
+		// Pixel bytes are 0 or 1, so shifting the high plane cannot carry into the next pixel
+		uint64_t rowPixels = SPREAD_TABLE.rows[planes[row]] | (SPREAD_TABLE.rows[planes[row + 8]] << 1);
+		memcpy(pixels + row * 8, &rowPixels, sizeof(rowPixels));
+	}
+}
+
+void TileCache::decodeTileSimd(const uint8_t *planes, uint8_t *pixels)
+{
+#ifdef NESEMU_SSE2
+	// Bit of each pixel within its row byte, for 2 rows at a time
+	const __m128i bitMask = _mm_setr_epi8(
+		(char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+		(char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i one = _mm_set1_epi8(1);
+
+	// Low plane in the first 8 bytes, high plane in the last 8. Each row byte is repeated 8 times, 2 rows per register
+	__m128i both = _mm_loadu_si128(reinterpret_cast<const __m128i *>(planes));
+	__m128i low2 = _mm_unpacklo_epi8(both, both);
+	__m128i high2 = _mm_unpackhi_epi8(both, both);
+	__m128i low4[] = { _mm_unpacklo_epi16(low2, low2), _mm_unpackhi_epi16(low2, low2) };
+	__m128i high4[] = { _mm_unpacklo_epi16(high2, high2), _mm_unpackhi_epi16(high2, high2) };
+
+	for (int half = 0; half < 2; half++)
+	{
+		__m128i lowRows[] = { _mm_unpacklo_epi32(low4[half], low4[half]), _mm_unpackhi_epi32(low4[half], low4[half]) };
+		__m128i highRows[] = { _mm_unpacklo_epi32(high4[half], high4[half]), _mm_unpackhi_epi32(high4[half], high4[half]) };
+
+		for (int pair = 0; pair < 2; pair++)
+		{
+			// Each pixel is 1 if its bit is set in the low plane, plus 2 if set in the high plane
+			__m128i lowBits = _mm_min_epu8(_mm_and_si128(lowRows[pair], bitMask), one);
+			__m128i highBits = _mm_min_epu8(_mm_and_si128(highRows[pair], bitMask), one);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + (half * 2 + pair) * 16),
+				_mm_add_epi8(lowBits, _mm_add_epi8(highBits, highBits)));
+		}
+	}
+#else
+	decodeTile(planes, pixels);
+#endif
+}
+
+bool TileCache::hasSimd()
+{
+#ifdef NESEMU_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "IMapper.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+// Pattern table tiles of the currently mapped CHR memory ($0000 - $1FFF), decoded from 2 bit planes to one
+// color index (0 - 3) per byte. Tiles are decoded on first use, and decoded again only once marked as changed
+class TileCache
+{
+public:
+	// 512 tiles of 16 bytes, each decoding to 8x8 pixels
+	static constexpr uint16_t TILE_COUNT = 512;
+	static constexpr uint16_t TILE_BYTES = 16;
+	static constexpr uint16_t TILE_PIXELS = 64;
+
+	using Tile = std::array<uint8_t, TILE_PIXELS>;
+
+	TileCache();
+
+	// Set the mapper CHR memory is read from, marking every tile as changed
+	void setMapper(IMapper *mapper);
+
+	// Mark the tiles overlapping the given CHR memory range as changed
+	void invalidate(uint16_t address, uint16_t size);
+
+	// Returns the decoded pixels of a tile (0 - 511), as 8 rows of 8 color indices
+	const uint8_t *getTile(uint16_t index)
+	{
+		if (stale.test(index))
+		{
+			decode(index);
+		}
+
+		return tiles[index].data();
+	}
+
+	// Decode a tile from its 16 bytes of bit planes into 64 color indices, with lookup tables. Used for every tile,
+	// since it measures faster than the SIMD version with --bench-tiles
+	static void decodeTile(const uint8_t *planes, uint8_t *pixels);
+
+	// Decode a tile with SIMD instructions when available, otherwise the same as decodeTile
+	static void decodeTileSimd(const uint8_t *planes, uint8_t *pixels);
+
+	// Returns whether decodeTileSimd uses SIMD instructions
+	static bool hasSimd();
+
+private:
+	IMapper *mapper;
+	std::array<Tile, TILE_COUNT> tiles;
+
+	// Tiles that need to be decoded again before use
+	std::bitset<TILE_COUNT> stale;
+
+	// Read the tile from CHR memory and decode it
+	void decode(uint16_t index);
+};
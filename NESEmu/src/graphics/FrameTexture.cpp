@@ -0,0 +1,142 @@
+#include "FrameTexture.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+FrameTexture::FrameTexture(Shader *shader) : shader(shader), textureId(0), vaoId(0), vboId(0), eboId(0)
+{
+
+}
+
+FrameTexture::~FrameTexture()
+{
+	if (textureId != 0)
+	{
+		glDeleteBuffers(1, &eboId);
+		glDeleteBuffers(1, &vboId);
+		glDeleteVertexArrays(1, &vaoId);
+		glDeleteTextures(1, &textureId);
+	}
+}
+
+void FrameTexture::load()
+{
+	// Create buffers. The quad never changes, so it is only uploaded once
+	glGenBuffers(1, &vboId);
+	glGenBuffers(1, &eboId);
+	glGenVertexArrays(1, &vaoId);
+
+	assert(vboId != 0);
+	assert(eboId != 0);
+	assert(vaoId != 0);
+	GL_ERROR_CHECK();
+
+	float vertices[] =
+	{
+		// Position				// Texture coords
+		1.0f, 1.0f, 0.0f,		1.0f, 1.0f,	// bottom right
+		1.0f, 0.0f, 0.0f,		1.0f, 0.0f,	// top right
+		0.0f, 0.0f, 0.0f,		0.0f, 0.0f,	// top left
+		0.0f, 1.0f, 0.0f,		0.0f, 1.0f,	// bottom left
+	};
+
+	unsigned int indices[] =
+	{
+		0, 1, 3, // First triangle
+		1, 2, 3 // Second triangle
+	};
+
+	glBindVertexArray(vaoId);
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboId);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+
+	GL_ERROR_CHECK();
+
+	// Create OpenGL texture identifier
+	glGenTextures(1, &textureId);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+
+	// Indices must not be filtered, since blending them would give unrelated colors
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, PPU::SCREEN_WIDTH, PPU::SCREEN_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GL_ERROR_CHECK();
+}
+
+void FrameTexture::update(const PPU::Framebuffer &framebuffer)
+{
+	glBindTexture(GL_TEXTURE_2D, textureId);
+
+	// Rows are 256 bytes, so they are always aligned
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PPU::SCREEN_WIDTH, PPU::SCREEN_HEIGHT, GL_RED, GL_UNSIGNED_BYTE,
+		framebuffer.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GL_ERROR_CHECK();
+}
+
+void FrameTexture::draw(glm::vec2 pos, glm::vec2 size, Span<const PPU::Color> systemPalette)
+{
+	// The system palette only changes when a palette file is loaded
+	if (palette.size() != systemPalette.size() * 4)
+	{
+		palette.clear();
+
+		for (const PPU::Color &color : systemPalette)
+		{
+			palette.push_back(color.r / 255.0f);
+			palette.push_back(color.g / 255.0f);
+			palette.push_back(color.b / 255.0f);
+			palette.push_back(1.0f);
+		}
+	}
+
+	if (palette.empty())
+	{
+		return;
+	}
+
+	shader->use();
+
+	glm::mat4 model = glm::mat4(1.0f);
+	model = glm::translate(model, glm::vec3(pos, 0.0f));
+	model = glm::scale(model, glm::vec3(size.x, size.y, 1.0f));
+	// TODO: Update projection matrix when window is changed
+	glm::mat4 projection = glm::ortho<float>(0.0f, 1280.0f, 720.0f, 0.0f, -10.0f, 10.0f);
+
+	shader->setVector4f("palette", palette);
+	shader->setMatrix4f("model", model);
+	shader->setMatrix4f("projection", projection);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glBindVertexArray(vaoId);
+
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	shader->abandon();
+
+	GL_ERROR_CHECK();
+}
+
+GLuint FrameTexture::getId()
+{
+	return textureId;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Shader.h"
+#include "../emulator/PPU.h"
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Texture holding a frame rendered by the PPU, as system palette indices. Colors are looked up in the shader,
+// so a frame is uploaded as a single 1 byte per pixel image
+class FrameTexture
+{
+public:
+	FrameTexture(Shader *shader);
+	~FrameTexture();
+
+	// Create the texture and buffers
+	void load();
+
+	// Upload a finished frame
+	void update(const PPU::Framebuffer &framebuffer);
+
+	// Draw the frame with the given system palette
+	void draw(glm::vec2 pos, glm::vec2 size, Span<const PPU::Color> systemPalette);
+
+	GLuint getId();
+
+private:
+	Shader *shader;
+	GLuint textureId;
+	GLuint vaoId, vboId, eboId;
+
+	// System palette, normalized to floats for the shader
+	std::vector<float> palette;
+};
@@ -14,4 +14,7 @@ public:
 
 	// Whether the component should be drawn (only valid if isActive() == true)
 	virtual bool isVisible() = 0;
+
+	// Whether drawing reads the live console state, which keeps the console locked while the component is drawn
+	virtual bool inspectsConsole() { return false; }
 };
\ No newline at end of file
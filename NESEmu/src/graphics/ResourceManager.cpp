@@ -3,8 +3,15 @@
 using std::unordered_map;
 using std::string;
 
-unordered_map<string, Shader*> ResourceManager::shaders;
-unordered_map<string, Texture*> ResourceManager::textures;
+ResourceManager::ResourceManager()
+{
+
+}
+
+ResourceManager::~ResourceManager()
+{
+	clear();
+}
 
 bool ResourceManager::loadShader(string name, string fragmentPath, string vertexPath)
 {
@@ -65,4 +72,21 @@ Texture *ResourceManager::getTexture(string name)
 	}
 
 	return it->second;
-}
\ No newline at end of file
+}
+
+void ResourceManager::clear()
+{
+	// Textures reference their shader, so they go first
+	for (auto &pair : textures)
+	{
+		delete pair.second;
+	}
+
+	for (auto &pair : shaders)
+	{
+		delete pair.second;
+	}
+
+	textures.clear();
+	shaders.clear();
+}
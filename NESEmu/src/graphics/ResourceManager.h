@@ -6,16 +6,25 @@
 #include <unordered_map>
 #include <string>
 
+// Shaders and textures of a window, by name. Owned by the front-end, so that each window has its own
 class ResourceManager
 {
 public:
-	static bool loadShader(std::string name, std::string fragmentPath, std::string vertexPath);
-	static bool loadTexture(std::string name, std::string shaderName, int width, int height);
+	ResourceManager();
 
-	static Shader *getShader(std::string name);
-	static Texture *getTexture(std::string name);
+	// Deletes any resources left, clear() must be called first if the GL context is destroyed before
+	~ResourceManager();
+
+	bool loadShader(std::string name, std::string fragmentPath, std::string vertexPath);
+	bool loadTexture(std::string name, std::string shaderName, int width, int height);
+
+	Shader *getShader(std::string name);
+	Texture *getTexture(std::string name);
+
+	// Delete every resource, while the GL context is still current
+	void clear();
 
 private:
-	static std::unordered_map<std::string, Shader*> shaders;
-	static std::unordered_map<std::string, Texture*> textures;
-};
\ No newline at end of file
+	std::unordered_map<std::string, Shader*> shaders;
+	std::unordered_map<std::string, Texture*> textures;
+};
@@ -5,7 +5,6 @@
 #include <assert.h>
 
 using std::string;
-using std::vector;
 
 void Shader::abandon()
 {
@@ -62,41 +61,56 @@ GLuint Shader::getId()
 	return program;
 }
 
-GLint Shader::getUniformLocation(string name)
+GLint Shader::getUniformLocation(const string &name)
 {
+	auto it = uniformLocations.find(name);
+
+	if (it != uniformLocations.end())
+	{
+		return it->second;
+	}
+
 	GLint location = glGetUniformLocation(program, name.c_str());
 	
 	assert(location >= 0);
 	GL_ERROR_CHECK();
+
+	uniformLocations.insert({ name, location });
 	
 	return location;
 }
 
-void Shader::setVector3f(string name, const glm::vec3 &vec)
+void Shader::setVector2f(const string &name, const glm::vec2 &vec)
+{
+	glUniform2f(getUniformLocation(name), vec.x, vec.y);
+	GL_ERROR_CHECK();
+}
+
+void Shader::setVector3f(const string &name, const glm::vec3 &vec)
 {
 	glUniform3f(getUniformLocation(name), vec.x, vec.y, vec.z);
 	GL_ERROR_CHECK();
 }
 
-void Shader::setVector3f(string name, vector<GLfloat> &vec)
+void Shader::setVector3f(const string &name, Span<const GLfloat> vec)
 {
-	glUniform3fv(getUniformLocation(name), vec.size(), &vec[0]);
+	glUniform3fv(getUniformLocation(name), vec.size() / 3, vec.data());
 	GL_ERROR_CHECK();
 }
 
-void Shader::setVector4f(string name, const glm::vec4 &vec)
+void Shader::setVector4f(const string &name, const glm::vec4 &vec)
 {
 	glUniform4f(getUniformLocation(name), vec.x, vec.y, vec.z, vec.w);
 	GL_ERROR_CHECK();
 }
 
-void Shader::setVector4f(string name, vector<GLfloat> &vec)
+void Shader::setVector4f(const string &name, Span<const GLfloat> vec)
 {
-	glUniform4fv(getUniformLocation(name), vec.size(), &vec[0]);
+	glUniform4fv(getUniformLocation(name), vec.size() / 4, vec.data());
 	GL_ERROR_CHECK();
 }
 
-void Shader::setMatrix4f(string name, const glm::mat4 &matrix)
+void Shader::setMatrix4f(const string &name, const glm::mat4 &matrix)
 {
 	glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
 	GL_ERROR_CHECK();
@@ -1,9 +1,10 @@
 #pragma once
 
 #include "Graphics.h"
+#include "../util/Span.h"
 
 #include <string>
-#include <vector>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
 class Shader
@@ -17,16 +18,20 @@ public:
 	void load(std::string fragmentPath, std::string vertexPath);
 	void use();
 	GLuint getId();
-	GLint getUniformLocation(std::string name);
+	GLint getUniformLocation(const std::string &name);
 
-	void setVector3f(std::string name, const glm::vec3 &vec);
-	void setVector3f(std::string name, std::vector<GLfloat> &vec);
-	void setVector4f(std::string name, const glm::vec4 &vec);
-	void setVector4f(std::string name, std::vector<GLfloat> &vec);
-	void setMatrix4f(std::string name, const glm::mat4 &matrix);
+	void setVector2f(const std::string &name, const glm::vec2 &vec);
+	void setVector3f(const std::string &name, const glm::vec3 &vec);
+	void setVector3f(const std::string &name, Span<const GLfloat> vec);
+	void setVector4f(const std::string &name, const glm::vec4 &vec);
+	void setVector4f(const std::string &name, Span<const GLfloat> vec);
+	void setMatrix4f(const std::string &name, const glm::mat4 &matrix);
 
 private:
 	GLuint program;
 
+	// Uniform locations never change once linked, so they are only looked up once
+	std::unordered_map<std::string, GLint> uniformLocations;
+
 	GLuint compile(GLuint type, std::string path);
 };
\ No newline at end of file
@@ -1,28 +1,12 @@
 #include "Texture.h"
 
+#include <array>
 #include <iostream>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 using std::vector;
 
-static vector<float> normalizePalette(vector<PPU::Color> palette);
-
-vector<float> normalizePalette(vector<PPU::Color> palette)
-{
-	vector<float> normalized;
-
-	for (auto color : palette)
-	{
-		normalized.push_back(color.r / 255.0f);
-		normalized.push_back(color.g / 255.0f);
-		normalized.push_back(color.b / 255.0f);
-		normalized.push_back(color.a / 255.0f);
-	}
-
-	return normalized;
-}
-
 Texture::Texture(Shader *shader, int width, int height) : 
 	shader(shader), textureId(0), vaoId(0), vboId(0), eboId(0), width(width), height(height)
 {
@@ -76,11 +60,15 @@ void Texture::load(PPU &ppu, uint16_t baseAddress)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+	// Pixels are a single channel, shown as gray when drawn by ImGui
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+
 	// Upload pixels into texture
 #if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
 	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 #endif
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -96,7 +84,38 @@ void Texture::update(PPU &ppu, uint16_t baseAddress)
 #if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
 	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 #endif
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GL_ERROR_CHECK();
+}
+
+void Texture::updateTiles(Span<const TileCache::Tile> decodedTiles, uint16_t baseAddress, const PPU::ChrTileSet &tiles)
+{
+	uint16_t tilesPerRow = width / PPU::TILE_SIZE;
+	uint16_t tileCount = tilesPerRow * (height / PPU::TILE_SIZE);
+	uint16_t firstTile = baseAddress / PPU::CHR_TILE_BYTES;
+	uint8_t pixels[PPU::TILE_SIZE * PPU::TILE_SIZE];
+
+	glBindTexture(GL_TEXTURE_2D, textureId);
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+
+	for (uint16_t tile = 0; tile < tileCount && firstTile + tile < PPU::CHR_TILE_COUNT; tile++)
+	{
+		if (!tiles.test(firstTile + tile))
+		{
+			continue;
+		}
+
+		decodeTile(decodedTiles[firstTile + tile].data(), pixels, PPU::TILE_SIZE);
+
+		int x = (tile % tilesPerRow) * PPU::TILE_SIZE;
+		int y = (tile / tilesPerRow) * PPU::TILE_SIZE;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, PPU::TILE_SIZE, PPU::TILE_SIZE, GL_RED, GL_UNSIGNED_BYTE, pixels);
+	}
+
 	glBindTexture(GL_TEXTURE_2D, 0);
 
 	GL_ERROR_CHECK();
@@ -104,7 +123,7 @@ void Texture::update(PPU &ppu, uint16_t baseAddress)
 
 void Texture::draw(glm::vec2 pos, glm::vec2 size)
 {
-	vector<PPU::Color> palette(4);
+	std::array<PPU::Color, 4> palette = {};
 	//draw(pos, size, glm::vec2(0, 0), glm::vec2(width, height), palette);
 	draw(glm::vec3(pos, 0.0f), size, glm::vec2(0.0f), glm::vec2(width, height), palette, glm::vec4(1.0f));
 }
@@ -116,7 +135,7 @@ void Texture::draw(glm::vec2 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2
 }
 */
 
-void Texture::draw(glm::vec3 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2 uvBottomRight, vector<PPU::Color> palette, glm::vec4 color)
+void Texture::draw(glm::vec3 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2 uvBottomRight, Span<const PPU::Color> palette, glm::vec4 color)
 {
 	assert(palette.size() == 4);
 
@@ -129,9 +148,16 @@ void Texture::draw(glm::vec3 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2
 	// TODO: Update projection matrix when window is changed
 	glm::mat4 projection = glm::ortho<float>(0.0f, 1280.0f, 720.0f, 0.0f, -10.0f, 10.0f);
 
-	// TODO: Cache normalized float palette
-	vector<float> normalizedPalette = normalizePalette(palette);
-	assert(normalizedPalette.size() == palette.size() * 4);
+	// Palette colors normalized to floats, 4 per color
+	std::array<float, 16> normalizedPalette;
+
+	for (size_t i = 0; i < palette.size(); i++)
+	{
+		normalizedPalette[i * 4 + 0] = palette[i].r / 255.0f;
+		normalizedPalette[i * 4 + 1] = palette[i].g / 255.0f;
+		normalizedPalette[i * 4 + 2] = palette[i].b / 255.0f;
+		normalizedPalette[i * 4 + 3] = palette[i].a / 255.0f;
+	}
 
 	shader->setVector4f("colorModifier", color);
 	shader->setVector4f("palette", normalizedPalette);
@@ -219,36 +245,30 @@ int Texture::getHeight()
 
 vector<uint8_t> Texture::getPixelData(PPU &ppu, uint16_t baseAddress)
 {
-	vector<uint8_t> pixels;
-	pixels.reserve(128 * 128 * 3);
+	vector<uint8_t> pixels(width * height);
+	uint16_t tilesPerRow = width / PPU::TILE_SIZE;
+	uint16_t tileCount = tilesPerRow * (height / PPU::TILE_SIZE);
+	uint16_t firstTile = baseAddress / PPU::CHR_TILE_BYTES;
 
+	for (uint16_t tile = 0; tile < tileCount; tile++)
+	{
+		int x = (tile % tilesPerRow) * PPU::TILE_SIZE;
+		int y = (tile / tilesPerRow) * PPU::TILE_SIZE;
+		decodeTile(ppu.getDecodedTile(firstTile + tile), &pixels[y * width + x], width);
+	}
+
+	return pixels;
+}
+
+void Texture::decodeTile(const uint8_t *decoded, uint8_t *pixels, int stride)
+{
 	uint8_t colors[] = { 0, 51, 102, 153 }; // { 0.0, 0.2, 0.4, 0.6 } * 255
 
-	for (uint8_t r = 0; r < 128; r++)
+	for (uint8_t row = 0; row < PPU::TILE_SIZE; row++)
 	{
-		for (uint8_t c = 0; c < 128; c++)
+		for (uint8_t col = 0; col < PPU::TILE_SIZE; col++)
 		{
-			uint16_t patternIndex = 16 * (r / 8) + c / 8; // Which pattern index to use
-			uint16_t byteIndex = r % 8; // Which byte of the pattern (row of pixels)
-			uint8_t bitIndex = 7 - c % 8; // The bit (pixel) to use in the current byte
-
-			uint16_t address = baseAddress | (patternIndex << 4) | byteIndex;
-			uint8_t loByte = ppu.readMemory(address);
-			uint8_t hiByte = ppu.readMemory(address + 8);
-			uint8_t mask = 1 << bitIndex;
-
-			// Account for the edge case where bitIndex == 0, and the high bit needs to be shifted
-			// 1 to the left so that it doesn't occupy the same place as the low bit
-			uint8_t hiBit = bitIndex == 0 ?
-							((hiByte & mask) << 1) :
-							((hiByte & mask) >> (bitIndex - 1));
-			uint8_t bit = hiBit | ((loByte & mask) >> bitIndex);
-
-			pixels.push_back(colors[bit]);
-			pixels.push_back(colors[bit]);
-			pixels.push_back(colors[bit]);
+			pixels[row * stride + col] = colors[decoded[row * PPU::TILE_SIZE + col]];
 		}
 	}
-
-	return pixels;
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 #include "Graphics.h"
 #include "Shader.h"
 #include "../emulator/PPU.h"
+#include "../util/Span.h"
 
 #include <cstdint>
 #include <vector>
@@ -17,10 +18,14 @@ public:
 
 	void load(PPU& ppu, uint16_t baseAddress);
 	void update(PPU &ppu, uint16_t baseAddress);
+
+	// Upload only the tiles of the pattern table at the base address that are marked in the set, from a copy of all
+	// decoded tiles so that the console does not need to be locked
+	void updateTiles(Span<const TileCache::Tile> decodedTiles, uint16_t baseAddress, const PPU::ChrTileSet &tiles);
 	void draw(glm::vec2 pos, glm::vec2 size);
 	//void draw(glm::vec2 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2 uvBottomRight, std::vector<PPU::Color> palette);
 	void draw(glm::vec3 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2 uvBottomRight,
-		std::vector<PPU::Color> palette, glm::vec4 color = glm::vec4(1.0f));
+		Span<const PPU::Color> palette, glm::vec4 color = glm::vec4(1.0f));
 
 	void drawGui(ImVec2 size);
 	void drawGui(ImVec2 size, ImVec2 texPosTopLeft, ImVec2 texPosBottomRight);
@@ -36,4 +41,7 @@ private:
 	int width, height;
 
 	std::vector<uint8_t> getPixelData(PPU &ppu, uint16_t baseAddress);
+
+	// Copy one decoded 8x8 tile into pixels, with a row stride of the given amount of pixels
+	void decodeTile(const uint8_t *decoded, uint8_t *pixels, int stride);
 };
\ No newline at end of file
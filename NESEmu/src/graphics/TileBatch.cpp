@@ -0,0 +1,137 @@
+#include "TileBatch.h"
+
+#include <cstddef>
+#include <glm/gtc/matrix_transform.hpp>
+
+TileBatch::TileBatch(Shader *shader) : shader(shader), vaoId(0), quadVboId(0), instanceVboId(0)
+{
+	instances.reserve(MAX_TILES);
+	palettes.resize(PALETTE_COUNT * PALETTE_SIZE * 4, 0.0f);
+}
+
+TileBatch::~TileBatch()
+{
+	if (vaoId != 0)
+	{
+		glDeleteBuffers(1, &instanceVboId);
+		glDeleteBuffers(1, &quadVboId);
+		glDeleteVertexArrays(1, &vaoId);
+	}
+}
+
+void TileBatch::load()
+{
+	glGenVertexArrays(1, &vaoId);
+	glGenBuffers(1, &quadVboId);
+	glGenBuffers(1, &instanceVboId);
+
+	assert(vaoId != 0);
+	assert(quadVboId != 0);
+	assert(instanceVboId != 0);
+	GL_ERROR_CHECK();
+
+	// Unit quad shared by every tile, as a triangle strip
+	float quad[] =
+	{
+		0.0f, 0.0f,
+		1.0f, 0.0f,
+		0.0f, 1.0f,
+		1.0f, 1.0f,
+	};
+
+	glBindVertexArray(vaoId);
+
+	glBindBuffer(GL_ARRAY_BUFFER, quadVboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+	glEnableVertexAttribArray(0);
+
+	// Instance buffer is allocated once, and only its contents are updated
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVboId);
+	glBufferData(GL_ARRAY_BUFFER, MAX_TILES * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+
+	// Position, size, texture coordinates, palette
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, x));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, width));
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, u0));
+	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *)offsetof(Instance, palette));
+
+	for (GLuint attribute = 1; attribute <= 4; attribute++)
+	{
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribDivisor(attribute, 1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GL_ERROR_CHECK();
+}
+
+void TileBatch::setPalettes(Span<const PPU::Color> colors)
+{
+	assert(colors.size() == PALETTE_COUNT * PALETTE_SIZE);
+
+	for (size_t i = 0; i < colors.size(); i++)
+	{
+		palettes[i * 4 + 0] = colors[i].r / 255.0f;
+		palettes[i * 4 + 1] = colors[i].g / 255.0f;
+		palettes[i * 4 + 2] = colors[i].b / 255.0f;
+		palettes[i * 4 + 3] = colors[i].a / 255.0f;
+	}
+}
+
+void TileBatch::add(glm::vec3 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2 uvBottomRight, uint8_t palette)
+{
+	if (instances.size() >= MAX_TILES)
+	{
+		return;
+	}
+
+	instances.push_back({ pos.x, pos.y, pos.z, size.x, size.y, uvTopLeft.x, uvTopLeft.y, uvBottomRight.x,
+		uvBottomRight.y, static_cast<float>(palette) });
+}
+
+void TileBatch::draw(Texture *patternTable)
+{
+	if (instances.empty())
+	{
+		return;
+	}
+
+	shader->use();
+
+	// TODO: Update projection matrix when window is changed
+	glm::mat4 projection = glm::ortho<float>(0.0f, 1280.0f, 720.0f, 0.0f, -10.0f, 10.0f);
+	glm::vec2 textureSize(patternTable->getWidth(), patternTable->getHeight());
+
+	shader->setMatrix4f("projection", projection);
+	shader->setVector2f("textureSize", textureSize);
+	shader->setVector4f("palettes", palettes);
+
+	// Enable texture alpha, depth test
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, patternTable->getId());
+	glBindVertexArray(vaoId);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVboId);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(Instance), instances.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances.size()));
+
+	// Unbind, disable, and cleanup
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+
+	shader->abandon();
+	instances.clear();
+
+	GL_ERROR_CHECK();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Graphics.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "../emulator/PPU.h"
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Draws many pattern table tiles with a single instanced draw call. Tiles are queued with add(), and drawn
+// all at once by draw(), each using one of the palettes set with setPalettes()
+class TileBatch
+{
+public:
+	// Enough for a full nametable, the background color and all sprites
+	static constexpr uint32_t MAX_TILES = 1024;
+
+	// 8 PPU palettes, plus one for solid colors
+	static constexpr uint32_t PALETTE_COUNT = 9;
+	static constexpr uint32_t PALETTE_SIZE = 4;
+
+	TileBatch(Shader *shader);
+	~TileBatch();
+
+	// Create the buffers
+	void load();
+
+	// Set the colors of every palette, PALETTE_COUNT * PALETTE_SIZE colors
+	void setPalettes(Span<const PPU::Color> colors);
+
+	// Queue a tile, with texture coordinates in pixels of the pattern table
+	void add(glm::vec3 pos, glm::vec2 size, glm::vec2 uvTopLeft, glm::vec2 uvBottomRight, uint8_t palette);
+
+	// Draw all queued tiles from the given pattern table, and clear the queue
+	void draw(Texture *patternTable);
+
+private:
+	// Per-tile attributes, read once per instance by the vertex shader
+	struct Instance
+	{
+		float x, y, depth;
+		float width, height;
+		float u0, v0, u1, v1;
+		float palette;
+	};
+
+	Shader *shader;
+	GLuint vaoId, quadVboId, instanceVboId;
+
+	std::vector<Instance> instances;
+
+	// Palette colors, normalized to floats for the shader
+	std::vector<float> palettes;
+};
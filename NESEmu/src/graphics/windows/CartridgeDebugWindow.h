@@ -3,8 +3,6 @@
 #include "../Window.h"
 #include "../../emulator/Cartridge.h"
 
-#include <sstream>
-
 class CartridgeDebugWindow : public Window
 {
 public:
@@ -12,7 +10,9 @@ public:
 
 	void draw() override;
 
+	// Reads the mapper state
+	bool inspectsConsole() override { return true; }
+
 private:
 	Cartridge &cartridge;
-	std::stringstream ss;
 };
@@ -19,8 +19,9 @@ NVss DIZC
 +--------- Negative
 )";
 
-DebugWindow::DebugWindow(NES &nes, CPU &cpu)
-	: Window(GLFW_KEY_F1), prevTime(0), frames(0), fps(0), emulationSpeed(1.0), renderingScale(1), nes(nes), cpu(cpu)
+DebugWindow::DebugWindow(NES &nes)
+	: Window(GLFW_KEY_F1), prevTime(0), frames(0), fps(0), emulationSpeed(1.0), renderingScale(1),
+	watchAddress(0), breakOnWrite(false), nes(nes)
 {
 	setVisible(true);
 }
@@ -47,8 +48,18 @@ void DebugWindow::draw()
 
 	// Emulator controls
 	{
-		ImGui::BeginChild("Debugger##Controls", ImVec2(0, 110), true);
+		ImGui::BeginChild("Debugger##Controls", ImVec2(0, 245), true);
+		FramePacer::Stats stats = nes.getEmulationStats();
+		EmulationThread::Throughput throughput = nes.getEmulationThroughput();
 		ImGui::Text("FPS: %u", fps);
+		ImGui::Text("Emulated: %.1f FPS, %.2f MHz", throughput.fps, throughput.mhz);
+		ImGui::Text("Frame time: %.2fms (jitter %.2fms, max %.2fms, drift %.2fms)", stats.averageFrameTime, stats.jitter,
+			stats.maxFrameTime, stats.drift);
+
+		// Snapshots are taken once per frame
+		RewindBuffer::Stats rewind = nes.getRewindStats();
+		ImGui::Text("Rewind (hold Backspace): %.1fs, %.1f / %.0f MiB", rewind.snapshots / 60.0,
+			rewind.usedBytes / (1024.0 * 1024.0), rewind.capacityBytes / (1024.0 * 1024.0));
 		ImGui::Spacing();
 
 		if (ImGui::Button("Step"))
@@ -63,12 +74,50 @@ void DebugWindow::draw()
 			nes.setRunning(!nes.getRunning());
 		}
 
+		ImGui::SameLine();
+
+		bool tracing = nes.getTracing();
+		if (ImGui::Checkbox("Trace CPU", &tracing))
+		{
+			nes.setTracing(tracing);
+		}
+
+		ImGui::SameLine();
+
+		bool drawTileLayers = nes.getDrawTileLayers();
+		if (ImGui::Checkbox("Tile layers", &drawTileLayers))
+		{
+			nes.setDrawTileLayers(drawTileLayers);
+		}
+
 		if (ImGui::InputDouble("Emulation speed", &emulationSpeed))
 		{
 			emulationSpeed = std::max(0.0, std::min(emulationSpeed, 5.0));
 			nes.setEmulationSpeed(emulationSpeed);
 		}
 
+		// Turbo ignores the emulation speed, and runs as fast as possible
+		bool turbo = nes.getTurbo();
+		if (ImGui::Checkbox("Turbo", &turbo))
+		{
+			nes.setTurbo(turbo);
+		}
+
+		ImGui::SameLine();
+
+		int frameSkip = static_cast<int>(nes.getTurboFrameSkip());
+		if (ImGui::InputInt("Present every N frames (0: display rate)", &frameSkip))
+		{
+			nes.setTurboFrameSkip(static_cast<uint32_t>(std::max(frameSkip, 0)));
+		}
+
+		// Shows the frames ahead of the emulated one, so that input shows up sooner
+		int runAhead = static_cast<int>(nes.getRunAhead());
+		if (ImGui::SliderInt("Run-ahead frames", &runAhead, 0, EmulationThread::MAX_RUN_AHEAD))
+		{
+			nes.setRunAhead(static_cast<uint32_t>(std::max(runAhead, 0)));
+		}
+
 		const char *comboLabels[] = { "1x", "2x", "4x", "8x" };
 		if (ImGui::BeginCombo("Rendering scale", comboLabels[renderingScale]))
 		{
@@ -95,16 +144,71 @@ void DebugWindow::draw()
 		ImGui::EndChild();
 	}
 
+	// Savestates
+	{
+		ImGui::BeginChild("Debugger##Savestates", ImVec2(0, 110), true);
+
+		for (size_t slot = 0; slot < NES::SAVE_SLOTS; slot++)
+		{
+			const SaveState &state = nes.getSaveSlot(slot);
+			ImGui::PushID(static_cast<int>(slot));
+
+			if (ImGui::Button("Save"))
+			{
+				nes.saveState(slot);
+			}
+
+			ImGui::SameLine();
+
+			if (ImGui::Button("Load"))
+			{
+				nes.loadState(slot);
+			}
+
+			ImGui::SameLine();
+
+			if (state.isEmpty())
+			{
+				ImGui::Text("Slot %zu: empty", slot + 1);
+			}
+			else
+			{
+				ImGui::Text("Slot %zu: frame %u (%.1f KiB)", slot + 1, state.getHeader().frame, state.getSize() / 1024.0);
+			}
+
+			ImGui::PopID();
+		}
+
+		ImGui::EndChild();
+	}
+
+	// Memory watch
+	{
+		ImGui::BeginChild("Debugger##Watch", ImVec2(0, 60), true);
+
+		bool changed = ImGui::InputScalar("Watch address", ImGuiDataType_U16, &watchAddress, nullptr, nullptr, "%04X", ImGuiInputTextFlags_CharsHexadecimal);
+		changed |= ImGui::Checkbox("Break on write", &breakOnWrite);
+
+		if (changed)
+		{
+			updateWatch();
+		}
+
+		ImGui::EndChild();
+	}
+
 	// CPU state
 	{
 		// TODO: Make auto sizing
 		ImGui::BeginChild("Debugger##CPU State", ImVec2(0, 150), true);
 		// float start = ImGui::GetCursorPosY();
 
-		CPU::State cpuState = cpu.getState();
-		ImGui::Text("Cycle:   %d", cpuState.totalCycles);
+		// As of the last frame the emulation thread finished, which has no instruction before the first one
+		CPU::State cpuState = nes.getCpuState();
+		ImGui::Text("Cycle:   %llu", (unsigned long long)cpuState.totalCycles);
 		ImGui::Text("PC:      $%X", cpuState.pc);
-		ImGui::Text("Opcode:  $%X | %s (%s)", cpuState.opcode, cpuState.instruction.c_str(), cpuState.addressingMode.c_str());
+		ImGui::Text("Opcode:  $%X | %s (%s)", cpuState.opcode, cpuState.instruction ? cpuState.instruction : "",
+			cpuState.addressingMode ? cpuState.addressingMode : "");
 		ImGui::Text("SP:      $%X", cpuState.sp);
 
 		ImGui::Text("P:       $%X (%s)", cpuState.p, utils::toBitString(cpuState.p).c_str());
@@ -124,4 +228,25 @@ void DebugWindow::draw()
 	}
 
 	ImGui::End();
+}
+
+void DebugWindow::updateWatch()
+{
+	std::unique_lock<std::mutex> lock = nes.lockConsole();
+	Bus &bus = nes.getBus();
+	bus.clearDebugWatches();
+
+	if (breakOnWrite)
+	{
+		bus.registerDebugWatch(watchAddress, watchAddress, [this](uint16_t address, uint8_t newValue, bool write)
+			{
+				if (write)
+				{
+					nes.requestBreak();
+				}
+			});
+	}
+
+	// Only arm watches while needed, since watched pages can not be accessed directly
+	bus.setDebugWatchesArmed(breakOnWrite);
 }
\ No newline at end of file
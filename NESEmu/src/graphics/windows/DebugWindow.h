@@ -2,19 +2,24 @@
 
 #include "../Window.h"
 #include "../../emulator/NES.h"
-#include "../../emulator/CPU.h"
 
 class DebugWindow : public Window
 {
 public:
-	DebugWindow(NES &nes, CPU &cpu);
+	DebugWindow(NES &nes);
 	void draw() override;
 
 private:
+	// Update the debug watch used to break on writes
+	void updateWatch();
+
 	double prevTime, emulationSpeed;
 	int renderingScale;
 	uint32_t frames, fps;
 
+	// Memory watch
+	uint16_t watchAddress;
+	bool breakOnWrite;
+
 	NES &nes;
-	CPU &cpu;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "InputDebugWindow.h"
 
-InputDebugWindow::InputDebugWindow(Controller &controller) : Window(GLFW_KEY_F5), controller(controller)
+InputDebugWindow::InputDebugWindow(Input &input, Controller &controller) : Window(GLFW_KEY_F5), input(input),
+	controller(controller)
 {
 
 }
@@ -16,7 +17,7 @@ void InputDebugWindow::draw()
 
 	// Input map
 	ImGui::Text("Input map: joy1");
-	ImGui::Text("Bitfield: %s", Input::getKeyMap("joy1").to_string().c_str());
+	ImGui::Text("Bitfield: %s", input.getKeyMap("joy1").to_string().c_str());
 	ImGui::Spacing();
 
 	// Controller
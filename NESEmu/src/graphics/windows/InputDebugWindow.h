@@ -7,10 +7,14 @@
 class InputDebugWindow : public Window
 {
 public:
-	InputDebugWindow(Controller &controller);
+	InputDebugWindow(Input &input, Controller &controller);
 
 	void draw() override;
 
+	// Reads the controller state
+	bool inspectsConsole() override { return true; }
+
 private:
+	Input &input;
 	Controller &controller;
 };
\ No newline at end of file
@@ -2,9 +2,9 @@
 #include "../../util/Logger.h"
 #include "../../util/Utils.h"
 
-#include <iomanip>
+#include <vector>
 
-MemoryViewWindow::MemoryViewWindow(Bus &bus) : Window(GLFW_KEY_F2), currentPage(0), bus(bus)
+MemoryViewWindow::MemoryViewWindow(Bus &bus, FrameArena &arena) : Window(GLFW_KEY_F2), currentPage(0), bus(bus), arena(arena)
 {
 
 }
@@ -27,9 +27,15 @@ void MemoryViewWindow::draw()
 		ImGui::BeginChild("Memory", ImVec2(ImGui::GetWindowContentRegionWidth(), 400), true, windowFlags);
 
 		// Display current memory page
-		utils::printMemory(ss, pageSize * currentPage, pageSize * (currentPage + 1), [&](uint16_t address) { return bus.read(address); });
-		ImGui::Text(ss.str().c_str());
-		ss.str("");
+		uint16_t start = pageSize * currentPage;
+		uint16_t end = pageSize * (currentPage + 1);
+		Span<char> text = arena.allocate<char>(utils::getMemoryTextSize(start, end));
+		size_t length = utils::printMemory(text, start, end, [&](uint16_t address) { return bus.read(address); });
+
+		if (length > 0)
+		{
+			ImGui::TextUnformatted(text.data(), text.data() + length);
+		}
 
 		ImGui::EndChild();
 	}
@@ -61,14 +67,7 @@ void MemoryViewWindow::draw()
 	ImGui::SameLine();
 
 	// Current page range
-	ss << std::hex
-		<< std::setw(4) << std::setfill('0')
-		<< pageSize * currentPage
-		<< " - "
-		<< std::setw(4) << std::setfill('0')
-		<< pageSize * (currentPage + 1);
-	ImGui::Text(ss.str().c_str());
-	ss.str("");
+	ImGui::Text("%04x - %04x", pageSize * currentPage, pageSize * (currentPage + 1));
 
 	ImGui::SameLine();
 
@@ -105,11 +104,12 @@ void MemoryViewWindow::draw()
 		Logger dump("..\\logs\\memdump.log");
 		dump.write("Memory dump\n\n");
 
-		utils::printMemory(ss, 0, 0xFFFF, [&](uint16_t address) { return bus.read(address); });
-		dump.write(ss.str().c_str());
+		// Too large for the frame arena, and only done on request
+		std::vector<char> text(utils::getMemoryTextSize(0, 0xFFFF));
+		utils::printMemory(text, 0, 0xFFFF, [&](uint16_t address) { return bus.read(address); });
+		dump.write(text.data());
 
 		printf("Dumped memory to logs/memdump.log");
-		ss.str("");
 	}
 
 	ImGui::End();
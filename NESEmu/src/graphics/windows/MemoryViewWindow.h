@@ -2,20 +2,24 @@
 
 #include "../Window.h"
 #include "../../emulator/Bus.h"
-
-#include <sstream>
+#include "../../util/FrameArena.h"
 
 class MemoryViewWindow : public Window
 {
 public:
-	MemoryViewWindow(Bus &bus);
+	MemoryViewWindow(Bus &bus, FrameArena &arena);
 
 	void draw() override;
 
+	// Reads memory through the bus
+	bool inspectsConsole() override { return true; }
+
 private:
 	const int pageSize = 0x00FF;
 
 	int currentPage;
 	Bus &bus;
-	std::stringstream ss;
+
+	// Holds the text of the current page
+	FrameArena &arena;
 };
\ No newline at end of file
@@ -1,13 +1,8 @@
 #include "PPUDebugWindow.h"
 #include "../Texture.h"
-#include "../ResourceManager.h"
 #include "../../util/Utils.h"
 
-#include <sstream>
-#include <iomanip>
-#include <vector>
-
-using std::string;
+#include <stdio.h>
 
 // PPU Register help texts from NES wiki:
 // https://wiki.nesdev.org/w/index.php/PPU_registers
@@ -62,11 +57,11 @@ VSO. ....
            line); cleared after reading $2002 and at dot 1 of the pre-render line.
 )";
 
-PPUDebugWindow::PPUDebugWindow(NES &nes, PPU &ppu, Cartridge &cartridge) :
+PPUDebugWindow::PPUDebugWindow(NES &nes, PPU &ppu, Cartridge &cartridge, ResourceManager &resources) :
 	Window(GLFW_KEY_F3), nes(nes), ppu(ppu), cartridge(cartridge), debugViewNametable(0)
 {
-	patternTableLeft = ResourceManager::getTexture("pattern_left");
-	patternTableRight = ResourceManager::getTexture("pattern_right");
+	patternTableLeft = resources.getTexture("pattern_left");
+	patternTableRight = resources.getTexture("pattern_right");
 }
 
 void PPUDebugWindow::draw()
@@ -125,21 +120,22 @@ void PPUDebugWindow::draw()
 			drawPalette("System table", ppu.getSystemPalette());
 			ImGui::Spacing();
 
-			drawPalette("Background 0", ppu.getPalette(0x3F01)); // Background 0
-			ImGui::SameLine();
-			drawPalette("Background 1", ppu.getPalette(0x3F05)); // Background 1
-			ImGui::SameLine();
-			drawPalette("Background 2", ppu.getPalette(0x3F09)); // Background 2
-			ImGui::SameLine();
-			drawPalette("Background 3", ppu.getPalette(0x3F0D)); // Background 3
+			const char *paletteLabels[] =
+			{
+				"Background 0", "Background 1", "Background 2", "Background 3",
+				"Sprite 0", "Sprite 1", "Sprite 2", "Sprite 3"
+			};
 
-			drawPalette("Sprite 0", ppu.getPalette(0x3F11)); // Sprite 0
-			ImGui::SameLine();
-			drawPalette("Sprite 1", ppu.getPalette(0x3F15)); // Sprite 1
-			ImGui::SameLine();
-			drawPalette("Sprite 2", ppu.getPalette(0x3F19)); // Sprite 2
-			ImGui::SameLine();
-			drawPalette("Sprite 3", ppu.getPalette(0x3F1D)); // Sprite 3
+			// 4 background palettes on the first row, 4 sprite palettes on the second
+			for (uint8_t i = 0; i < PPU::PALETTE_COUNT; i++)
+			{
+				if (i % 4 != 0)
+				{
+					ImGui::SameLine();
+				}
+
+				drawPalette(paletteLabels[i], ppu.getResolvedPalette(i));
+			}
 
 			ImGui::EndTabItem();
 		}
@@ -176,9 +172,9 @@ void PPUDebugWindow::draw()
 	ImGui::End();
 }
 
-void PPUDebugWindow::drawRegister(string name, uint16_t address, const void* reg, const char* helpText)
+void PPUDebugWindow::drawRegister(const char *name, uint16_t address, const void* reg, const char* helpText)
 {
-	ImGui::Text(name.c_str());
+	ImGui::TextUnformatted(name);
 	ImGui::SameLine();
 	ImGui::Text(" ($%X):", address);
 	ImGui::SameLine();
@@ -189,16 +185,16 @@ void PPUDebugWindow::drawRegister(string name, uint16_t address, const void* reg
 	if (helpText && ImGui::IsItemHovered())
 	{
 		ImGui::BeginTooltip();
-		ImGui::Text("%s ($%X)", name.c_str(), address);
+		ImGui::Text("%s ($%X)", name, address);
 		ImGui::Text(CTRL_HELP_TEXT);
 		ImGui::EndTooltip();
 	}
 }
 
-void PPUDebugWindow::drawPalette(string label, std::vector<PPU::Color> palette)
+void PPUDebugWindow::drawPalette(const char *label, Span<const PPU::Color> palette)
 {
 	ImGui::BeginGroup();
-	ImGui::Text(label.c_str());
+	ImGui::TextUnformatted(label);
 
 	ImDrawList *drawList = ImGui::GetWindowDrawList();
 	ImVec2 pos = ImGui::GetCursorScreenPos();
@@ -224,11 +220,9 @@ void PPUDebugWindow::drawPalette(string label, std::vector<PPU::Color> palette)
 		ImU32 imColor = ImColor(color.r, color.g, color.b);
 		drawList->AddRectFilled(ImVec2(pos.x, pos.y), ImVec2(pos.x + size, pos.y + size), imColor);
 
-		ss << "0x" << std::hex
-			<< std::setw(2) << std::setfill('0')
-			<< index;
-		drawList->AddText(ImVec2(pos.x, pos.y), textColor, ss.str().c_str());
-		ss.str("");
+		char indexText[8];
+		snprintf(indexText, sizeof(indexText), "0x%02x", index);
+		drawList->AddText(ImVec2(pos.x, pos.y), textColor, indexText);
 
 		cols++;
 		maxCols = std::max(cols, maxCols);
@@ -4,19 +4,21 @@
 #include "../../emulator/NES.h"
 #include "../../emulator/PPU.h"
 #include "../Texture.h"
-
-#include <sstream>
+#include "../ResourceManager.h"
 
 class PPUDebugWindow : public Window
 {
 public:
-	PPUDebugWindow(NES &nes, PPU &ppu, Cartridge &cartridge);
+	PPUDebugWindow(NES &nes, PPU &ppu, Cartridge &cartridge, ResourceManager &resources);
 
 	void draw() override;
 
+	// Reads the PPU registers, memory and OAM
+	bool inspectsConsole() override { return true; }
+
 private:
-	void drawRegister(std::string name, uint16_t address, const void* reg, const char* helpText);
-	void drawPalette(std::string label, std::vector<PPU::Color> palette);
+	void drawRegister(const char *name, uint16_t address, const void* reg, const char* helpText);
+	void drawPalette(const char *label, Span<const PPU::Color> palette);
 	void drawNametable(uint8_t nametable);
 	void drawOam();
 
@@ -25,6 +27,5 @@ private:
 	Cartridge &cartridge;
 	Texture *patternTableLeft;
 	Texture *patternTableRight;
-	std::stringstream ss;
 	int debugViewNametable;
 };
\ No newline at end of file
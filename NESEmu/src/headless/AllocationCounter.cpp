@@ -0,0 +1,72 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocationCount(0);
+
+uint64_t AllocationCounter::getCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+// Replacements of the global allocation functions. The array and nothrow forms are replaced too, since the default
+// ones are not guaranteed to call the plain form. Over-aligned allocations are not counted
+void *operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *pointer = std::malloc(size == 0 ? 1 : size))
+	{
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+	std::free(pointer);
+}
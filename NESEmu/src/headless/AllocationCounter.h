@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts heap allocations made through the global operator new, which is replaced when this is linked in.
+// Only the headless runner links it, to check that emulation does not allocate once it is running
+class AllocationCounter
+{
+public:
+	// Returns the amount of allocations made since the program started, by any thread
+	static uint64_t getCount();
+};
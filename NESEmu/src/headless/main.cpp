@@ -0,0 +1,918 @@
+#include "AllocationCounter.h"
+#include "../emulator/Console.h"
+#include "../emulator/EmulationThread.h"
+#include "../emulator/EmulatorPool.h"
+#include "../emulator/LockstepCPU.h"
+#include "../util/Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// NTSC CPU clock, used to report speed relative to real hardware
+static constexpr double CPU_CLOCK_HZ = Scheduler::MASTER_CLOCK_HZ / Scheduler::CPU_CLOCK_DIVIDER;
+
+static constexpr uint32_t DEFAULT_FRAMES = 600;
+
+// Frames run before checking allocations, for buffers to reach the size they keep
+static constexpr uint32_t WARMUP_FRAMES = 60;
+
+// Savestates saved and loaded to measure their speed
+static constexpr uint32_t SAVESTATE_PASSES = 1000;
+
+// CPU cycles run past the end of a frame before saving, so that the savestate is made in the middle of one
+static constexpr uint32_t SAVESTATE_FRAME_OFFSET = 10000;
+
+// Program of the ROM also run by --bench-rewind and --bench-run-ahead, at $C000 in a 16 KiB NROM image: it turns on the background
+// and NMI, and the NMI handler writes a new backdrop color every frame, so that every row of every frame changes
+static constexpr uint8_t ANIMATED_ROM_PROGRAM[] = {
+	0x78,                   // reset: SEI
+	0xA2, 0xFF,             //        LDX #$FF
+	0x9A,                   //        TXS
+	0xA9, 0x00,             //        LDA #$00
+	0x8D, 0x00, 0x20,       //        STA $2000
+	0x8D, 0x01, 0x20,       //        STA $2001
+	0x2C, 0x02, 0x20,       // wait1: BIT $2002
+	0x10, 0xFB,             //        BPL wait1
+	0x2C, 0x02, 0x20,       // wait2: BIT $2002
+	0x10, 0xFB,             //        BPL wait2
+	0xA9, 0x0A,             //        LDA #$0A
+	0x8D, 0x01, 0x20,       //        STA $2001
+	0xA9, 0x80,             //        LDA #$80
+	0x8D, 0x00, 0x20,       //        STA $2000
+	0x4C, 0x20, 0xC0,       // loop:  JMP loop
+	0xE6, 0x00,             // nmi:   INC $00
+	0xA9, 0x3F,             //        LDA #$3F
+	0x8D, 0x06, 0x20,       //        STA $2006
+	0xA9, 0x00,             //        LDA #$00
+	0x8D, 0x06, 0x20,       //        STA $2006
+	0xA5, 0x00,             //        LDA $00
+	0x29, 0x3F,             //        AND #$3F
+	0x8D, 0x07, 0x20,       //        STA $2007
+	0xA9, 0x00,             //        LDA #$00
+	0x8D, 0x06, 0x20,       //        STA $2006
+	0x8D, 0x06, 0x20,       //        STA $2006
+	0x40                    //        RTI
+};
+static constexpr uint16_t ANIMATED_ROM_NMI = 0xC023;
+static constexpr uint16_t ANIMATED_ROM_RESET = 0xC000;
+
+// CPU cycles in a frame rounded up, for the length of --bench-lockstep and the paced runs of --bench-rewind
+static constexpr uint32_t CPU_CYCLES_PER_FRAME = static_cast<uint32_t>(Console::CPU_CYCLES_PER_FRAME) + 1;
+
+// CPU cycles run before --bench-rewind starts capturing, so that snapshots land in the middle of frames
+static constexpr uint32_t REWIND_CYCLE_OFFSET = 15000;
+
+// Consoles run at once by --bench-pool
+static constexpr uint32_t BENCH_POOL_INSTANCES = 128;
+
+
+// Program run by every lane of --bench-lockstep, at $0200: a loop stepping an 8-bit LFSR seeded from $00, storing
+// its values at $0300,X and summing them into $01, which calls a subroutine at $0230 counting zeros of the sum in $02.
+// The carry out of the LFSR and the sum make lanes with different seeds take different branches
+static constexpr uint16_t LOCKSTEP_PROGRAM_ADDRESS = 0x0200;
+static constexpr uint8_t LOCKSTEP_PROGRAM[] = {
+	0xA2, 0x00,             //        LDX #$00
+	0xA5, 0x00,             // loop:  LDA $00
+	0x0A,                   //        ASL A
+	0x90, 0x02,             //        BCC skip
+	0x49, 0x1D,             //        EOR #$1D
+	0x85, 0x00,             // skip:  STA $00
+	0x9D, 0x00, 0x03,       //        STA $0300,X
+	0x18,                   //        CLC
+	0x65, 0x01,             //        ADC $01
+	0x85, 0x01,             //        STA $01
+	0x29, 0x07,             //        AND #$07
+	0xD0, 0x03,             //        BNE next
+	0x20, 0x30, 0x02,       //        JSR count
+	0xE8,                   // next:  INX
+	0xD0, 0xE5,             //        BNE loop
+	0x4C, 0x00, 0x02        //        JMP $0200
+};
+static constexpr uint16_t LOCKSTEP_SUBROUTINE_ADDRESS = 0x0230;
+static constexpr uint8_t LOCKSTEP_SUBROUTINE[] = {
+	0xE6, 0x02,             // count: INC $02
+	0x60                    //        RTS
+};
+
+static void printUsage()
+{
+	printf("Usage: nesemu-headless <rom> [frames] [--trace] [--bench-tiles] [--check-allocations] [--bench-savestates]\n");
+	printf("\t[--bench-rewind] [--bench-run-ahead] [--bench-pool]\n");
+	printf("       nesemu-headless --bench-lockstep [frames]\n");
+	printf("\tRuns the ROM for the given amount of frames (default %u) as fast as possible, then prints\n", DEFAULT_FRAMES);
+	printf("\tthe emulation speed and hashes of the final RAM, video memory and rendered frame\n");
+	printf("\t--trace: record a CPU trace to ../logs/cpu.trace\n");
+	printf("\t--bench-tiles: only measure decoding the pattern tables of the ROM\n");
+	printf("\t--check-allocations: fail if emulating the frames allocates any memory, after %u warmup frames\n",
+		WARMUP_FRAMES);
+	printf("\t--bench-savestates: measure saving and loading, and check that running the frames again after\n");
+	printf("\tloading gives the same result\n");
+	printf("\t--bench-rewind: capture a rewind snapshot every frame, in the middle of frames, then rewind through all of\n");
+	printf("\tthem, checking that each one shows a frame drawn by a normal run. Also checks the built-in ROM of\n");
+	printf("\t--bench-run-ahead\n");
+	printf("\t--bench-run-ahead: measure running 1 to %u frames ahead every frame, and check that it shows the same\n",
+		EmulationThread::MAX_RUN_AHEAD);
+	printf("\tframes as running normally, that many frames sooner. Also checks a built-in ROM that changes every frame\n");
+	printf("\t--bench-pool: run %u consoles at once on a thread pool, and check that they all match a single one\n",
+		BENCH_POOL_INSTANCES);
+	printf("\t--bench-lockstep: run a built-in program on %u CPUs in lock-step for as many cycles as the frames, and\n",
+		LockstepCPU::LANES);
+	printf("\tcheck that they match as many scalar CPUs. No ROM is needed\n");
+}
+
+// Hash of the nametables, palettes and OAM
+static uint64_t hashVideoMemory(PPU &ppu)
+{
+	std::vector<uint8_t> memory;
+
+	for (uint16_t address = 0x2000; address < 0x3000; address++)
+	{
+		memory.push_back(ppu.readMemory(address));
+	}
+
+	for (uint16_t address = 0x3F00; address < 0x3F00 + PPU::PALETTE_TABLE_SIZE; address++)
+	{
+		memory.push_back(ppu.readMemory(address));
+	}
+
+	uint8_t *oam = reinterpret_cast<uint8_t *>(ppu.getOamSprite(0));
+	memory.insert(memory.end(), oam, oam + PPU::OAM_SIZE);
+
+	return utils::fnv1a(memory.data(), memory.size());
+}
+
+// Decode every tile of the pattern tables bit by bit, with 2 memory reads per pixel
+static void decodeTilesPerPixel(PPU &ppu, uint8_t *pixels)
+{
+	for (uint16_t tile = 0; tile < TileCache::TILE_COUNT; tile++)
+	{
+		for (uint16_t i = 0; i < TileCache::TILE_PIXELS; i++)
+		{
+			uint16_t address = tile * TileCache::TILE_BYTES + i / 8;
+			uint8_t bit = 7 - i % 8;
+			uint8_t low = (ppu.readMemory(address) >> bit) & 1;
+			uint8_t high = (ppu.readMemory(address + 8) >> bit) & 1;
+			pixels[tile * TileCache::TILE_PIXELS + i] = low | (high << 1);
+		}
+	}
+}
+
+// Time decoding all 512 tiles the given amount of times, in nanoseconds per tile
+template <typename Decoder>
+static double timeDecoding(uint32_t passes, Decoder decoder)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t pass = 0; pass < passes; pass++)
+	{
+		decoder();
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / (passes * TileCache::TILE_COUNT);
+}
+
+// Compare decoding the pattern tables per pixel, with lookup tables, and with SIMD when available
+static int benchmarkTiles(PPU &ppu)
+{
+	std::vector<uint8_t> planes(TileCache::TILE_COUNT * TileCache::TILE_BYTES);
+	std::vector<uint8_t> reference(TileCache::TILE_COUNT * TileCache::TILE_PIXELS);
+	std::vector<uint8_t> scalar(reference.size());
+	std::vector<uint8_t> simd(reference.size());
+
+	for (uint16_t address = 0; address < planes.size(); address++)
+	{
+		planes[address] = ppu.readMemory(address);
+	}
+
+	double perPixelTime = timeDecoding(20, [&]() { decodeTilesPerPixel(ppu, reference.data()); });
+
+	double scalarTime = timeDecoding(2000, [&]()
+	{
+		for (uint16_t tile = 0; tile < TileCache::TILE_COUNT; tile++)
+		{
+			TileCache::decodeTile(&planes[tile * TileCache::TILE_BYTES], &scalar[tile * TileCache::TILE_PIXELS]);
+		}
+	});
+
+	double simdTime = timeDecoding(2000, [&]()
+	{
+		for (uint16_t tile = 0; tile < TileCache::TILE_COUNT; tile++)
+		{
+			TileCache::decodeTileSimd(&planes[tile * TileCache::TILE_BYTES], &simd[tile * TileCache::TILE_PIXELS]);
+		}
+	});
+
+	printf("Per pixel:     %8.1f ns/tile\n", perPixelTime);
+	printf("Lookup table:  %8.1f ns/tile (%.1fx)\n", scalarTime, perPixelTime / scalarTime);
+	printf("%-14s %8.1f ns/tile (%.1fx)\n", TileCache::hasSimd() ? "SSE2:" : "No SIMD:", simdTime, perPixelTime / simdTime);
+
+	if (scalar != reference || simd != reference)
+	{
+		printf("Error, decoded tiles do not match\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+// Run frames once the console is warmed up, with and without drawing them, and fail if any allocate memory
+static int checkAllocations(Console &console, uint32_t frames)
+{
+	for (uint32_t i = 0; i < WARMUP_FRAMES; i++)
+	{
+		console.runFrame();
+	}
+
+	uint64_t startCount = AllocationCounter::getCount();
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		// Half of the frames are skipped, like in turbo mode
+		console.getPPU().setPixelOutput(i % 2 == 0);
+		console.runFrame();
+	}
+
+	uint64_t allocations = AllocationCounter::getCount() - startCount;
+	printf("Allocations in %u frames: %llu\n", frames, (unsigned long long)allocations);
+
+	if (allocations != 0)
+	{
+		printf("Error, emulated frames allocated memory\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+// Hash of the RAM, video memory and rendered frame
+static uint64_t hashConsole(Console &console)
+{
+	const PPU::Framebuffer &framebuffer = console.getPPU().getFramebuffer();
+	uint64_t videoHash = hashVideoMemory(console.getPPU());
+
+	uint64_t hash = utils::fnv1a(console.getBus().get(0x0000), 0x800);
+	hash = utils::fnv1a(reinterpret_cast<const uint8_t *>(&videoHash), sizeof(videoHash), hash);
+	return utils::fnv1a(framebuffer.data(), framebuffer.size(), hash);
+}
+
+// Save in the middle of a frame, and check that the frames after it are the same when run again from the savestate
+static int benchmarkSaveStates(Console &console, uint32_t frames)
+{
+	SaveState state;
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		console.runFrame();
+	}
+
+	console.runCycles(SAVESTATE_FRAME_OFFSET);
+	console.saveState(state);
+
+	auto runFrames = [&]()
+	{
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			console.runFrame();
+		}
+
+		return hashConsole(console);
+	};
+
+	uint64_t expectedHash = runFrames();
+
+	if (!console.loadState(state))
+	{
+		return 1;
+	}
+
+	uint64_t loadedHash = runFrames();
+
+	// Every save after the first one reuses the memory of the savestate
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < SAVESTATE_PASSES; i++)
+	{
+		console.saveState(state);
+	}
+
+	auto middle = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < SAVESTATE_PASSES; i++)
+	{
+		console.loadState(state);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	double saveTime = std::chrono::duration<double, std::micro>(middle - start).count() / SAVESTATE_PASSES;
+	double loadTime = std::chrono::duration<double, std::micro>(end - middle).count() / SAVESTATE_PASSES;
+
+	printf("Savestate:  %zu bytes\n", state.getSize());
+	printf("Save:       %8.2f us\n", saveTime);
+	printf("Load:       %8.2f us\n", loadTime);
+	printf("Hash after %u frames: %016llX, after loading: %016llX\n", frames, (unsigned long long)expectedHash,
+		(unsigned long long)loadedHash);
+
+	if (loadedHash != expectedHash)
+	{
+		printf("Error, frames run after loading the savestate do not match\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+// Write an NROM image running the animated program, which the cartridge can only load from a file
+static bool writeAnimatedRom(const std::string &path)
+{
+	std::vector<uint8_t> rom(16 + 0x4000 + 0x2000, 0);
+	const uint8_t header[] = { 'N', 'E', 'S', 0x1A, 1, 1 };
+	std::copy(std::begin(header), std::end(header), rom.begin());
+
+	uint8_t *prg = rom.data() + 16;
+	std::copy(std::begin(ANIMATED_ROM_PROGRAM), std::end(ANIMATED_ROM_PROGRAM), prg);
+
+	// NMI, reset and IRQ vectors, at the end of the bank mirrored to $C000
+	const uint16_t vectors[] = { ANIMATED_ROM_NMI, ANIMATED_ROM_RESET, ANIMATED_ROM_RESET };
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		prg[0x3FFA + i * 2] = vectors[i] & 0xFF;
+		prg[0x3FFA + i * 2 + 1] = vectors[i] >> 8;
+	}
+
+	FILE *file = fopen(path.c_str(), "wb");
+
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	bool written = fwrite(rom.data(), 1, rom.size(), file) == rom.size();
+	fclose(file);
+
+	return written;
+}
+
+// Load the animated ROM into a console, through a temporary file
+static bool loadAnimatedRom(Console &console)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "nesemu-animated.nes";
+	bool loaded = writeAnimatedRom(path.string()) && console.load(path.string());
+	std::filesystem::remove(path);
+
+	if (!loaded)
+	{
+		printf("Error, failed to load the animated ROM from %s\n", path.string().c_str());
+	}
+
+	return loaded;
+}
+
+// Capture a rewind snapshot every frame like the emulation thread does, then rewind through all of them, checking
+// that each one restores the frame and RAM it was captured at, and shows a whole frame drawn by a normal run
+static int checkRewind(Console &console, uint32_t frames)
+{
+	// Frames as drawn by a normal run, by frame number, to check the frames shown while rewinding. The frame after
+	// the last snapshot is needed too
+	SaveState start;
+	std::vector<uint64_t> frameHashes;
+	console.saveState(start);
+
+	for (uint32_t i = 0; i < frames + 2; i++)
+	{
+		console.runFrame();
+
+		const PPU::Framebuffer &framebuffer = console.getPPU().getFramebuffer();
+		frameHashes.resize(console.getPPU().getFrameCount());
+		frameHashes.back() = utils::fnv1a(framebuffer.data(), framebuffer.size());
+	}
+
+	if (!console.loadState(start))
+	{
+		return 1;
+	}
+
+	// Captured like the paced emulation thread does, after a frame worth of cycles that does not end where a frame
+	// starts
+	RewindBuffer rewind(EmulationThread::REWIND_BUFFER_SIZE, EmulationThread::REWIND_SNAPSHOTS);
+	std::vector<std::pair<uint32_t, uint64_t>> captured;
+	uint32_t lastFrame = console.getPPU().getFrameCount();
+	uint32_t endFrame = lastFrame + frames;
+	double captureTime = 0;
+
+	console.runCycles(REWIND_CYCLE_OFFSET);
+
+	while (console.getPPU().getFrameCount() < endFrame)
+	{
+		console.runCycles(CPU_CYCLES_PER_FRAME);
+
+		if (console.getPPU().getFrameCount() == lastFrame)
+		{
+			continue;
+		}
+
+		lastFrame = console.getPPU().getFrameCount();
+
+		auto captureStart = std::chrono::steady_clock::now();
+		bool kept = rewind.capture(console);
+		captureTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - captureStart).count();
+
+		if (kept)
+		{
+			captured.push_back({ lastFrame, utils::fnv1a(console.getBus().get(0x0000), 0x800) });
+		}
+	}
+
+	rewind.flush();
+	RewindBuffer::Stats stats = rewind.getStats();
+	double snapshotSize = stats.snapshots > 0 ? static_cast<double>(stats.usedBytes) / stats.snapshots : 0;
+
+	printf("Snapshots:  %u (%llu dropped), %.1f bytes each\n", stats.snapshots,
+		(unsigned long long)stats.droppedSnapshots, snapshotSize);
+	printf("10 minutes: %.1f MiB\n", snapshotSize * EmulationThread::REWIND_SNAPSHOTS / (1024.0 * 1024.0));
+	printf("Capture:    %8.2f us\n", captured.empty() ? 0 : captureTime / captured.size());
+
+	// Every rewound frame also emulates the first whole frame after it to show it, like the emulation thread does,
+	// which must be the frame the normal run drew
+	double rewindTime = 0;
+
+	for (auto it = captured.rbegin(); it != captured.rend(); it++)
+	{
+		auto rewindStart = std::chrono::steady_clock::now();
+		bool restored = rewind.rewind(console);
+		uint32_t frame = console.getPPU().getFrameCount();
+		uint64_t ramHash = utils::fnv1a(console.getBus().get(0x0000), 0x800);
+		console.runDrawnFrame();
+		rewindTime += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - rewindStart).count();
+
+		if (!restored || frame != it->first || ramHash != it->second)
+		{
+			printf("Error, rewinding to frame %u restored frame %u\n", it->first, frame);
+			return 1;
+		}
+
+		// Snapshots are taken within the frame they are numbered after, so the first whole frame is the next one
+		const PPU::Framebuffer &framebuffer = console.getPPU().getFramebuffer();
+
+		if (utils::fnv1a(framebuffer.data(), framebuffer.size()) != frameHashes[frame + 1])
+		{
+			printf("Error, rewinding to frame %u shows a frame that was never drawn\n", frame);
+			return 1;
+		}
+	}
+
+	printf("Rewind:     %8.2f us per frame\n", captured.empty() ? 0 : rewindTime / captured.size());
+
+	if (rewind.rewind(console))
+	{
+		printf("Error, rewind history is not empty\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+// Check rewinding on the ROM, and on the animated ROM, where a frame shown with stale rows can not go unnoticed
+static int benchmarkRewind(Console &console, uint32_t frames)
+{
+	if (checkRewind(console, frames) != 0)
+	{
+		return 1;
+	}
+
+	Console animated;
+
+	if (!loadAnimatedRom(animated))
+	{
+		return 1;
+	}
+
+	return checkRewind(animated, frames);
+}
+
+// Run the frames normally, then again from the start while running ahead, checking that every frame shown ahead is
+// the one shown later by the normal run, and that the emulated state ends up the same
+static int checkRunAhead(Console &console, uint32_t frames, uint32_t aheadFrames)
+{
+	SaveState start;
+	SaveState scratch;
+	std::vector<uint64_t> frameHashes;
+	uint64_t expectedHash = 0;
+
+	console.saveState(start);
+	auto normalStart = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < frames + aheadFrames; i++)
+	{
+		console.runFrame();
+
+		const PPU::Framebuffer &framebuffer = console.getPPU().getFramebuffer();
+		frameHashes.push_back(utils::fnv1a(framebuffer.data(), framebuffer.size()));
+
+		if (i + 1 == frames)
+		{
+			expectedHash = utils::fnv1a(console.getBus().get(0x0000), 0x800, hashVideoMemory(console.getPPU()));
+		}
+	}
+
+	double normalTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - normalStart).count();
+
+	if (!console.loadState(start))
+	{
+		return 1;
+	}
+
+	auto runAheadStart = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		console.getPPU().setPixelOutput(false);
+		console.runFrame();
+
+		if (!console.runAhead(aheadFrames, scratch))
+		{
+			return 1;
+		}
+
+		const PPU::Framebuffer &framebuffer = console.getPPU().getFramebuffer();
+
+		if (utils::fnv1a(framebuffer.data(), framebuffer.size()) != frameHashes[i + aheadFrames])
+		{
+			printf("Error, frame %u shown ahead does not match\n", console.getPPU().getFrameCount() + aheadFrames);
+			return 1;
+		}
+	}
+
+	double runAheadTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - runAheadStart).count();
+	uint64_t hash = utils::fnv1a(console.getBus().get(0x0000), 0x800, hashVideoMemory(console.getPPU()));
+
+	printf("%u ahead:    %8.2f us per frame, %8.2f us without running ahead\n", aheadFrames, runAheadTime / frames,
+		normalTime / (frames + aheadFrames));
+
+	if (hash != expectedHash)
+	{
+		printf("Error, running ahead changed the emulated frames: state hash %016llX instead of %016llX\n",
+			(unsigned long long)hash, (unsigned long long)expectedHash);
+		return 1;
+	}
+
+	return 0;
+}
+
+// Check running ahead by every amount of frames the emulation thread allows, on the ROM and on the animated ROM.
+// Static pictures would hide a frame shown from the wrong buffer, or a stale row
+static int benchmarkRunAhead(Console &console, uint32_t frames)
+{
+	for (uint32_t aheadFrames = 1; aheadFrames <= EmulationThread::MAX_RUN_AHEAD; aheadFrames++)
+	{
+		if (checkRunAhead(console, frames, aheadFrames) != 0)
+		{
+			return 1;
+		}
+	}
+
+	Console animated;
+
+	if (!loadAnimatedRom(animated))
+	{
+		return 1;
+	}
+
+	for (uint32_t aheadFrames = 1; aheadFrames <= EmulationThread::MAX_RUN_AHEAD; aheadFrames++)
+	{
+		if (checkRunAhead(animated, frames, aheadFrames) != 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Run many consoles of the same ROM on a pool, each of which must end up the same as the given console run on its own
+static int benchmarkPool(Console &console, const std::string &romPath, uint32_t frames)
+{
+	EmulatorPool pool;
+
+	for (uint32_t i = 0; i < BENCH_POOL_INSTANCES; i++)
+	{
+		if (pool.add(romPath) < 0)
+		{
+			return 1;
+		}
+	}
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		console.runFrame();
+	}
+
+	uint64_t expectedHash = hashConsole(console);
+	pool.runFrames(frames);
+
+	EmulatorPool::Stats stats = pool.getStats();
+	printf("Pool:       %u consoles on %u threads\n", stats.instances, pool.getThreadCount());
+	printf("Ran %llu frames in %.3f s, %.1f FPS\n", (unsigned long long)stats.frames, stats.seconds,
+		stats.framesPerSecond);
+	printf("Memory:     %.1f KiB per console, %.1f MiB total\n", pool.getMemorySize(0) / 1024.0,
+		stats.memoryBytes / (1024.0 * 1024.0));
+
+	for (uint32_t i = 0; i < pool.getInstanceCount(); i++)
+	{
+		if (hashConsole(pool.getConsole(i)) != expectedHash)
+		{
+			printf("Error, console %u does not match a console run on its own\n", i);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Load the lock-step program into the memory of a lane, along with the seed it starts from
+static void loadLockstepProgram(Bus &bus, uint8_t seed)
+{
+	for (uint16_t i = 0; i < sizeof(LOCKSTEP_PROGRAM); i++)
+	{
+		bus.write(LOCKSTEP_PROGRAM_ADDRESS + i, LOCKSTEP_PROGRAM[i]);
+	}
+
+	for (uint16_t i = 0; i < sizeof(LOCKSTEP_SUBROUTINE); i++)
+	{
+		bus.write(LOCKSTEP_SUBROUTINE_ADDRESS + i, LOCKSTEP_SUBROUTINE[i]);
+	}
+
+	bus.write(0x0000, seed);
+}
+
+// Run the lock-step program on every lane of a LockstepCPU and on as many scalar CPUs, with the same seed for every
+// lane or a different one, and check that they end up the same
+static int benchmarkLockstepSeeds(uint64_t cycles, bool sameSeeds)
+{
+	// Seeds must not be 0, which the LFSR never leaves
+	auto getSeed = [sameSeeds](uint32_t lane) { return static_cast<uint8_t>(sameSeeds ? 0x5A : lane * 17 + 1); };
+
+	std::unique_ptr<LockstepCPU> lockstep(new LockstepCPU());
+
+	for (uint32_t lane = 0; lane < LockstepCPU::LANES; lane++)
+	{
+		loadLockstepProgram(lockstep->getBus(lane), getSeed(lane));
+	}
+
+	lockstep->reset(LOCKSTEP_PROGRAM_ADDRESS);
+
+	auto start = std::chrono::steady_clock::now();
+	lockstep->runUntil(cycles);
+	double lockstepTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	struct ScalarCPU
+	{
+		Scheduler scheduler;
+		Bus bus;
+		CPU cpu;
+		uint64_t cycles;
+
+		ScalarCPU() : cpu(bus, scheduler), cycles(0)
+		{
+		}
+	};
+
+	std::vector<std::unique_ptr<ScalarCPU>> scalars;
+	uint64_t scalarInstructions = 0;
+
+	for (uint32_t lane = 0; lane < LockstepCPU::LANES; lane++)
+	{
+		scalars.emplace_back(new ScalarCPU());
+		loadLockstepProgram(scalars.back()->bus, getSeed(lane));
+
+		// Same registers as LockstepCPU::reset
+		scalars.back()->cpu.setRegisters({ 0x00, 0x00, 0x00, 0x24, 0xFD, LOCKSTEP_PROGRAM_ADDRESS });
+	}
+
+	start = std::chrono::steady_clock::now();
+
+	for (std::unique_ptr<ScalarCPU> &scalar : scalars)
+	{
+		while (scalar->cycles < cycles)
+		{
+			scalar->cycles += scalar->cpu.step();
+			scalarInstructions++;
+		}
+	}
+
+	double scalarTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	LockstepCPU::Stats stats = lockstep->getStats();
+	uint64_t lockstepInstructions = stats.lockstepInstructions + stats.scalarInstructions;
+
+	printf("%s seeds:\n", sameSeeds ? "Same" : "Different");
+	printf("\tScalar:    %8.2f M instructions/s\n", scalarInstructions / scalarTime / 1e6);
+	printf("\tLock-step: %8.2f M instructions/s (%.2fx), %.1f%% of instructions in lock-step, %.1f lanes per step\n",
+		lockstepInstructions / lockstepTime / 1e6, scalarTime / lockstepTime,
+		100.0 * stats.lockstepInstructions / lockstepInstructions,
+		stats.lockstepSteps > 0 ? static_cast<double>(stats.lockstepInstructions) / stats.lockstepSteps : 0.0);
+
+	if (lockstepInstructions != scalarInstructions)
+	{
+		printf("Error, lock-step CPUs ran %llu instructions instead of %llu\n", (unsigned long long)lockstepInstructions,
+			(unsigned long long)scalarInstructions);
+		return 1;
+	}
+
+	for (uint32_t lane = 0; lane < LockstepCPU::LANES; lane++)
+	{
+		CPU::Registers expected = scalars[lane]->cpu.getRegisters();
+		CPU::Registers registers = lockstep->getRegisters(lane);
+		bool sameRegisters = registers.a == expected.a && registers.x == expected.x && registers.y == expected.y &&
+			registers.p == expected.p && registers.sp == expected.sp && registers.pc == expected.pc;
+
+		if (!sameRegisters || lockstep->getTotalCycles(lane) != scalars[lane]->cycles ||
+			utils::fnv1a(lockstep->getBus(lane).get(0x0000), 0x800) != utils::fnv1a(scalars[lane]->bus.get(0x0000), 0x800))
+		{
+			printf("Error, lane %u does not match a scalar CPU\n", lane);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int benchmarkLockstep(uint32_t frames)
+{
+	uint64_t cycles = static_cast<uint64_t>(frames) * CPU_CYCLES_PER_FRAME;
+	printf("Lock-step:  %u lanes, %llu CPU cycles each\n", LockstepCPU::LANES, (unsigned long long)cycles);
+
+	if (benchmarkLockstepSeeds(cycles, true) != 0)
+	{
+		return 1;
+	}
+
+	return benchmarkLockstepSeeds(cycles, false);
+}
+
+int main(int argc, char **argv)
+{
+	std::string romPath;
+	uint32_t frames = DEFAULT_FRAMES;
+	bool trace = false;
+	bool benchTiles = false;
+	bool allocations = false;
+	bool benchSaveStates = false;
+	bool benchRewind = false;
+	bool benchRunAhead = false;
+	bool benchPool = false;
+	bool benchLockstep = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--trace") == 0)
+		{
+			trace = true;
+		}
+		else if (strcmp(argv[i], "--bench-tiles") == 0)
+		{
+			benchTiles = true;
+		}
+		else if (strcmp(argv[i], "--check-allocations") == 0)
+		{
+			allocations = true;
+		}
+		else if (strcmp(argv[i], "--bench-savestates") == 0)
+		{
+			benchSaveStates = true;
+		}
+		else if (strcmp(argv[i], "--bench-rewind") == 0)
+		{
+			benchRewind = true;
+		}
+		else if (strcmp(argv[i], "--bench-run-ahead") == 0)
+		{
+			benchRunAhead = true;
+		}
+		else if (strcmp(argv[i], "--bench-pool") == 0)
+		{
+			benchPool = true;
+		}
+		else if (strcmp(argv[i], "--bench-lockstep") == 0)
+		{
+			benchLockstep = true;
+		}
+		else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+		{
+			printUsage();
+			return 0;
+		}
+		else if (romPath.empty())
+		{
+			romPath = argv[i];
+		}
+		else
+		{
+			frames = static_cast<uint32_t>(strtoul(argv[i], nullptr, 10));
+		}
+	}
+
+	// The lock-step benchmark runs a built-in program, so its only argument is the amount of frames, and a ROM
+	// given anyway is ignored
+	if (benchLockstep)
+	{
+		char *end = nullptr;
+		uint32_t number = static_cast<uint32_t>(strtoul(romPath.c_str(), &end, 10));
+
+		if (!romPath.empty() && *end == '\0')
+		{
+			frames = number;
+		}
+
+		if (frames == 0)
+		{
+			printUsage();
+			return 1;
+		}
+
+		return benchmarkLockstep(frames);
+	}
+
+	if (romPath.empty() || frames == 0)
+	{
+		printUsage();
+		return 1;
+	}
+
+	Console console;
+
+	if (!console.load(romPath))
+	{
+		printf("Error, failed to load ROM: %s\n", romPath.c_str());
+		return 1;
+	}
+
+	if (benchTiles)
+	{
+		return benchmarkTiles(console.getPPU());
+	}
+
+	if (benchSaveStates)
+	{
+		return benchmarkSaveStates(console, frames);
+	}
+
+	if (benchRewind)
+	{
+		return benchmarkRewind(console, frames);
+	}
+
+	if (benchRunAhead)
+	{
+		return benchmarkRunAhead(console, frames);
+	}
+
+	if (benchPool)
+	{
+		return benchmarkPool(console, romPath, frames);
+	}
+
+	console.setTracing(trace);
+
+	if (allocations)
+	{
+		int result = checkAllocations(console, frames);
+		console.setTracing(false);
+		return result;
+	}
+
+	uint64_t startCycle = console.getCPU().getTotalCycles();
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		console.runFrame();
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	console.setTracing(false);
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	uint64_t cycles = console.getCPU().getTotalCycles() - startCycle;
+	double hz = cycles / seconds;
+
+	printf("Ran %u frames (%llu CPU cycles) in %.3f s\n", frames, (unsigned long long)cycles, seconds);
+	printf("Emulated %.1f FPS, %.2f MHz (%.2fx real time)\n", frames / seconds, hz / 1e6, hz / CPU_CLOCK_HZ);
+	printf("Frame:      %u\n", console.getPPU().getFrameCount());
+	printf("RAM hash:   %016llX\n", (unsigned long long)utils::fnv1a(console.getBus().get(0x0000), 0x800));
+	printf("VRAM hash:  %016llX\n", (unsigned long long)hashVideoMemory(console.getPPU()));
+
+	const PPU::Framebuffer &framebuffer = console.getPPU().getFramebuffer();
+	printf("Frame hash: %016llX\n", (unsigned long long)utils::fnv1a(framebuffer.data(), framebuffer.size()));
+
+	return 0;
+}
@@ -1,12 +1,19 @@
 #include "NROM.h"
 #include "../emulator/Bus.h"
 #include "../emulator/Cartridge.h"
+#include "../emulator/TileCache.h"
+
+#include <cstring>
 
 namespace mappers
 {
 	NROM::NROM(Cartridge &cartridge) : IMapper(cartridge), cartridge(cartridge), prgRam(PRG_RAM_SIZE)
 	{
-
+		if (cartridge.getChrRom().empty())
+		{
+			chrRam.resize(CHR_RAM_SIZE);
+			loadedChrRam.resize(CHR_RAM_SIZE);
+		}
 	}
 
 	uint8_t NROM::getId()
@@ -46,6 +53,25 @@ namespace mappers
 	}
 
 	// PRG memory operations
+	void NROM::mapPrg(Bus &bus)
+	{
+		// PRG RAM, 8 KiB ($2000)
+		bus.mapPages(0x6000, PRG_RAM_SIZE, prgRam.data(), true);
+
+		// RPG ROM, either 16 KiB ($4000) mirrored or 32 KiB ($8000)
+		std::vector<uint8_t> &prgRom = cartridge.getPrgRom();
+
+		if (prgRom.empty())
+		{
+			return;
+		}
+
+		for (uint32_t address = 0x8000; address <= 0xFFFF; address += prgRom.size())
+		{
+			bus.mapPages(address, prgRom.size(), prgRom.data(), false);
+		}
+	}
+
 	uint8_t NROM::prgRead(uint16_t address)
 	{
 		if (address >= 0x6000 && address < 0x8000)
@@ -72,29 +98,96 @@ namespace mappers
 			uint16_t offset = address - 0x6000;
 			prgRam[offset] = value;
 		}
-		else if (address >= 0x8000 && address <= 0xFFFF)
-		{
-			// RPG ROM, either 16 KiB ($4000) mirrored or 32 KiB ($8000)
-			// TODO: Determine why it needs to write to the ROM?
-			uint16_t offset = (address - 0x8000) % cartridge.getPrgRom().size();
-			cartridge.getPrgRom()[offset] = value;
-		}
+
+		// PRG ROM is read only
 	}
 
 	// CHR memory operations
 	uint8_t NROM::chrRead(uint16_t address)
 	{
-		// NROM allows for max 8 KiB ($2000) of CHR ROM
-		if (address < 0x2000)
+		if (address >= 0x2000)
 		{
-			return cartridge.getChrRom()[address];
+			return 0;
 		}
 
-		return 0;
+		// NROM allows for max 8 KiB ($2000) of CHR ROM, or CHR RAM if there is none
+		if (!chrRam.empty())
+		{
+			return chrRam[address];
+		}
+
+		return cartridge.getChrRom()[address];
 	}
 
 	void NROM::chrWrite(uint16_t address, uint8_t value)
 	{
 		// CHR ROM is read only
+		if (chrRam.empty() || address >= 0x2000 || chrRam[address] == value)
+		{
+			return;
+		}
+
+		chrRam[address] = value;
+		onChrChanged(address, 1);
+	}
+
+	void NROM::serialize(StateSerializer &state)
+	{
+		// NROM has no bank switching, so the PRG mapping never changes
+		state.beginChunk(StateSerializer::ChunkId::Mapper);
+		state.bytes(prgRam.data(), prgRam.size());
+
+		if (!state.isLoading())
+		{
+			state.bytes(chrRam.data(), chrRam.size());
+			state.endChunk();
+			return;
+		}
+
+		state.bytes(loadedChrRam.data(), loadedChrRam.size());
+		state.endChunk();
+
+		if (state.hasFailed())
+		{
+			return;
+		}
+
+		// Rewind and run-ahead load a savestate every frame, so only the tiles that differ are copied and reported,
+		// with consecutive ones reported together
+		uint16_t changedStart = 0;
+		uint16_t changedSize = 0;
+
+		for (uint16_t address = 0; address < chrRam.size(); address += TileCache::TILE_BYTES)
+		{
+			if (memcmp(&chrRam[address], &loadedChrRam[address], TileCache::TILE_BYTES) == 0)
+			{
+				if (changedSize > 0)
+				{
+					onChrChanged(changedStart, changedSize);
+					changedSize = 0;
+				}
+
+				continue;
+			}
+
+			memcpy(&chrRam[address], &loadedChrRam[address], TileCache::TILE_BYTES);
+
+			if (changedSize == 0)
+			{
+				changedStart = address;
+			}
+
+			changedSize += TileCache::TILE_BYTES;
+		}
+
+		if (changedSize > 0)
+		{
+			onChrChanged(changedStart, changedSize);
+		}
+	}
+
+	size_t NROM::getMemorySize()
+	{
+		return sizeof(NROM) + prgRam.capacity() + chrRam.capacity() + loadedChrRam.capacity();
 	}
 }
\ No newline at end of file
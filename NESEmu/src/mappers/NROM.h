@@ -13,6 +13,9 @@ namespace mappers
 		// 8 KiB ($2000) of PRG RAM provided (instead of the original 2 KiB on the NES)
 		static constexpr uint16_t PRG_RAM_SIZE = 0x2000;
 
+		// 8 KiB ($2000) of CHR RAM, used when the cartridge has no CHR ROM
+		static constexpr uint16_t CHR_RAM_SIZE = 0x2000;
+
 		NROM(Cartridge &cartridge);
 		uint8_t getId() override;
 		std::string getName() override;
@@ -22,6 +25,9 @@ namespace mappers
 		bool nametableRead(uint16_t address, uint8_t &value) override;
 		bool nametableWrite(uint16_t address, uint8_t value) override;
 
+		// Map PRG RAM and PRG ROM into the bus page tables
+		void mapPrg(Bus &bus) override;
+
 		// PRG memory operations
 		uint8_t prgRead(uint16_t address) override;
 		void prgWrite(uint16_t address, uint8_t value) override;
@@ -30,8 +36,18 @@ namespace mappers
 		uint8_t chrRead(uint16_t address) override;
 		void chrWrite(uint16_t address, uint8_t value) override;
 
+		// Save or load PRG RAM and CHR RAM
+		void serialize(StateSerializer &state) override;
+
+		// Returns the size of the mapper and its PRG and CHR RAM
+		size_t getMemorySize() override;
+
 	private:
 		Cartridge &cartridge;
 		std::vector<uint8_t> prgRam;
+		std::vector<uint8_t> chrRam;
+
+		// CHR RAM of the savestate being loaded, compared with the current one to only report the tiles that changed
+		std::vector<uint8_t> loadedChrRam;
 	};
 }
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Span.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// Bump allocator for transient data that only lives until the end of the current UI frame (text, scratch arrays).
+// Its memory is allocated once, and everything allocated from it is released at once by reset()
+class FrameArena
+{
+public:
+	// Allocate the given amount of bytes up front
+	FrameArena(size_t capacity) : memory(new uint8_t[capacity]), capacity(capacity), used(0), peak(0)
+	{
+	}
+
+	// Returns uninitialized space for the given amount of items, or an empty span if the arena is full.
+	// Nothing is destructed on reset, so only trivial types can be allocated
+	template <typename T>
+	Span<T> allocate(size_t count)
+	{
+		static_assert(std::is_trivial<T>::value, "FrameArena only holds trivial types");
+
+		size_t offset = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+
+		if (offset > capacity || count > (capacity - offset) / sizeof(T))
+		{
+			return Span<T>();
+		}
+
+		used = offset + count * sizeof(T);
+		peak = std::max(peak, used);
+
+		return Span<T>(reinterpret_cast<T *>(memory.get() + offset), count);
+	}
+
+	// Release everything allocated, at the start of a frame
+	void reset()
+	{
+		used = 0;
+	}
+
+	// Returns the most bytes used in a single frame
+	size_t getPeak() const
+	{
+		return peak;
+	}
+
+	size_t getCapacity() const
+	{
+		return capacity;
+	}
+
+private:
+	std::unique_ptr<uint8_t[]> memory;
+	size_t capacity;
+	size_t used;
+	size_t peak;
+};
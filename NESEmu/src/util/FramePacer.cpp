@@ -0,0 +1,162 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <time.h>
+#endif
+
+// Sleeping can wake up late by up to the scheduler granularity, so the last part of the wait is spun
+#ifdef _WIN32
+static constexpr std::chrono::microseconds SPIN_MARGIN(2000);
+#else
+static constexpr std::chrono::microseconds SPIN_MARGIN(500);
+#endif
+
+FramePacer::FramePacer(double frameRate, double cyclesPerFrame)
+	: frameRate(frameRate), cyclesPerFrame(cyclesPerFrame), cycleAccumulator(0), frames(0), framesSinceReset(0),
+	missedFrames(0), frameTimes(), frameTimeCount(0)
+{
+	framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+
+#ifdef _WIN32
+	// Default timer resolution is ~15.6ms, which is most of a frame
+	timeBeginPeriod(1);
+#endif
+
+	reset();
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::reset()
+{
+	start = Clock::now();
+	deadline = start + framePeriod;
+	lastFrame = start;
+	framesSinceReset = 0;
+}
+
+void FramePacer::wait()
+{
+	Clock::time_point now = Clock::now();
+
+	if (now > deadline + framePeriod * MAX_LATE_FRAMES)
+	{
+		// Too far behind (paused in a debugger, window dragged, ...), so start a new schedule
+		missedFrames++;
+		start = now;
+		deadline = now;
+		framesSinceReset = 0;
+	}
+	else
+	{
+		waitUntil(deadline);
+		now = Clock::now();
+	}
+
+	deadline += framePeriod;
+	frames++;
+	framesSinceReset++;
+
+	frameTimes[frameTimeCount % FRAME_HISTORY] = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+	frameTimeCount++;
+	lastFrame = now;
+}
+
+uint32_t FramePacer::takeCycles(double speed)
+{
+	cycleAccumulator += cyclesPerFrame * speed;
+
+	uint32_t cycles = static_cast<uint32_t>(cycleAccumulator);
+	cycleAccumulator -= cycles;
+
+	return cycles;
+}
+
+FramePacer::Stats FramePacer::getStats() const
+{
+	Stats stats = { 0 };
+	stats.frames = frames;
+	stats.missedFrames = missedFrames;
+
+	// Time elapsed compared to the time the frames since the schedule started should have taken
+	std::chrono::duration<double, std::milli> elapsed = lastFrame - start;
+	std::chrono::duration<double, std::milli> expected = framePeriod * framesSinceReset;
+	stats.drift = (elapsed - expected).count();
+
+	size_t count = std::min(frameTimeCount, FRAME_HISTORY);
+
+	if (count == 0)
+	{
+		return stats;
+	}
+
+	double sum = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		sum += frameTimes[i];
+		stats.maxFrameTime = std::max(stats.maxFrameTime, frameTimes[i]);
+	}
+
+	stats.averageFrameTime = sum / count;
+
+	double variance = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		double difference = frameTimes[i] - stats.averageFrameTime;
+		variance += difference * difference;
+	}
+
+	stats.jitter = std::sqrt(variance / count);
+
+	return stats;
+}
+
+double FramePacer::getFrameRate() const
+{
+	return frameRate;
+}
+
+void FramePacer::waitUntil(Clock::time_point time)
+{
+	Clock::time_point wakeUp = time - SPIN_MARGIN;
+
+	if (Clock::now() < wakeUp)
+	{
+#ifdef _WIN32
+		std::this_thread::sleep_until(wakeUp);
+#else
+		// steady_clock is CLOCK_MONOTONIC, so the deadline can be slept until directly, without converting to a delay
+		auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(wakeUp.time_since_epoch()).count();
+		timespec ts;
+		ts.tv_sec = static_cast<time_t>(sinceEpoch / 1000000000);
+		ts.tv_nsec = static_cast<long>(sinceEpoch % 1000000000);
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+		{
+		}
+#endif
+	}
+
+	while (Clock::now() < time)
+	{
+		std::this_thread::yield();
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// Paces a loop to a fixed frame rate, and keeps track of how many emulated cycles each frame should run.
+// Frame deadlines are absolute, so timing errors do not accumulate. Waiting sleeps until shortly before the
+// deadline, then spins for the rest, which keeps CPU usage low without overshooting the deadline
+class FramePacer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Frame timing statistics, in milliseconds, over the last FRAME_HISTORY frames
+	struct Stats
+	{
+		double averageFrameTime;
+		double jitter; // Standard deviation of the frame time
+		double maxFrameTime;
+
+		// How far the actual time is ahead (positive) or behind (negative) the ideal schedule
+		double drift;
+
+		uint64_t frames;
+
+		// Deadlines that were missed by more than MAX_LATE_FRAMES frames, making the schedule restart
+		uint64_t missedFrames;
+	};
+
+	static constexpr size_t FRAME_HISTORY = 120;
+
+	// Pace frames at the given rate, each running the given (fractional) amount of cycles at normal speed
+	FramePacer(double frameRate, double cyclesPerFrame);
+
+	~FramePacer();
+
+	// Restart the schedule from now
+	void reset();
+
+	// Wait until the next frame is due
+	void wait();
+
+	// Returns the whole amount of cycles to run this frame at the given speed, carrying over the fraction
+	uint32_t takeCycles(double speed);
+
+	// Returns the frame timing statistics
+	Stats getStats() const;
+
+	// Returns the rate frames are paced at
+	double getFrameRate() const;
+
+private:
+	// Frames can be this late before the schedule restarts, instead of running frames back to back to catch up
+	static constexpr uint32_t MAX_LATE_FRAMES = 3;
+
+	double frameRate;
+	double cyclesPerFrame;
+	Clock::duration framePeriod;
+
+	// Start of the schedule, and when the next frame is due
+	Clock::time_point start;
+	Clock::time_point deadline;
+	Clock::time_point lastFrame;
+
+	// Fractional cycles carried over to the next frame
+	double cycleAccumulator;
+
+	uint64_t frames, framesSinceReset, missedFrames;
+
+	// Frame times in milliseconds, as a ring
+	std::array<double, FRAME_HISTORY> frameTimes;
+	size_t frameTimeCount;
+
+	// Sleep until shortly before the given time point, then spin until it
+	void waitUntil(Clock::time_point time);
+};
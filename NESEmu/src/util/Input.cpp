@@ -4,14 +4,12 @@ using std::string;
 using std::bitset;
 using std::unordered_map;
 
-unordered_map<int, bool> Input::keys;
-unordered_map<string, Input::KeyMap> Input::keyMaps;
-
 // GLFW key callback
 static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
 void Input::init(GLFWwindow *window)
 {
+	glfwSetWindowUserPointer(window, this);
 	glfwSetKeyCallback(window, keyCallback);
 }
 
@@ -20,13 +18,22 @@ void Input::registerKeyMap(string name, KeyMap keyMap)
 	keyMaps[name] = keyMap;
 }
 
-bitset<Input::KEYMAP_SIZE> Input::getKeyMap(string name)
+bitset<Input::KEYMAP_SIZE> Input::getKeyMap(const string &name) const
 {
 	bitset<KEYMAP_SIZE> bits(0);
+	auto keyMap = keyMaps.find(name);
+
+	// Looked up without inserting, so that unknown key maps are not created
+	if (keyMap == keyMaps.end())
+	{
+		return bits;
+	}
 
-	for (auto &pair : keyMaps[name])
+	for (auto &pair : keyMap->second)
 	{
-		if (keys[pair.first])
+		auto key = keys.find(pair.first);
+
+		if (key != keys.end() && key->second)
 		{
 			bits[static_cast<uint8_t>(pair.second)] = true;
 		}
@@ -35,6 +42,12 @@ bitset<Input::KEYMAP_SIZE> Input::getKeyMap(string name)
 	return bits;
 }
 
+bool Input::isKeyDown(int key) const
+{
+	auto state = keys.find(key);
+	return state != keys.end() && state->second;
+}
+
 void Input::onKeyEvent(int key, int scancode, int action, int mods)
 {
 	if (action == GLFW_PRESS)
@@ -49,5 +62,5 @@ void Input::onKeyEvent(int key, int scancode, int action, int mods)
 
 void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-	Input::onKeyEvent(key, scancode, action, mods);
+	static_cast<Input *>(glfwGetWindowUserPointer(window))->onKeyEvent(key, scancode, action, mods);
 }
\ No newline at end of file
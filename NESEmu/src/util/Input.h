@@ -7,6 +7,8 @@
 #include <unordered_map>
 #include <string>
 
+// Keyboard state of a window, and the key maps translating it into controller input. Owned by the front-end, so that
+// each window has its own
 class Input
 {
 public:
@@ -14,13 +16,16 @@ public:
 	static constexpr size_t KEYMAP_SIZE = 8;
 	using KeyMap = std::unordered_map<int, Controller::Button>;
 
-	// Start capturing input events
-	static void init(GLFWwindow *window);
-	static void registerKeyMap(std::string name, KeyMap keyMap);
-	static std::bitset<KEYMAP_SIZE> getKeyMap(std::string name);
-	static void onKeyEvent(int key, int scancode, int action, int mods);
+	// Start capturing the input events of a window, which keeps a pointer to this instance
+	void init(GLFWwindow *window);
+	void registerKeyMap(std::string name, KeyMap keyMap);
+	std::bitset<KEYMAP_SIZE> getKeyMap(const std::string &name) const;
+
+	// Returns whether a key is being held down
+	bool isKeyDown(int key) const;
+	void onKeyEvent(int key, int scancode, int action, int mods);
 
 private:
-	static std::unordered_map<int, bool> keys;
-	static std::unordered_map<std::string, KeyMap> keyMaps;
+	std::unordered_map<int, bool> keys;
+	std::unordered_map<std::string, KeyMap> keyMaps;
 };
\ No newline at end of file
@@ -1,48 +1,226 @@
 #include "Logger.h"
 
-#include <stdio.h>
-#include <vector>
-#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
 
-// TODO: Make buffer configurable
-static int constexpr BUFFER_SIZE = 0;
-static std::stringstream ss;
-static int bufferCount = 0;
+// Buffers allocated up front, and the most a logger may allocate before it starts dropping text
+static constexpr size_t INITIAL_BLOCKS = 2;
+static constexpr size_t MAX_BLOCKS = 64;
 
-Logger::Logger(std::string path)
+// How long the writer thread sleeps when there is nothing to write
+static constexpr std::chrono::milliseconds IDLE_SLEEP(1);
+
+// Background thread that writes the filled buffers of every logger
+class LogWriter
+{
+public:
+	static LogWriter &get()
+	{
+		static LogWriter writer;
+		return writer;
+	}
+
+	~LogWriter()
+	{
+		running = false;
+
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	void add(Logger *logger)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loggers.push_back(logger);
+
+		if (!thread.joinable())
+		{
+			running = true;
+			thread = std::thread(&LogWriter::run, this);
+		}
+	}
+
+	// Writes anything still pending, so the logger can close its file
+	void remove(Logger *logger)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		logger->writePending();
+		loggers.erase(std::remove(loggers.begin(), loggers.end(), logger), loggers.end());
+	}
+
+private:
+	// Only locked while iterating loggers or adding/removing them, never by Logger::write
+	std::mutex mutex;
+	std::vector<Logger *> loggers;
+	std::thread thread;
+	std::atomic<bool> running;
+
+	LogWriter() : running(false)
+	{
+	}
+
+	void run()
+	{
+		while (running)
+		{
+			size_t written = 0;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				for (Logger *logger : loggers)
+				{
+					written += logger->writePending();
+				}
+			}
+
+			if (written == 0)
+			{
+				std::this_thread::sleep_for(IDLE_SLEEP);
+			}
+		}
+	}
+};
+
+Logger::Logger(std::string path, size_t bufferSize, FlushPolicy flushPolicy)
+	: path(path), bufferSize(bufferSize), flushPolicy(flushPolicy), current({ nullptr, 0 }),
+	pendingBlocks(MAX_BLOCKS), freeBlocks(MAX_BLOCKS), droppedBytes(0)
+{
+	file = fopen(path.c_str(), "w");
+
+	if (file)
+	{
+		// Buffering is done here, so each buffer is written with a single call
+		setvbuf(file, nullptr, _IONBF, 0);
+	}
+	else
+	{
+		printf("Failed to open log file: %s\n", path.c_str());
+	}
+
+	for (size_t i = 0; i < INITIAL_BLOCKS; i++)
+	{
+		blocks.emplace_back(new char[bufferSize]);
+		freeBlocks.push({ blocks.back().get(), 0 });
+	}
+
+	LogWriter::get().add(this);
+}
+
+Logger::~Logger()
 {
-	this->path = path;
-	file.open(path, std::fstream::out);
+	flush();
+	LogWriter::get().remove(this);
+
+	if (droppedBytes > 0)
+	{
+		printf("Log %s dropped %llu bytes\n", path.c_str(), (unsigned long long)droppedBytes);
+	}
+
+	if (file)
+	{
+		fclose(file);
+	}
 }
 
 void Logger::write(std::string text)
 {
-	write(text.c_str());
+	write(text.c_str(), text.size());
 }
 
 void Logger::write(const char *text)
 {
-	ss << text;
-	bufferCount++;
+	write(text, strlen(text));
+}
+
+void Logger::write(const char *data, size_t length)
+{
+	while (length > 0)
+	{
+		if (!current.data && !nextBlock())
+		{
+			droppedBytes += length;
+			return;
+		}
 
-	if (bufferCount > BUFFER_SIZE)
+		size_t count = std::min(length, bufferSize - current.length);
+		memcpy(current.data + current.length, data, count);
+		current.length += count;
+		data += count;
+		length -= count;
+
+		if (current.length == bufferSize)
+		{
+			handOff();
+		}
+	}
+
+	if (flushPolicy == FlushPolicy::EveryWrite)
 	{
-		file << ss.str();
-		ss.str("");
-		bufferCount = 0;
+		flush();
 	}
 }
 
-Logger::~Logger()
+void Logger::flush()
 {
-	if (file.is_open())
+	if (current.data && current.length > 0)
 	{
-		// Write any last text
-		if (bufferCount > 0)
+		handOff();
+	}
+}
+
+uint64_t Logger::getDroppedBytes() const
+{
+	return droppedBytes;
+}
+
+bool Logger::nextBlock()
+{
+	if (freeBlocks.pop(current))
+	{
+		current.length = 0;
+		return true;
+	}
+
+	// The writer thread is behind, allocate rather than wait for it
+	if (blocks.size() < MAX_BLOCKS)
+	{
+		blocks.emplace_back(new char[bufferSize]);
+		current = { blocks.back().get(), 0 };
+		return true;
+	}
+
+	return false;
+}
+
+void Logger::handOff()
+{
+	// Never fails, since there are no more blocks than the queue can hold
+	pendingBlocks.push(current);
+	current = { nullptr, 0 };
+}
+
+size_t Logger::writePending()
+{
+	size_t written = 0;
+	Block block;
+
+	while (pendingBlocks.pop(block))
+	{
+		if (file)
 		{
-			file << ss.str();
+			fwrite(block.data, 1, block.length, file);
 		}
 
-		file.close();
+		freeBlocks.push(block);
+		written++;
 	}
-}
\ No newline at end of file
+
+	return written;
+}
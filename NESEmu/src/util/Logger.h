@@ -1,22 +1,78 @@
 #pragma once
 
+#include "RingBuffer.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
 #include <string>
-#include <fstream>
+#include <vector>
 
+// Writes text to a file without blocking on disk. Each logger fills its own preallocated buffers, which are
+// handed off lock-free to a background thread shared by all loggers, and written there one whole buffer at a time
 class Logger
 {
 public:
+	// When filled buffers are handed off to the writer thread
+	enum class FlushPolicy
+	{
+		// Once the buffer is full, or flush is called
+		WhenFull,
+
+		// After every write, so the file stays up to date (for low volume logs)
+		EveryWrite
+	};
+
+	static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
 	// Create the logger and open the file
-	Logger(std::string path);
+	Logger(std::string path, size_t bufferSize = DEFAULT_BUFFER_SIZE, FlushPolicy flushPolicy = FlushPolicy::WhenFull);
 
-	// Close the file
+	// Write any remaining text and close the file
 	~Logger();
 
 	// Write to the file
 	void write(std::string text);
 	void write(const char *text);
+	void write(const char *data, size_t length);
+
+	// Hand off the current buffer to the writer thread, even if it is not full
+	void flush();
+
+	// Returns the amount of bytes dropped because the writer thread fell too far behind
+	uint64_t getDroppedBytes() const;
 
 private:
+	// A buffer and how much of it is filled
+	struct Block
+	{
+		char *data;
+		size_t length;
+	};
+
 	std::string path;
-	std::ofstream file;
-};
\ No newline at end of file
+	FILE *file;
+	size_t bufferSize;
+	FlushPolicy flushPolicy;
+
+	// All buffers owned by this logger, and the one currently being filled
+	std::vector<std::unique_ptr<char[]>> blocks;
+	Block current;
+
+	// Filled buffers waiting to be written, and written buffers ready to be reused
+	RingBuffer<Block> pendingBlocks;
+	RingBuffer<Block> freeBlocks;
+
+	uint64_t droppedBytes;
+
+	// Get an empty buffer to fill, returns false if all buffers are in use and no more can be allocated
+	bool nextBlock();
+
+	// Queue the current buffer to be written
+	void handOff();
+
+	// Writer thread: write all pending buffers, and return how many were written
+	size_t writePending();
+
+	friend class LogWriter;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free ring buffer for a single producer thread and a single consumer thread.
+// The capacity is rounded up to a power of two, and the buffer is allocated once on construction
+template <typename T>
+class RingBuffer
+{
+public:
+	// Allocate a buffer able to hold at least the given amount of items
+	RingBuffer(size_t capacity) : head(0), cachedTail(0), tail(0), cachedHead(0)
+	{
+		size_t size = 1;
+
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+
+		buffer.resize(size);
+		mask = size - 1;
+	}
+
+	// Producer: add an item, or return false if the buffer is full
+	bool push(const T &item)
+	{
+		size_t currentHead = head.load(std::memory_order_relaxed);
+
+		if (currentHead - cachedTail > mask)
+		{
+			cachedTail = tail.load(std::memory_order_acquire);
+
+			if (currentHead - cachedTail > mask)
+			{
+				return false;
+			}
+		}
+
+		buffer[currentHead & mask] = item;
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer: remove the oldest item, or return false if the buffer is empty
+	bool pop(T &item)
+	{
+		const T *items;
+
+		if (peek(items) == 0)
+		{
+			return false;
+		}
+
+		item = items[0];
+		consume(1);
+		return true;
+	}
+
+	// Consumer: get the oldest items that are stored contiguously, and return how many there are
+	size_t peek(const T *&items)
+	{
+		size_t currentTail = tail.load(std::memory_order_relaxed);
+
+		if (cachedHead == currentTail)
+		{
+			cachedHead = head.load(std::memory_order_acquire);
+
+			if (cachedHead == currentTail)
+			{
+				return 0;
+			}
+		}
+
+		// Stop at the end of the buffer, the rest is returned by the next call
+		size_t offset = currentTail & mask;
+		size_t count = cachedHead - currentTail;
+
+		if (offset + count > buffer.size())
+		{
+			count = buffer.size() - offset;
+		}
+
+		items = &buffer[offset];
+		return count;
+	}
+
+	// Consumer: remove items previously returned by peek
+	void consume(size_t count)
+	{
+		tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+
+	// Returns whether the buffer is empty (exact only when called from the consumer)
+	bool empty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+	// Returns the amount of items the buffer can hold
+	size_t capacity() const
+	{
+		return buffer.size();
+	}
+
+private:
+	std::vector<T> buffer;
+	size_t mask;
+
+	// Head is only written by the producer, tail only by the consumer. Each is kept on its own cache line,
+	// along with the side's cached copy of the other index, so that they do not bounce between cores
+	alignas(64) std::atomic<size_t> head;
+	size_t cachedTail;
+	alignas(64) std::atomic<size_t> tail;
+	size_t cachedHead;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// SSE2 is always available on x86-64, and optionally on 32-bit x86
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NESEMU_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Returns the amount of set bits in a value
+inline uint32_t countSetBits(uint32_t value)
+{
+#if defined(__GNUC__)
+	return __builtin_popcount(value);
+#else
+	value = value - ((value >> 1) & 0x55555555);
+	value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+	return (((value + (value >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#endif
+}
+
+// Returns the index of the lowest set bit of a value, which must not be 0
+inline uint32_t countTrailingZeros(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#elif defined(__GNUC__)
+	return __builtin_ctzll(value);
+#else
+	uint32_t index = 0;
+
+	while ((value & 1) == 0)
+	{
+		value >>= 1;
+		index++;
+	}
+
+	return index;
+#endif
+}
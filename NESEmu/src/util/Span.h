@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+// Non-owning view of a contiguous array, like C++20 std::span. Only valid for as long as the viewed array is
+template <typename T>
+class Span
+{
+public:
+	Span() : pointer(nullptr), count(0)
+	{
+	}
+
+	Span(T *pointer, size_t count) : pointer(pointer), count(count)
+	{
+	}
+
+	// View the whole of any container with data() and size()
+	template <typename Container>
+	Span(Container &container) : pointer(container.data()), count(container.size())
+	{
+	}
+
+	template <typename Container>
+	Span(const Container &container) : pointer(container.data()), count(container.size())
+	{
+	}
+
+	T &operator[](size_t index) const
+	{
+		assert(index < count);
+		return pointer[index];
+	}
+
+	// View of part of this span
+	Span subspan(size_t offset, size_t length) const
+	{
+		assert(offset + length <= count);
+		return Span(pointer + offset, length);
+	}
+
+	T *data() const
+	{
+		return pointer;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	T *begin() const
+	{
+		return pointer;
+	}
+
+	T *end() const
+	{
+		return pointer + count;
+	}
+
+private:
+	T *pointer;
+	size_t count;
+};
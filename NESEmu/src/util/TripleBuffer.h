@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer, passing the latest value from a single producer thread to a single consumer thread.
+// The producer writes into its own buffer and publishes it by swapping it with the shared one, the consumer
+// swaps the shared one with its own when it is newer. Neither side ever waits, and values the consumer is too
+// slow to see are skipped
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : buffers(), writeIndex(0), readIndex(1), shared(2)
+	{
+	}
+
+	// Producer: returns the buffer to write the next value into
+	T &getWriteBuffer()
+	{
+		return buffers[writeIndex];
+	}
+
+	// Producer: make the write buffer the latest value, and get a new write buffer
+	void publish()
+	{
+		uint8_t previous = shared.exchange(writeIndex | NEW_FLAG, std::memory_order_acq_rel);
+		writeIndex = previous & INDEX_MASK;
+	}
+
+	// Consumer: take the latest published value if there is a new one, and return whether there was
+	bool update()
+	{
+		if ((shared.load(std::memory_order_relaxed) & NEW_FLAG) == 0)
+		{
+			return false;
+		}
+
+		uint8_t previous = shared.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = previous & INDEX_MASK;
+		return true;
+	}
+
+	// Consumer: returns the value taken by the last update
+	const T &getReadBuffer() const
+	{
+		return buffers[readIndex];
+	}
+
+private:
+	// The shared index is marked when the producer publishes into it, until the consumer takes it
+	static constexpr uint8_t INDEX_MASK = 0x03;
+	static constexpr uint8_t NEW_FLAG = 0x04;
+
+	std::array<T, 3> buffers;
+
+	// Only used by their own side
+	uint8_t writeIndex;
+	uint8_t readIndex;
+
+	// Index of the buffer in between, which both sides swap their own with
+	std::atomic<uint8_t> shared;
+};
@@ -1,27 +1,56 @@
 #include "Utils.h"
 
+#include <stdio.h>
+
 namespace utils
 {
-	void printMemory(std::stringstream &ss, uint16_t start, uint16_t end, std::function<uint8_t(uint16_t address)> readCallback)
+	uint64_t fnv1a(const uint8_t *data, size_t size, uint64_t hash)
 	{
-		// Draw 8 bytes per line from start address to end address
-		for (int base = start; base <= end; base += 8)
+		for (size_t i = 0; i < size; i++)
 		{
-			ss << std::hex
-				<< std::setw(4) << std::setfill('0')
-				<< base << ":\t";
+			hash ^= data[i];
+			hash *= 0x100000001B3;
+		}
+
+		return hash;
+	}
 
-			for (int line = 0; line < 8; line++)
+	size_t getMemoryTextSize(uint16_t start, uint16_t end)
+	{
+		size_t lines = end >= start ? (end - start) / 8 + 1 : 0;
+		return lines * MEMORY_LINE_LENGTH + 1;
+	}
+
+	size_t printMemory(Span<char> output, uint16_t start, uint16_t end,
+		const std::function<uint8_t(uint16_t address)> &readCallback)
+	{
+		if (output.empty())
+		{
+			return 0;
+		}
+
+		size_t length = 0;
+
+		// Draw 8 bytes per line from start address to end address, as long as whole lines fit
+		for (int base = start; base <= end && length + MEMORY_LINE_LENGTH < output.size(); base += 8)
+		{
+			char *line = output.data() + length;
+			line += sprintf(line, "%04x:\t", base);
+
+			for (int i = 0; i < 8; i++)
 			{
-				ss << std::setw(2) << std::setfill('0')
-					<< (int)readCallback(base + line) << " ";
+				line += sprintf(line, "%02x ", readCallback(base + i));
 			}
 
-			ss << std::endl;
+			*line++ = '\n';
+			length = line - output.data();
 		}
+
+		output[length] = '\0';
+		return length;
 	}
 
-	std::string mirroringModeToString(MirroringMode mode)
+	const char *mirroringModeToString(MirroringMode mode)
 	{
 		switch (mode)
 		{
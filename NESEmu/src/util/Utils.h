@@ -1,13 +1,13 @@
 #pragma once
 
 #include "../emulator/MirroringMode.h"
+#include "Span.h"
 
+#include <cstdint>
 #include <type_traits>
 #include <string>
 #include <bitset>
 #include <limits>
-#include <sstream>
-#include <iomanip>
 #include <functional>
 
 namespace utils
@@ -20,6 +20,19 @@ namespace utils
 		return bits.to_string();
 	}
 
-	void printMemory(std::stringstream &ss, uint16_t start, uint16_t end, std::function<uint8_t(uint16_t address)> readCallback);
-	std::string mirroringModeToString(MirroringMode mode);
+	// 64-bit FNV-1a hash, pass the previous result as the hash to continue hashing over multiple blocks
+	static constexpr uint64_t FNV1A_OFFSET_BASIS = 0xCBF29CE484222325;
+	uint64_t fnv1a(const uint8_t *data, size_t size, uint64_t hash = FNV1A_OFFSET_BASIS);
+
+	// Each line of printed memory is "XXXX:\t", 8 bytes as "XX " and a newline
+	static constexpr size_t MEMORY_LINE_LENGTH = 31;
+
+	// Returns the size of the text printMemory writes for a range, including the null terminator
+	size_t getMemoryTextSize(uint16_t start, uint16_t end);
+
+	// Print memory 8 bytes per line, from start to end address, as null terminated text. Returns the text length
+	size_t printMemory(Span<char> output, uint16_t start, uint16_t end,
+		const std::function<uint8_t(uint16_t address)> &readCallback);
+
+	const char *mirroringModeToString(MirroringMode mode);
 }
\ No newline at end of file
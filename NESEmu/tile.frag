@@ -0,0 +1,23 @@
+#version 330 core
+
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in int Palette;
+
+uniform sampler2D textureSampler;
+uniform vec4[36] palettes;
+
+void main()
+{
+    vec4 pixel = texture(textureSampler, TexCoords);
+    vec4 paletteColor = palettes[Palette * 4 + int(pixel.r * 10.0f / 2.0f)];
+
+    // Transparent pixels must not hide what is drawn behind them through the depth buffer
+    if (paletteColor.a == 0.0f)
+    {
+        discard;
+    }
+
+    FragColor = paletteColor;
+}
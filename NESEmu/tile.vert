@@ -0,0 +1,22 @@
+#version 330 core
+
+layout (location = 0) in vec2 corner;
+
+// Per tile attributes
+layout (location = 1) in vec3 pos;
+layout (location = 2) in vec2 size;
+layout (location = 3) in vec4 uv; // Top left (xy) and bottom right (zw) in texture pixels
+layout (location = 4) in float palette;
+
+out vec2 TexCoords;
+flat out int Palette;
+
+uniform mat4 projection;
+uniform vec2 textureSize;
+
+void main()
+{
+    gl_Position = projection * vec4(pos.xy + corner * size, pos.z, 1.0);
+    TexCoords = mix(uv.xy, uv.zw, corner) / textureSize;
+    Palette = int(palette);
+}
@@ -0,0 +1,85 @@
+"""
+    Decodes the binary CPU trace recorded by the emulator (cpu.trace) into the nestest-compatible text log (cpu.log),
+    which can then be compared with scripts/logcompare.py.
+    Usage: tracedecode.py [log folder] or tracedecode.py <trace file> <output log>
+"""
+
+import struct
+import sys
+
+log_folder = '..\\logs\\'
+
+TRACE_FILE = 'cpu.trace'
+OUTPUT_LOG = 'cpu.log'
+
+# Must match CPUTracer in the emulator
+MAGIC = b'NESTRACE'
+VERSION = 1
+HEADER = struct.Struct('<8sII')
+RECORD = struct.Struct('<QH5BB3B5x') # cycle, PC, A, X, Y, P, SP, length, instruction bytes
+
+# Disassembly names, indexed by opcode (from CPU::getInstructionName)
+INSTRUCTION_NAMES = [
+    'BRK', 'ORA', 'XXX', 'XXX', 'NOP*', 'ORA', 'ASL', 'XXX', 'PHP', 'ORA', 'ASL', 'XXX', 'NOP*', 'ORA', 'ASL', 'XXX',
+    'BPL', 'ORA', 'XXX', 'XXX', 'NOP*', 'ORA', 'ASL', 'XXX', 'CLC', 'ORA', 'NOP*', 'XXX', 'NOP*', 'ORA', 'ASL', 'XXX',
+    'JSR', 'AND', 'XXX', 'XXX', 'BIT', 'AND', 'ROL', 'XXX', 'PLP', 'AND', 'ROL', 'XXX', 'BIT', 'AND', 'ROL', 'XXX',
+    'BMI', 'AND', 'XXX', 'XXX', 'NOP*', 'AND', 'ROL', 'XXX', 'SEC', 'AND', 'NOP*', 'XXX', 'NOP*', 'AND', 'ROL', 'XXX',
+    'RTI', 'EOR', 'XXX', 'XXX', 'NOP*', 'EOR', 'LSR', 'XXX', 'PHA', 'EOR', 'LSR', 'XXX', 'JMP', 'EOR', 'LSR', 'XXX',
+    'BVC', 'EOR', 'XXX', 'XXX', 'NOP*', 'EOR', 'LSR', 'XXX', 'CLI', 'EOR', 'NOP*', 'XXX', 'NOP*', 'EOR', 'LSR', 'XXX',
+    'RTS', 'ADC', 'XXX', 'XXX', 'NOP*', 'ADC', 'ROR', 'XXX', 'PLA', 'ADC', 'ROR', 'XXX', 'JMP', 'ADC', 'ROR', 'XXX',
+    'BVS', 'ADC', 'XXX', 'XXX', 'NOP*', 'ADC', 'ROR', 'XXX', 'SEI', 'ADC', 'NOP*', 'XXX', 'NOP*', 'ADC', 'ROR', 'XXX',
+    'NOP*', 'STA', 'NOP*', 'XXX', 'STY', 'STA', 'STX', 'XXX', 'DEY', 'NOP*', 'TXA', 'XXX', 'STY', 'STA', 'STX', 'XXX',
+    'BCC', 'STA', 'XXX', 'XXX', 'STY', 'STA', 'STX', 'XXX', 'TYA', 'STA', 'TXS', 'XXX', 'XXX', 'STA', 'XXX', 'XXX',
+    'LDY', 'LDA', 'LDX', 'XXX', 'LDY', 'LDA', 'LDX', 'XXX', 'TAY', 'LDA', 'TAX', 'XXX', 'LDY', 'LDA', 'LDX', 'XXX',
+    'BCS', 'LDA', 'XXX', 'XXX', 'LDY', 'LDA', 'LDX', 'XXX', 'CLV', 'LDA', 'TSX', 'XXX', 'LDY', 'LDA', 'LDX', 'XXX',
+    'CPY', 'CMP', 'NOP*', 'XXX', 'CPY', 'CMP', 'DEC', 'XXX', 'INY', 'CMP', 'DEX', 'XXX', 'CPY', 'CMP', 'DEC', 'XXX',
+    'BNE', 'CMP', 'XXX', 'XXX', 'NOP*', 'CMP', 'DEC', 'XXX', 'CLD', 'CMP', 'NOP*', 'XXX', 'NOP*', 'CMP', 'DEC', 'XXX',
+    'CPX', 'SBC', 'NOP*', 'XXX', 'CPX', 'SBC', 'INC', 'XXX', 'INX', 'SBC', 'NOP', 'XXX', 'CPX', 'SBC', 'INC', 'XXX',
+    'BEQ', 'SBC', 'XXX', 'XXX', 'NOP*', 'SBC', 'INC', 'XXX', 'SED', 'SBC', 'NOP*', 'XXX', 'NOP*', 'SBC', 'INC', 'XXX',
+]
+
+# Instruction bytes are padded to the width of a 3 byte instruction
+OPCODE_FORMATS = {
+    1: '{0:02X}      ',
+    2: '{0:02X} {1:02X}   ',
+    3: '{0:02X} {1:02X} {2:02X}',
+}
+
+def decode(trace_path, log_path):
+    with open(trace_path, 'rb') as trace:
+        magic, version, record_size = HEADER.unpack(trace.read(HEADER.size))
+
+        if magic != MAGIC or version != VERSION or record_size != RECORD.size:
+            print('Error, unsupported trace file: ' + trace_path)
+            return False
+
+        data = trace.read()
+
+    # A trace cut off while writing may end with a partial record
+    data = data[:len(data) - len(data) % RECORD.size]
+
+    with open(log_path, 'w', newline='\n') as log:
+        for cycle, pc, a, x, y, p, sp, length, b0, b1, b2 in RECORD.iter_unpack(data):
+            log.write('%04X  %s  %s\t\tA:%02X X:%02X Y:%02X P:%02X SP:%02X\tCYC:%d\n' % (
+                pc, OPCODE_FORMATS[length].format(b0, b1, b2), INSTRUCTION_NAMES[b0], a, x, y, p, sp, cycle))
+
+    print('Decoded %d instructions to %s' % (len(data) // RECORD.size, log_path))
+    return True
+
+def main():
+    folder = log_folder
+    
+    if len(sys.argv) == 2:
+        folder = sys.argv[1]
+
+    trace_path = folder + TRACE_FILE
+    log_path = folder + OUTPUT_LOG
+
+    if len(sys.argv) == 3:
+        trace_path = sys.argv[1]
+        log_path = sys.argv[2]
+
+    decode(trace_path, log_path)
+
+if __name__ == '__main__':
+    main()